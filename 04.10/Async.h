@@ -0,0 +1,723 @@
+#ifndef __Async_h
+#define __Async_h
+
+// C++20 coroutines for overlapping Matrix/Image I/O with compute.
+//
+//   ThreadPool          a fixed set of worker threads; co_await pool.schedule() hops onto it
+//   Task<T>             lazy coroutine result; co_await it, or syncWait(task) from plain code
+//   offload(io, f)      runs blocking f() on another pool (e.g. a small I/O pool) and resumes
+//                       the awaiting coroutine back on the pool it came from
+//   AsyncChannel<T>     bounded queue; send/receive suspend instead of blocking (backpressure)
+//   pipeline(...)       source -> stages -> sink, each with its own parallelism, connected by
+//                       AsyncChannels, so several images are in flight at once
+//
+//     ThreadPool compute(8), io(4);
+//     pipeline<std::string>(compute, 4)
+//         .source(paths, 2)
+//         .stage([&](std::string p) { return loadPPMAsync(io, p); }, 4)     // returns an awaitable
+//         .stage([](Image img) { Matrix<uint8_t> g; toGray(img, g); return g; }, 8)
+//         .sink([&](Matrix<uint8_t> g) { return savePNMAsync(io, "out.pgm", std::move(g)); }, 2)
+//         .run();                                                       // blocks until drained
+//
+// Results leave the pipeline in completion order, not input order.
+//
+// This header needs C++20 (the rest of 04.10 is C++17).
+
+#if !defined(__cpp_impl_coroutine)
+#error "Async.h needs C++20 coroutines (-std=c++20)"
+#endif
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "ImageIO.h"
+#include "Matrix.h"
+
+class ThreadPool
+{
+    std::mutex lock;
+    std::condition_variable wake;
+    std::deque<std::function<void()>> jobs;
+    std::vector<std::thread> workers;
+    bool stopping = false;
+
+    static ThreadPool*& currentSlot()
+    {
+        thread_local ThreadPool* pool = nullptr;
+        return pool;
+    }
+
+public:
+    explicit ThreadPool(int nThreads = static_cast<int>(std::thread::hardware_concurrency()))
+    {
+        for(int i = 0; i < std::max(1, nThreads); ++i)
+            workers.emplace_back([this] {
+                currentSlot() = this;
+                for(;;)
+                {
+                    std::function<void()> job;
+                    {
+                        std::unique_lock<std::mutex> guard(lock);
+                        wake.wait(guard, [this] { return stopping || !jobs.empty(); });
+                        if(jobs.empty()) return;        // stopping and drained
+                        job = std::move(jobs.front());
+                        jobs.pop_front();
+                    }
+                    job();
+                }
+            });
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    void operator=(const ThreadPool&) = delete;
+
+    // finishes every queued job first
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for(auto& w : workers) w.join();
+    }
+
+    int size() const { return static_cast<int>(workers.size()); }
+
+    void post(std::function<void()> job)
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            jobs.push_back(std::move(job));
+        }
+        wake.notify_one();
+    }
+
+    void post(std::coroutine_handle<> h) { post([h] { h.resume(); }); }
+
+    // the pool running the calling thread, nullptr outside any pool
+    static ThreadPool* current() { return currentSlot(); }
+
+    // co_await pool.schedule(): continue on one of this pool's threads
+    auto schedule()
+    {
+        struct Awaiter
+        {
+            ThreadPool& pool;
+            bool await_ready() const { return ThreadPool::current() == &pool; }
+            void await_suspend(std::coroutine_handle<> h) { pool.post(h); }
+            void await_resume() const { }
+        };
+        return Awaiter{*this};
+    }
+};
+
+template<typename T = void> class Task;
+
+namespace async_detail
+{
+    struct PromiseBase
+    {
+        std::coroutine_handle<> continuation;
+        std::exception_ptr error;
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        // symmetric transfer back to whoever awaited us, without growing the stack
+        struct FinalAwaiter
+        {
+            bool await_ready() const noexcept { return false; }
+            template<typename P>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept
+            {
+                auto next = h.promise().continuation;
+                return next ? next : std::noop_coroutine();
+            }
+            void await_resume() const noexcept { }
+        };
+        FinalAwaiter final_suspend() noexcept { return {}; }
+
+        void unhandled_exception() { error = std::current_exception(); }
+    };
+
+    template<typename T>
+    struct Promise : PromiseBase
+    {
+        std::optional<T> value;
+
+        Task<T> get_return_object();
+        template<typename U>
+        void return_value(U&& v) { value.emplace(std::forward<U>(v)); }
+
+        T result()
+        {
+            if(error) std::rethrow_exception(error);
+            return std::move(*value);
+        }
+    };
+
+    template<>
+    struct Promise<void> : PromiseBase
+    {
+        Task<void> get_return_object();
+        void return_void() { }
+
+        void result()
+        {
+            if(error) std::rethrow_exception(error);
+        }
+    };
+
+    // fire-and-forget coroutine: starts immediately, frees itself when done
+    struct Detached
+    {
+        struct promise_type
+        {
+            Detached get_return_object() { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() { }
+            void unhandled_exception() { std::terminate(); }
+        };
+    };
+
+    template<typename A>
+    concept HasAwaitResume = requires(A a) { a.await_resume(); };
+}
+
+template<typename T>
+class Task
+{
+public:
+    using promise_type = async_detail::Promise<T>;
+    using value_type = T;
+
+    Task(Task&& other) noexcept : h(std::exchange(other.h, nullptr)) { }
+    Task& operator=(Task&& other) noexcept
+    {
+        if(h) h.destroy();
+        h = std::exchange(other.h, nullptr);
+        return *this;
+    }
+    Task(const Task&) = delete;
+    void operator=(const Task&) = delete;
+    ~Task() { if(h) h.destroy(); }
+
+    // awaiting starts the (lazy) task and resumes us when it finishes
+    auto operator co_await() &&
+    {
+        struct Awaiter
+        {
+            std::coroutine_handle<promise_type> h;
+            bool await_ready() const { return !h || h.done(); }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting)
+            {
+                h.promise().continuation = awaiting;
+                return h;
+            }
+            T await_resume() { return h.promise().result(); }
+        };
+        return Awaiter{h};
+    }
+
+private:
+    friend struct async_detail::Promise<T>;
+    explicit Task(std::coroutine_handle<promise_type> h) : h(h) { }
+    std::coroutine_handle<promise_type> h;
+};
+
+template<typename T>
+Task<T> async_detail::Promise<T>::get_return_object()
+{
+    return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline Task<void> async_detail::Promise<void>::get_return_object()
+{
+    return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+namespace async_detail
+{
+    template<typename T>
+    Detached runAndSignal(Task<T>& task, std::optional<T>& out, std::exception_ptr& error, std::latch& done)
+    {
+        try { out.emplace(co_await std::move(task)); }
+        catch(...) { error = std::current_exception(); }
+        done.count_down();
+    }
+
+    inline Detached runAndSignal(Task<void>& task, std::exception_ptr& error, std::latch& done)
+    {
+        try { co_await std::move(task); }
+        catch(...) { error = std::current_exception(); }
+        done.count_down();
+    }
+}
+
+// blocks the calling (non-coroutine) thread until `task` has finished
+template<typename T>
+T syncWait(Task<T> task)
+{
+    std::latch done(1);
+    std::exception_ptr error;
+    if constexpr(std::is_void_v<T>)
+    {
+        async_detail::runAndSignal(task, error, done);
+        done.wait();
+        if(error) std::rethrow_exception(error);
+    }
+    else
+    {
+        std::optional<T> out;
+        async_detail::runAndSignal(task, out, error, done);
+        done.wait();
+        if(error) std::rethrow_exception(error);
+        return std::move(*out);
+    }
+}
+
+// Runs blocking `func` on `runOn` (an I/O pool, say) and resumes the awaiting
+// coroutine on the pool it was running on before, or inline if it was not on one.
+template<typename FUNC>
+auto offload(ThreadPool& runOn, FUNC func)
+{
+    using R = std::invoke_result_t<FUNC&>;
+    static_assert(!std::is_void_v<R>, "offload() needs a result; return a bool for side-effect-only work");
+
+    struct Awaiter
+    {
+        ThreadPool& runOn;
+        FUNC func;
+        std::optional<R> result;
+        std::exception_ptr error;
+
+        bool await_ready() const { return false; }
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            ThreadPool* resumeOn = ThreadPool::current();
+            runOn.post([this, h, resumeOn] {
+                try { result.emplace(func()); }
+                catch(...) { error = std::current_exception(); }
+                if(resumeOn) resumeOn->post(h);
+                else h.resume();
+            });
+        }
+        R await_resume()
+        {
+            if(error) std::rethrow_exception(error);
+            return std::move(*result);
+        }
+    };
+    return Awaiter{runOn, std::move(func), std::nullopt, nullptr};
+}
+
+// awaitable whole-file I/O, done on `io`
+inline auto readFileAsync(ThreadPool& io, std::string path)
+{
+    return offload(io, [path = std::move(path)] {
+        std::ifstream in(path, std::ios::binary);
+        if(!in) throw std::runtime_error("cannot open " + path);
+        return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    });
+}
+
+inline auto writeFileAsync(ThreadPool& io, std::string path, std::vector<char> data)
+{
+    return offload(io, [path = std::move(path), data = std::move(data)] {
+        std::ofstream out(path, std::ios::binary);
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        if(!out) throw std::runtime_error("cannot write " + path);
+        return true;
+    });
+}
+
+inline auto loadPPMAsync(ThreadPool& io, std::string path)
+{
+    return offload(io, [path = std::move(path)] { return readPPM(path); });
+}
+
+template<typename T>
+auto loadPNMAsync(ThreadPool& io, std::string path)
+{
+    return offload(io, [path = std::move(path)] { return readPNM<T>(path); });
+}
+
+// the matrix is moved into the job; the awaiter hands it back once written
+template<typename M>
+auto savePNMAsync(ThreadPool& io, std::string path, M mat)
+{
+    return offload(io, [path = std::move(path), mat = std::move(mat)]() mutable {
+        writePNM(path, mat);
+        return std::move(mat);
+    });
+}
+
+// Bounded multi-producer/multi-consumer channel for coroutines. A full channel
+// suspends senders and an empty one suspends receivers; woken coroutines are
+// resumed through `pool`, never under the channel's lock.
+template<typename T>
+class AsyncChannel
+{
+    struct Waiter
+    {
+        std::coroutine_handle<> h;
+        std::optional<T>* slot;         // receiver: where to put the item
+        T* item;                        // sender: what it wants to send
+        bool ok = false;
+    };
+
+    ThreadPool& pool;
+    size_t capacity;
+    std::mutex lock;
+    std::deque<T> items;
+    std::deque<Waiter*> senders, receivers;
+    bool closed = false;
+
+public:
+    AsyncChannel(ThreadPool& pool, size_t capacity) : pool(pool), capacity(std::max<size_t>(capacity, 1)) { }
+
+    // co_await ch.send(v): false if the channel was closed
+    auto send(T value)
+    {
+        struct Awaiter
+        {
+            AsyncChannel& ch;
+            T value;
+            Waiter waiter{};
+            bool ready = false;
+
+            bool await_ready() const { return false; }
+            bool await_suspend(std::coroutine_handle<> h)
+            {
+                std::unique_lock<std::mutex> guard(ch.lock);
+                if(ch.closed) return false;
+                if(!ch.receivers.empty())
+                {
+                    Waiter* r = ch.receivers.front();
+                    ch.receivers.pop_front();
+                    r->slot->emplace(std::move(value));
+                    guard.unlock();
+                    ch.pool.post(r->h);
+                    ready = true;
+                    return false;
+                }
+                if(ch.items.size() < ch.capacity)
+                {
+                    ch.items.push_back(std::move(value));
+                    ready = true;
+                    return false;
+                }
+                waiter = Waiter{h, nullptr, &value};
+                ch.senders.push_back(&waiter);
+                return true;
+            }
+            bool await_resume() const { return ready || waiter.ok; }
+        };
+        return Awaiter{*this, std::move(value)};
+    }
+
+    // co_await ch.receive(): nullopt once the channel is closed and drained
+    auto receive()
+    {
+        struct Awaiter
+        {
+            AsyncChannel& ch;
+            std::optional<T> result;
+            Waiter waiter{};
+
+            bool await_ready() const { return false; }
+            bool await_suspend(std::coroutine_handle<> h)
+            {
+                std::unique_lock<std::mutex> guard(ch.lock);
+                if(!ch.items.empty())
+                {
+                    result.emplace(std::move(ch.items.front()));
+                    ch.items.pop_front();
+                    // room now: admit one waiting sender
+                    if(!ch.senders.empty())
+                    {
+                        Waiter* s = ch.senders.front();
+                        ch.senders.pop_front();
+                        ch.items.push_back(std::move(*s->item));
+                        s->ok = true;
+                        guard.unlock();
+                        ch.pool.post(s->h);
+                    }
+                    return false;
+                }
+                if(ch.closed) return false;
+                waiter = Waiter{h, &result, nullptr};
+                ch.receivers.push_back(&waiter);
+                return true;
+            }
+            std::optional<T> await_resume() { return std::move(result); }
+        };
+        return Awaiter{*this, std::nullopt};
+    }
+
+    // no more sends; receivers drain what is left and then get nullopt
+    void close()
+    {
+        std::deque<Waiter*> wakeSenders, wakeReceivers;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            closed = true;
+            wakeSenders.swap(senders);
+            wakeReceivers.swap(receivers);
+        }
+        for(Waiter* w : wakeSenders) pool.post(w->h);
+        for(Waiter* w : wakeReceivers) pool.post(w->h);
+    }
+};
+
+namespace async_detail
+{
+    // what co_await on an A produces; A itself when it is not awaitable
+    template<typename A, typename = void>
+    struct AwaitResult { using type = A; };
+
+    template<typename A>
+    struct AwaitResult<A, std::enable_if_t<HasAwaitResume<A>>>
+    {
+        using type = decltype(std::declval<A&>().await_resume());
+    };
+
+    template<typename A>
+    struct AwaitResult<A, std::void_t<decltype(std::declval<A>().operator co_await())>>
+    {
+        using type = decltype(std::declval<A>().operator co_await().await_resume());
+    };
+
+    // a stage function may return a value or something awaitable (Task, offload, ...)
+    template<typename FUNC, typename In>
+    struct StageResult
+    {
+        using type = std::remove_cvref_t<typename AwaitResult<std::invoke_result_t<FUNC&, In>>::type>;
+    };
+
+    template<typename FUNC, typename In>
+    auto call(FUNC& func, In&& in) -> Task<typename StageResult<FUNC, In>::type>
+    {
+        using Raw = std::invoke_result_t<FUNC&, In>;
+        // a plain value, also when returned by reference or const
+        if constexpr(std::is_same_v<std::remove_cvref_t<Raw>, typename StageResult<FUNC, In>::type>)
+            co_return func(std::forward<In>(in));
+        else
+            co_return co_await func(std::forward<In>(in));
+    }
+
+    struct PipelineState
+    {
+        ThreadPool* pool;
+        size_t capacity;
+        std::vector<std::function<void(std::latch&)>> launchers;   // start each stage's workers
+        std::vector<std::function<void()>> closers;                 // close each channel
+        ptrdiff_t sinkWorkers = 0;
+
+        std::mutex errorLock;
+        std::exception_ptr error;
+
+        // The first exception out of any worker is kept for run() to rethrow,
+        // and every channel is closed: workers stop sending, receivers drain
+        // and see the end, so the sink still finishes.
+        void fail(std::exception_ptr e)
+        {
+            {
+                std::lock_guard<std::mutex> guard(errorLock);
+                if(error) return;
+                error = e;
+            }
+            for(auto& close : closers) close();
+        }
+    };
+
+    // the last worker of a stage to finish closes its output
+    // Workers are Detached, which would terminate on an escaping exception:
+    // they hand it to PipelineState::fail instead.
+    template<typename In, typename Out, typename FUNC>
+    Detached stageWorker(ThreadPool& pool, std::shared_ptr<AsyncChannel<In>> in, std::shared_ptr<AsyncChannel<Out>> out,
+                         std::shared_ptr<FUNC> func, std::shared_ptr<std::atomic<int>> running,
+                         std::shared_ptr<PipelineState> state)
+    {
+        co_await pool.schedule();
+        try
+        {
+            while(auto item = co_await in->receive())
+            {
+                Out result = co_await call(*func, std::move(*item));
+                if(!co_await out->send(std::move(result))) break;
+            }
+        }
+        catch(...)
+        {
+            state->fail(std::current_exception());
+        }
+        if(running->fetch_sub(1) == 1) out->close();
+    }
+
+    template<typename In, typename FUNC>
+    Detached sinkWorker(ThreadPool& pool, std::shared_ptr<AsyncChannel<In>> in, std::shared_ptr<FUNC> func, std::latch& done,
+                        std::shared_ptr<PipelineState> state)
+    {
+        co_await pool.schedule();
+        try
+        {
+            while(auto item = co_await in->receive())
+                co_await call(*func, std::move(*item));
+        }
+        catch(...)
+        {
+            state->fail(std::current_exception());
+        }
+        done.count_down();
+    }
+
+    template<typename T>
+    Detached sourceWorker(ThreadPool& pool, std::shared_ptr<std::vector<T>> inputs, std::shared_ptr<std::atomic<size_t>> next,
+                          std::shared_ptr<AsyncChannel<T>> out, std::shared_ptr<std::atomic<int>> running,
+                          std::shared_ptr<PipelineState> state)
+    {
+        co_await pool.schedule();
+        try
+        {
+            for(size_t i; (i = next->fetch_add(1)) < inputs->size();)
+                if(!co_await out->send(std::move((*inputs)[i]))) break;
+        }
+        catch(...)
+        {
+            state->fail(std::current_exception());
+        }
+        if(running->fetch_sub(1) == 1) out->close();
+    }
+}
+
+// Builder: each stage() returns a builder for the next element type.
+template<typename T>
+class PipelineBuilder
+{
+    std::shared_ptr<async_detail::PipelineState> state;
+    std::shared_ptr<AsyncChannel<T>> tail;
+
+    template<typename> friend class PipelineBuilder;
+    template<typename U> friend PipelineBuilder<U> pipeline(ThreadPool&, size_t);
+
+    // with no workers a source or stage would never close its channel and the pipeline would hang
+    static int checkedParallelism(int parallelism)
+    {
+        if(parallelism < 1)
+            throw std::invalid_argument("pipeline: parallelism must be at least 1, got " + std::to_string(parallelism));
+        return parallelism;
+    }
+
+    explicit PipelineBuilder(std::shared_ptr<async_detail::PipelineState> state)
+        : state(std::move(state)), tail(std::make_shared<AsyncChannel<T>>(*this->state->pool, this->state->capacity))
+    {
+        this->state->closers.push_back([channel = tail] { channel->close(); });
+    }
+
+public:
+    class Runnable
+    {
+        std::shared_ptr<async_detail::PipelineState> state;
+    public:
+        explicit Runnable(std::shared_ptr<async_detail::PipelineState> state) : state(std::move(state)) { }
+
+        // Starts every stage and blocks until the sink has consumed everything.
+        // If a source, stage or sink throws, the pipeline winds down and the
+        // first exception is rethrown here.
+        void run()
+        {
+            std::latch done(state->sinkWorkers);
+            for(auto& launch : state->launchers) launch(done);
+            done.wait();
+            // taken out, so the exception is ours alone once stages still winding down let go of the state
+            std::exception_ptr error;
+            {
+                std::lock_guard<std::mutex> guard(state->errorLock);
+                error = std::exchange(state->error, nullptr);
+            }
+            if(error) std::rethrow_exception(error);
+        }
+    };
+
+    // feeds `inputs` into the pipeline from `parallelism` coroutines
+    PipelineBuilder& source(std::vector<T> inputs, int parallelism = 1)
+    {
+        checkedParallelism(parallelism);
+        auto shared = std::make_shared<std::vector<T>>(std::move(inputs));
+        auto next = std::make_shared<std::atomic<size_t>>(0);
+        auto running = std::make_shared<std::atomic<int>>(parallelism);
+        auto out = tail;
+        ThreadPool* pool = state->pool;
+        std::weak_ptr<async_detail::PipelineState> weak = state;
+        state->launchers.push_back([pool, shared, next, out, running, parallelism, weak](std::latch&) {
+            for(int i = 0; i < parallelism; ++i)
+                async_detail::sourceWorker(*pool, shared, next, out, running, weak.lock());
+        });
+        return *this;
+    }
+
+    template<typename FUNC>
+    auto stage(FUNC func, int parallelism = 1)
+    {
+        using Out = typename async_detail::StageResult<FUNC, T>::type;
+        checkedParallelism(parallelism);
+        PipelineBuilder<Out> next(state);
+        auto in = tail;
+        auto out = next.tail;
+        auto f = std::make_shared<FUNC>(std::move(func));
+        auto running = std::make_shared<std::atomic<int>>(parallelism);
+        ThreadPool* pool = state->pool;
+        std::weak_ptr<async_detail::PipelineState> weak = state;
+        state->launchers.push_back([pool, in, out, f, running, parallelism, weak](std::latch&) {
+            for(int i = 0; i < parallelism; ++i)
+                async_detail::stageWorker<T, Out>(*pool, in, out, f, running, weak.lock());
+        });
+        return next;
+    }
+
+    template<typename FUNC>
+    Runnable sink(FUNC func, int parallelism = 1)
+    {
+        checkedParallelism(parallelism);
+        auto in = tail;
+        auto f = std::make_shared<FUNC>(std::move(func));
+        ThreadPool* pool = state->pool;
+        state->sinkWorkers += parallelism;
+        std::weak_ptr<async_detail::PipelineState> weak = state;
+        state->launchers.push_back([pool, in, f, parallelism, weak](std::latch& done) {
+            for(int i = 0; i < parallelism; ++i)
+                async_detail::sinkWorker<T>(*pool, in, f, done, weak.lock());
+        });
+        return Runnable(state);
+    }
+};
+
+// stages run on `pool`; every channel between two stages holds at most `capacity` items
+template<typename T>
+PipelineBuilder<T> pipeline(ThreadPool& pool, size_t capacity)
+{
+    auto state = std::make_shared<async_detail::PipelineState>();
+    state->pool = &pool;
+    state->capacity = capacity;
+    return PipelineBuilder<T>(state);
+}
+
+#endif
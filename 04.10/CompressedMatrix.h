@@ -0,0 +1,366 @@
+#ifndef __CompressedMatrix_h
+#define __CompressedMatrix_h
+
+// Read-only compressed copy of a Matrix<uint8_t> or Matrix<uint16_t>, for
+// keeping many depth maps or masks in memory at once (03.20's Matrix<uint16_t>
+// is the typical customer). Lossless:
+//
+//     CompressedMatrix<uint16_t> packed(depth);          // 64x64 tiles
+//     packed.ratio();                                    // ~4 for a noisy depth map
+//     Span<const uint16_t> r = packed.row(17);           // decoded on demand, cached
+//     uint16_t d = packed.get(17, 300);
+//     packed.decodeTile(2, 3, buf, 64);                  // one tile, no cache involved
+//     Matrix<uint16_t> back = packed.decompress();
+//
+// The matrix is cut into tiles and every row of a tile is encoded as a block:
+//   constant one value, for flat rows
+//   packed   first value, then the zigzagged deltas to the left neighbour,
+//            bit-packed per group of 16 at the width of the group's largest,
+//            so one depth edge only widens its own group
+//   runs     (value, length) pairs, for masks and invalid-depth holes,
+//            whenever that is smaller than packed
+//
+// row() and get() decode a whole band of tiles (tileSize rows) into a small
+// LRU cache, so a row-by-row scan decodes everything exactly once. The span
+// returned by row() is only valid until another band is brought in, as with
+// TiledMatrix. decodeTile() and decompress() are const and can be called
+// from several threads at once; row() and get() cannot.
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <stdint.h>
+#include <type_traits>
+#include <vector>
+
+#include "Matrix.h"
+#include "Trace.h"
+
+namespace compressed_detail
+{
+    // block mode byte
+    constexpr uint8_t CONSTANT = 0;      // one value for the whole block
+    constexpr uint8_t PACKED = 1;        // first value, then bit-packed deltas
+    constexpr uint8_t RUNS = 2;          // (value, length) pairs
+
+    constexpr int GROUP = 16;            // deltas sharing one bit width; 16*W bits is always whole bytes
+    constexpr size_t PADDING = 2*GROUP + 8;  // the unpacker reads a whole group, 8 bytes at a time
+
+    // widths are stored as nibbles, so 15 bits rounds up to 16
+    inline int widthCode(int width) { return std::min(width, 15); }
+    inline int codeWidth(int code) { return code == 15 ? 16 : code; }
+
+    template<typename T>
+    uint32_t zigzag(T delta)
+    {
+        using S = std::make_signed_t<T>;
+        const S d = static_cast<S>(delta);
+        return static_cast<T>((static_cast<T>(d) << 1) ^ static_cast<T>(d >> (sizeof(T)*8 - 1)));
+    }
+
+    template<typename T>
+    T unzigzag(uint32_t z)
+    {
+        return static_cast<T>((z >> 1) ^ (0u - (z & 1)));
+    }
+
+    // n <= GROUP deltas of W bits each, LSB first, added up from prev. The unpacking
+    // always does a full group with a compile-time W, so it unrolls into independent
+    // loads, shifts and masks; only the running sum is serial.
+    template<int W, typename T>
+    const uint8_t* unpackGroup(const uint8_t* p, int n, T prev, T* dst)
+    {
+        constexpr uint64_t MASK = (uint64_t(1) << W) - 1;
+        uint32_t z[GROUP];
+        for(int i = 0; i < GROUP; ++i)
+        {
+            uint64_t word;
+            std::memcpy(&word, p + i*W/8, sizeof(word));
+            z[i] = static_cast<uint32_t>((word >> (i*W % 8)) & MASK);
+        }
+        for(int i = 0; i < n; ++i)
+        {
+            prev = static_cast<T>(prev + unzigzag<T>(z[i]));
+            dst[i] = prev;
+        }
+        return p + (static_cast<size_t>(n)*W + 7)/8;
+    }
+
+    template<typename T, int... W>
+    const uint8_t* unpackDispatch(int width, const uint8_t* p, int n, T prev, T* dst, std::integer_sequence<int, W...>)
+    {
+        const uint8_t* end = p;
+        ((width == W + 1 ? (end = unpackGroup<W + 1>(p, n, prev, dst), true) : false) || ...);
+        return end;
+    }
+
+    // one block of n values into dst; returns the first byte after it
+    template<typename T>
+    const uint8_t* decodeBlock(const uint8_t* p, int n, T* dst)
+    {
+        const uint8_t mode = *p++;
+        if(mode == RUNS)
+        {
+            const int runs = *p++ + 1;
+            for(int r = 0; r < runs; ++r)
+            {
+                T value;
+                std::memcpy(&value, p, sizeof(T));
+                const int len = p[sizeof(T)] + 1;
+                p += sizeof(T) + 1;
+                std::fill(dst, dst + len, value);
+                dst += len;
+            }
+            return p;
+        }
+        T first;
+        std::memcpy(&first, p, sizeof(T));
+        p += sizeof(T);
+        if(mode == CONSTANT)
+        {
+            std::fill(dst, dst + n, first);
+            return p;
+        }
+
+        dst[0] = first;
+        const int groups = (n - 1 + GROUP - 1)/GROUP;
+        const uint8_t* widths = p;
+        p += (groups + 1)/2;
+        for(int g = 0; g < groups; ++g)
+        {
+            T* out = dst + 1 + g*GROUP;
+            const int len = std::min(GROUP, n - 1 - g*GROUP);
+            const int width = codeWidth((widths[g/2] >> (4*(g % 2))) & 15);
+            if(width == 0)
+                std::fill(out, out + len, out[-1]);
+            else
+                p = unpackDispatch(width, p, len, out[-1], out, std::make_integer_sequence<int, sizeof(T)*8>());
+        }
+        return p;
+    }
+
+    template<typename T>
+    void encodeBlock(const T* src, int n, std::vector<uint8_t>& out)
+    {
+        auto put = [&out](const void* data, size_t bytes) {
+            const uint8_t* b = static_cast<const uint8_t*>(data);
+            out.insert(out.end(), b, b + bytes);
+        };
+
+        int runs = 1;
+        for(int i = 1; i < n; ++i) runs += src[i] != src[i - 1];
+        if(runs == 1)
+        {
+            out.push_back(CONSTANT);
+            put(&src[0], sizeof(T));
+            return;
+        }
+
+        // the width of each group of deltas
+        const int groups = (n - 1 + GROUP - 1)/GROUP;
+        std::vector<int> widths(groups);
+        size_t packedBytes = 1 + sizeof(T) + (groups + 1)/2;
+        for(int g = 0; g < groups; ++g)
+        {
+            const int len = std::min(GROUP, n - 1 - g*GROUP);
+            uint32_t all = 0;
+            for(int i = 1 + g*GROUP; i < 1 + g*GROUP + len; ++i)
+                all |= zigzag(static_cast<T>(src[i] - src[i - 1]));
+            int width = 0;
+            while(all >> width) ++width;
+            widths[g] = codeWidth(widthCode(width));
+            packedBytes += (static_cast<size_t>(len)*widths[g] + 7)/8;
+        }
+
+        const size_t runBytes = 2 + static_cast<size_t>(runs)*(sizeof(T) + 1);
+        if(runBytes < packedBytes)
+        {
+            out.push_back(RUNS);
+            out.push_back(static_cast<uint8_t>(runs - 1));
+            for(int i = 0; i < n;)
+            {
+                int j = i + 1;
+                while(j < n && src[j] == src[i]) ++j;
+                put(&src[i], sizeof(T));
+                out.push_back(static_cast<uint8_t>(j - i - 1));
+                i = j;
+            }
+            return;
+        }
+
+        out.push_back(PACKED);
+        put(&src[0], sizeof(T));
+        for(int g = 0; g < groups; g += 2)
+            out.push_back(static_cast<uint8_t>(widthCode(widths[g]) | (g + 1 < groups ? widthCode(widths[g + 1]) << 4 : 0)));
+        // at most 16 bits at a bit offset below 8 touch 3 bytes; 2 spare bytes keep that in bounds.
+        // A flat group (width 0) has no bytes at all.
+        for(int g = 0; g < groups; ++g)
+        {
+            const int len = std::min(GROUP, n - 1 - g*GROUP), width = widths[g];
+            if(width == 0) continue;
+            const size_t start = out.size(), bytes = (static_cast<size_t>(len)*width + 7)/8;
+            out.resize(start + bytes + 2, 0);
+            for(int k = 0; k < len; ++k)
+            {
+                const int i = 1 + g*GROUP + k;
+                const size_t bit = static_cast<size_t>(k)*width;
+                const uint32_t z = zigzag(static_cast<T>(src[i] - src[i - 1])) << (bit % 8);
+                out[start + bit/8] |= static_cast<uint8_t>(z);
+                out[start + bit/8 + 1] |= static_cast<uint8_t>(z >> 8);
+                out[start + bit/8 + 2] |= static_cast<uint8_t>(z >> 16);
+            }
+            out.resize(start + bytes);
+        }
+    }
+}
+
+template<typename T>
+class CompressedMatrix : public MatrixCore
+{
+    static_assert(std::is_same<T, uint8_t>::value || std::is_same<T, uint16_t>::value,
+                  "CompressedMatrix stores uint8_t or uint16_t elements");
+
+public:
+    int nRows, nCols;
+
+    // tileSize is at most 256, so a run length or block length fits in a byte
+    explicit CompressedMatrix(const Matrix<T>& src, int tileSize = 64, int cachedBands = 2)
+        : nRows(src.nRows), nCols(src.nCols), tileSize(checkedTileSize(tileSize)),
+          tilesPerRow((src.nCols + this->tileSize - 1)/this->tileSize),
+          tilesPerCol((src.nRows + this->tileSize - 1)/this->tileSize)
+    {
+        if(cachedBands < 1)
+            throw std::invalid_argument("CompressedMatrix: at least one cached band is needed");
+        TRACE_SPAN("CompressedMatrix::compress");
+
+        tileOffsets.reserve(static_cast<size_t>(tilesPerRow)*tilesPerCol + 1);
+        for(int tr = 0; tr < tilesPerCol; ++tr)
+            for(int tc = 0; tc < tilesPerRow; ++tc)
+            {
+                tileOffsets.push_back(bytes.size());
+                const int rows = tileRows(tr), cols = tileCols(tc);
+                for(int r = 0; r < rows; ++r)
+                    compressed_detail::encodeBlock(&src.unchecked(tr*tileSize + r, tc*tileSize), cols, bytes);
+            }
+        tileOffsets.push_back(bytes.size());
+        bytes.resize(bytes.size() + compressed_detail::PADDING, 0);
+        bytes.shrink_to_fit();
+
+        bands.resize(cachedBands);
+    }
+
+    size_t numElements() const { return static_cast<size_t>(nRows)*nCols; }
+    int tileDim() const { return tileSize; }
+    int numTileRows() const { return tilesPerCol; }
+    int numTileCols() const { return tilesPerRow; }
+
+    size_t rawBytes() const { return numElements()*sizeof(T); }
+    // encoded blocks plus the tile index; the band cache is not counted
+    size_t compressedBytes() const { return bytes.size() + tileOffsets.size()*sizeof(size_t); }
+    double ratio() const { return compressedBytes() == 0 ? 0.0 : double(rawBytes())/compressedBytes(); }
+    size_t cacheBytes() const { return bands.size()*static_cast<size_t>(tileSize)*nCols*sizeof(T); }
+
+    // Decodes tile (tileRow, tileCol) into dst, row r of the tile at dst + r*dstStride.
+    // Edge tiles are smaller than tileSize; only their valid part is written.
+    void decodeTile(int tileRow, int tileCol, T* dst, size_t dstStride) const
+    {
+        if(tileRow < 0 || tileRow >= tilesPerCol || tileCol < 0 || tileCol >= tilesPerRow)
+            throw std::out_of_range("CompressedMatrix tile (" + std::to_string(tileRow) + ", " +
+                                    std::to_string(tileCol) + ") out of range");
+        const uint8_t* p = bytes.data() + tileOffsets[static_cast<size_t>(tileRow)*tilesPerRow + tileCol];
+        const int rows = tileRows(tileRow), cols = tileCols(tileCol);
+        for(int r = 0; r < rows; ++r)
+            p = compressed_detail::decodeBlock(p, cols, dst + r*dstStride);
+    }
+
+    Matrix<T> decompress() const
+    {
+        TRACE_SPAN("CompressedMatrix::decompress");
+        Matrix<T> out(nRows, nCols);
+        for(int tr = 0; tr < tilesPerCol; ++tr)
+            decodeBand(tr, out.mem + static_cast<size_t>(tr)*tileSize*nCols);
+        return out;
+    }
+
+    Span<const T> row(int i)
+    {
+        if(i < 0 || i >= nRows) throw std::out_of_range("CompressedMatrix row " + std::to_string(i) + " out of range");
+        const Band& band = fetch(i/tileSize);
+        return {band.data.data() + static_cast<size_t>(i % tileSize)*nCols, static_cast<size_t>(nCols)};
+    }
+
+    T get(int row, int col)
+    {
+        if(col < 0 || col >= nCols) throw std::out_of_range("CompressedMatrix column " + std::to_string(col) + " out of range");
+        return this->row(row)[col];
+    }
+
+    size_t hits() const { return nHits; }
+    size_t misses() const { return nMisses; }
+    void resetCounters() { nHits = nMisses = 0; }
+
+    void load() override
+    {
+        std::cout << "CompressedMatrix loaded! (" << rawBytes() << " -> " << compressedBytes() << " bytes)" << std::endl;
+    }
+
+private:
+    struct Band
+    {
+        int index = -1;
+        size_t lastUse = 0;
+        std::vector<T> data;
+    };
+
+    int tileSize;
+    int tilesPerRow, tilesPerCol;
+    std::vector<uint8_t> bytes;
+    std::vector<size_t> tileOffsets;    // where each tile starts in `bytes`, row-major over tiles
+
+    std::vector<Band> bands;            // a handful at most, so a linear LRU scan is fine
+    size_t clock = 0;
+    size_t nHits = 0, nMisses = 0;
+
+    // before the tile counts divide by it
+    static int checkedTileSize(int tileSize)
+    {
+        if(tileSize < 1 || tileSize > 256)
+            throw std::invalid_argument("CompressedMatrix: tileSize must be in 1..256");
+        return tileSize;
+    }
+
+    int tileRows(int tr) const { return std::min(tileSize, nRows - tr*tileSize); }
+    int tileCols(int tc) const { return std::min(tileSize, nCols - tc*tileSize); }
+
+    // the tiles of one band are stored back to back, so this is one sequential pass
+    void decodeBand(int tr, T* dst) const
+    {
+        for(int tc = 0; tc < tilesPerRow; ++tc)
+            decodeTile(tr, tc, dst + static_cast<size_t>(tc)*tileSize, nCols);
+    }
+
+    const Band& fetch(int index)
+    {
+        Band* victim = &bands[0];
+        for(Band& b : bands)
+        {
+            if(b.index == index)
+            {
+                ++nHits;
+                b.lastUse = ++clock;
+                return b;
+            }
+            if(b.lastUse < victim->lastUse) victim = &b;
+        }
+        ++nMisses;
+        TRACE_SPAN("CompressedMatrix band decode");
+        victim->data.resize(static_cast<size_t>(tileSize)*nCols);
+        decodeBand(index, victim->data.data());
+        victim->index = index;
+        victim->lastUse = ++clock;
+        return *victim;
+    }
+};
+
+#endif
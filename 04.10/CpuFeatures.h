@@ -0,0 +1,85 @@
+#ifndef __CpuFeatures_h
+#define __CpuFeatures_h
+
+// Which instruction set the hot kernels run with. Detected once, on first use.
+//
+// MATRIX_ISA=baseline|sse42|avx2|avx512|avx512vnni in the environment forces a path
+// (for testing and for comparing variants on one machine). Asking for more
+// than the CPU supports falls back to the best path it does support.
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace cpu
+{
+    // ordered: every level implies the ones before it
+    enum class Isa { Baseline = 0, SSE42, AVX2, AVX512, AVX512VNNI };
+
+    // every level, lowest first; handy for running each variant side by side
+    inline constexpr Isa allIsas[] = {Isa::Baseline, Isa::SSE42, Isa::AVX2, Isa::AVX512, Isa::AVX512VNNI};
+
+    inline const char* isaName(Isa isa)
+    {
+        switch(isa)
+        {
+            case Isa::SSE42:  return "sse42";
+            case Isa::AVX2:   return "avx2";
+            case Isa::AVX512: return "avx512";
+            case Isa::AVX512VNNI: return "avx512vnni";
+            default:          return "baseline";
+        }
+    }
+
+    // What the hardware (and OS, for the wide register state) can run. A level
+    // needs every feature its kernel variants are compiled for, the target(...)
+    // strings in Kernels.h, and those of the levels below it: hypervisors can
+    // hide single features such as BMI2 or F16C, and a variant using one would
+    // die with SIGILL there. Keep the two lists in step.
+    inline Isa detectIsa()
+    {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        __builtin_cpu_init();
+        const bool sse42 = __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("sse4.1") &&
+                           __builtin_cpu_supports("ssse3") && __builtin_cpu_supports("popcnt");
+        const bool avx2 = sse42 && __builtin_cpu_supports("avx") && __builtin_cpu_supports("avx2") &&
+                          __builtin_cpu_supports("fma") && __builtin_cpu_supports("bmi2") && __builtin_cpu_supports("f16c");
+        const bool avx512 = avx2 && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+                            __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx512dq");
+        if(avx512) return __builtin_cpu_supports("avx512vnni") ? Isa::AVX512VNNI : Isa::AVX512;
+        if(avx2) return Isa::AVX2;
+        if(sse42) return Isa::SSE42;
+#endif
+        return Isa::Baseline;
+    }
+
+    inline Isa selectIsa()
+    {
+        Isa detected = detectIsa();
+        const char* forced = std::getenv("MATRIX_ISA");
+        if(!forced || !*forced) return detected;
+
+        for(Isa isa : allIsas)
+        {
+            if(std::strcmp(forced, isaName(isa)) != 0) continue;
+            if(isa > detected)
+            {
+                std::cerr << "MATRIX_ISA=" << forced << " is not supported by this CPU, using "
+                          << isaName(detected) << std::endl;
+                return detected;
+            }
+            return isa;
+        }
+        std::cerr << "MATRIX_ISA=" << forced << " is unknown, using " << isaName(detected) << std::endl;
+        return detected;
+    }
+
+    // the path the kernels are bound to for the lifetime of the process
+    inline Isa activeIsa()
+    {
+        static const Isa isa = selectIsa();
+        return isa;
+    }
+}
+
+#endif
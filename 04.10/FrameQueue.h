@@ -0,0 +1,226 @@
+#ifndef __FrameQueue_h
+#define __FrameQueue_h
+
+// Bounded lock-free queues for handing Image/Matrix frames between pipeline
+// threads, and a FrameChannel that pairs one with a return queue so consumed
+// frame buffers go back to the producer instead of being freed.
+//
+//     FrameChannel<Image> chan(8);                   // SPSC, 8 frames in flight
+//     // producer
+//     Image img = chan.acquire(720, 1280);           // recycled buffer (allocates only while warming up)
+//     render(img);
+//     while(!chan.send(img)) std::this_thread::yield();
+//     // consumer
+//     Image img;
+//     if(chan.receive(img)) { use(img); chan.recycle(img); }
+//
+// Frames are moved through the queues, and moving a Matrix only moves its
+// pointer, so no pixel is ever copied. With enough buffers in circulation
+// steady-state operation does no allocation at all.
+//
+// SpscQueue: one producer thread, one consumer thread.
+// MpmcQueue: any number of each (Vyukov's bounded queue, a sequence number per cell).
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+#include "Matrix.h"
+
+namespace frame_queue_detail
+{
+    inline size_t roundUpToPowerOfTwo(size_t n)
+    {
+        size_t p = 1;
+        while(p < n) p <<= 1;
+        return p;
+    }
+
+    constexpr size_t CACHE_LINE = 64;
+}
+
+template<typename T>
+class SpscQueue
+{
+    using Index = size_t;
+    static constexpr size_t LINE = frame_queue_detail::CACHE_LINE;
+
+    const size_t mask;
+    std::unique_ptr<T[]> cells;
+
+    // producer and consumer each own a line; each keeps a stale copy of the other's index
+    // and only re-reads the shared one when the stale copy says full/empty
+    alignas(LINE) std::atomic<Index> tail{0};       // next slot to write
+    Index headCache = 0;
+    alignas(LINE) std::atomic<Index> head{0};       // next slot to read
+    Index tailCache = 0;
+
+public:
+    explicit SpscQueue(size_t capacity)
+        : mask(frame_queue_detail::roundUpToPowerOfTwo(capacity) - 1), cells(new T[mask + 1])
+    {
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    void operator=(const SpscQueue&) = delete;
+
+    size_t capacity() const { return mask + 1; }
+
+    // producer only; on success `item` is moved from
+    bool push(T& item)
+    {
+        const Index t = tail.load(std::memory_order_relaxed);
+        if(t - headCache > mask)
+        {
+            headCache = head.load(std::memory_order_acquire);
+            if(t - headCache > mask) return false;
+        }
+        cells[t & mask] = std::move(item);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer only
+    bool pop(T& out)
+    {
+        const Index h = head.load(std::memory_order_relaxed);
+        if(h == tailCache)
+        {
+            tailCache = tail.load(std::memory_order_acquire);
+            if(h == tailCache) return false;
+        }
+        out = std::move(cells[h & mask]);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+template<typename T>
+class MpmcQueue
+{
+    static constexpr size_t LINE = frame_queue_detail::CACHE_LINE;
+
+    struct alignas(LINE) Cell
+    {
+        std::atomic<size_t> sequence;
+        T item;
+    };
+
+    const size_t mask;
+    std::unique_ptr<Cell[]> cells;
+    alignas(LINE) std::atomic<size_t> enqueuePos{0};
+    alignas(LINE) std::atomic<size_t> dequeuePos{0};
+
+public:
+    explicit MpmcQueue(size_t capacity)
+        : mask(frame_queue_detail::roundUpToPowerOfTwo(std::max<size_t>(capacity, 2)) - 1), cells(new Cell[mask + 1])
+    {
+        for(size_t i = 0; i <= mask; ++i) cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    MpmcQueue(const MpmcQueue&) = delete;
+    void operator=(const MpmcQueue&) = delete;
+
+    size_t capacity() const { return mask + 1; }
+
+    // A cell is free for position `pos` when its sequence equals pos, and holds
+    // the item for `pos` when its sequence is pos + 1.
+    bool push(T& item)
+    {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        for(;;)
+        {
+            Cell& cell = cells[pos & mask];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+            if(diff == 0)
+            {
+                if(enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.item = std::move(item);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if(diff < 0)
+                return false;       // full
+            else
+                pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    bool pop(T& out)
+    {
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        for(;;)
+        {
+            Cell& cell = cells[pos & mask];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+            if(diff == 0)
+            {
+                if(dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    out = std::move(cell.item);
+                    cell.sequence.store(pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if(diff < 0)
+                return false;       // empty
+            else
+                pos = dequeuePos.load(std::memory_order_relaxed);
+        }
+    }
+};
+
+// Frames forward, empty buffers back. The queue flavour is a template-template
+// parameter: FrameChannel<Image> for one producer and one consumer,
+// FrameChannel<Image, MpmcQueue> for several of either.
+template<typename T, template<typename> class Queue = SpscQueue>
+class FrameChannel
+{
+    Queue<T> frames;
+    Queue<T> spares;
+    std::atomic<size_t> nAllocations{0};
+
+public:
+    explicit FrameChannel(size_t capacity) : frames(capacity), spares(capacity + 1)
+    {
+    }
+
+    // Producer: a buffer of the given shape, recycled when one is available.
+    // Contents are whatever the previous frame left there.
+    T acquire(int nRows, int nCols)
+    {
+        T buffer;
+        if(spares.pop(buffer) && buffer.mem)
+        {
+            if(buffer.nRows != nRows || buffer.nCols != nCols) buffer.init(nRows, nCols);
+            return buffer;
+        }
+        nAllocations.fetch_add(1, std::memory_order_relaxed);
+        return T(nRows, nCols);
+    }
+
+    // producer: false when the channel is full (frame stays with the caller)
+    bool send(T& frame) { return frames.push(frame); }
+
+    // Consumer: false when nothing is waiting. Whatever `frame` held is released,
+    // so recycle() the previous frame first.
+    bool receive(T& frame) { return frames.pop(frame); }
+
+    // Consumer: hand a finished frame back. If the return queue is full the
+    // buffer is simply freed (there are already enough in circulation).
+    void recycle(T& frame)
+    {
+        if(!spares.push(frame)) frame.clear();
+    }
+
+    // how many buffers acquire() had to allocate so far
+    size_t allocations() const { return nAllocations.load(std::memory_order_relaxed); }
+};
+
+#endif
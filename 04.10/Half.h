@@ -0,0 +1,141 @@
+#ifndef __Half_h
+#define __Half_h
+
+// 16 bit floating-point element types, for matrices that tolerate reduced
+// precision and would rather have half the memory and bandwidth:
+//
+//   float16    IEEE 754 binary16: 5 bit exponent, 10 bit mantissa. About 3
+//              decimal digits over +-65504, subnormals down to 6e-8.
+//   bfloat16   the top half of a float: float's 8 bit exponent (same range),
+//              7 bit mantissa (about 2 digits).
+//
+// Both are storage types: they convert to and from float implicitly and all
+// arithmetic happens in float, so a Matrix<float16> can be read and written
+// like a Matrix<float>.
+//
+//     Matrix<float16> h(rows, cols);
+//     h(0, 0) = 1.5f;
+//     float x = h(0, 0)*2;                    // computed in float
+//
+// Conversions round to nearest even and keep infinities and NaNs. The
+// scalar ones here use F16C when the build targets it (-mf16c, -march=
+// native); for whole matrices use the bulk conversions in Kernels.h
+// (convert, sum, minMax, transformInFloat), which are dispatched at run time.
+
+#include <cstring>
+#include <stdint.h>
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+namespace half_detail
+{
+    inline uint32_t bitsOf(float f)
+    {
+        uint32_t u;
+        std::memcpy(&u, &f, sizeof u);
+        return u;
+    }
+
+    inline float floatOf(uint32_t u)
+    {
+        float f;
+        std::memcpy(&f, &u, sizeof f);
+        return f;
+    }
+
+    // Branch-free, so the bulk loops in Kernels.h vectorize them. Subnormals go
+    // through the FPU: adding or subtracting a power of two lines the mantissa up
+    // and rounds it in one step.
+    inline uint16_t floatToHalfBits(float f)
+    {
+        uint32_t x = bitsOf(f);
+        const uint32_t sign = x & 0x80000000u;
+        x ^= sign;
+        // rebias the exponent and round the 13 dropped bits; a carry out of the
+        // mantissa bumps the exponent, up to infinity
+        const uint32_t normal = (x + ((15u - 127u) << 23) + 0xfff + ((x >> 13) & 1)) >> 13;
+        const uint32_t subnormal = bitsOf(floatOf(x) + 0.5f) - 0x3f000000u;
+        const uint32_t special = x > 0x7f800000u ? 0x7e00u : 0x7c00u;         // NaN, or overflow to infinity
+        // masks rather than ?: so GCC keeps the float add unconditional (it will not
+        // if-convert a possibly trapping FP operation back out of a branch)
+        const uint32_t tiny = 0u - uint32_t(x < 0x38800000u), huge = 0u - uint32_t(x >= 0x47800000u);
+        const uint32_t h = (((subnormal & tiny) | (normal & ~tiny)) & ~huge) | (special & huge);
+        return static_cast<uint16_t>(h | (sign >> 16));
+    }
+
+    inline float halfBitsToFloat(uint16_t h)
+    {
+        const uint32_t shifted = (h & 0x7fffu) << 13;
+        const uint32_t exponent = shifted & 0x0f800000u;
+        uint32_t x = shifted + ((127u - 15u) << 23);
+        x += exponent == 0x0f800000u ? (128u - 16u) << 23 : 0;                // infinity, NaN
+        const uint32_t subnormal = bitsOf(floatOf(x + (1u << 23)) - floatOf(113u << 23));
+        const uint32_t tiny = 0u - uint32_t(exponent == 0);
+        x = (subnormal & tiny) | (x & ~tiny);
+        return floatOf(x | (uint32_t(h & 0x8000u) << 16));
+    }
+
+    inline uint16_t floatToBfloatBits(float f)
+    {
+        const uint32_t x = bitsOf(f);
+        const uint32_t rounded = (x + 0x7fff + ((x >> 16) & 1)) >> 16;
+        // NaNs are truncated and kept quiet, rounding could turn them into infinity
+        return static_cast<uint16_t>((x & 0x7fffffffu) > 0x7f800000u ? (x >> 16) | 0x40 : rounded);
+    }
+
+    inline float bfloatBitsToFloat(uint16_t b) { return floatOf(uint32_t(b) << 16); }
+}
+
+struct float16
+{
+    uint16_t bits;
+
+    float16() : bits(0) { }
+    float16(float f)
+#if defined(__F16C__)
+        : bits(static_cast<uint16_t>(_cvtss_sh(f, _MM_FROUND_TO_NEAREST_INT)))
+#else
+        : bits(half_detail::floatToHalfBits(f))
+#endif
+    {
+    }
+
+    operator float() const
+    {
+#if defined(__F16C__)
+        return _cvtsh_ss(bits);
+#else
+        return half_detail::halfBitsToFloat(bits);
+#endif
+    }
+
+    static float16 fromBits(uint16_t bits)
+    {
+        float16 h;
+        h.bits = bits;
+        return h;
+    }
+};
+
+struct bfloat16
+{
+    uint16_t bits;
+
+    bfloat16() : bits(0) { }
+    bfloat16(float f) : bits(half_detail::floatToBfloatBits(f)) { }
+
+    operator float() const { return half_detail::bfloatBitsToFloat(bits); }
+
+    static bfloat16 fromBits(uint16_t bits)
+    {
+        bfloat16 b;
+        b.bits = bits;
+        return b;
+    }
+};
+
+static_assert(sizeof(float16) == 2 && sizeof(bfloat16) == 2, "16 bit storage");
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef __HugePages_h
+#define __HugePages_h
+
+// Huge page backing for big matrices. With 4 KB pages a random access into
+// a multi-GB buffer almost always misses the TLB (a few thousand entries
+// cover a few MB) and pays a page walk on top of the cache miss; 2 MB pages
+// cover 512 times as much.
+//
+//     Matrix<float> big(rows, cols, hugepages::transparent());
+//     printf("%zu MB on huge pages\n", hugepages::backedBytes(big.mem, bytes) >> 20);
+//
+// hugepages::Allocator is a MatrixAllocator. Matrices from `threshold`
+// bytes up get a 2 MB aligned anonymous mapping; smaller ones get ordinary
+// memory, where huge pages would only waste space.
+//
+//   Transparent   madvise(MADV_HUGEPAGE) on the mapping: the kernel backs it
+//                 with huge pages as it is touched, as far as it has them
+//                 (THP enabled = "madvise" or "always")
+//   HugeTlb       MAP_HUGETLB, pages from the reserved hugetlbfs pool
+//                 (vm.nr_hugepages); guaranteed huge, but only if reserved
+//
+// Both fall back without failing: a HugeTlb request the pool cannot satisfy
+// becomes a Transparent one, and where THP is off the mapping simply keeps
+// 4 KB pages. backedBytes() tells what a buffer actually got. Elsewhere
+// than Linux everything is ordinary memory.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <stdint.h>
+
+#include "Matrix.h"
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace hugepages
+{
+    constexpr size_t HUGE_PAGE = size_t(2) << 20;
+
+    enum class Mode { Transparent, HugeTlb };
+
+    // Bytes of [p, p + bytes) on huge pages right now (AnonHugePages and
+    // hugetlb of the mappings it overlaps, from /proc/self/smaps); 0 where
+    // that cannot be read.
+    inline size_t backedBytes(const void* p, size_t bytes)
+    {
+        size_t backed = 0;
+#if defined(__linux__)
+        FILE* smaps = std::fopen("/proc/self/smaps", "r");
+        if(!smaps) return 0;
+        const uintptr_t lo = reinterpret_cast<uintptr_t>(p), hi = lo + bytes;
+        bool inside = false;
+        char line[512];
+        while(std::fgets(line, sizeof line, smaps))
+        {
+            unsigned long start, end, kb;
+            char perms[8], key[64];
+            // a mapping's header ("start-end perms offset ..."), then its "Key: value kB" lines
+            if(std::sscanf(line, "%lx-%lx %7s", &start, &end, perms) == 3) inside = start < hi && end > lo;
+            else if(inside && std::sscanf(line, "%63[^:]: %lu kB", key, &kb) == 2 &&
+                    (std::strcmp(key, "AnonHugePages") == 0 || std::strcmp(key, "Private_Hugetlb") == 0 ||
+                     std::strcmp(key, "Shared_Hugetlb") == 0))
+                backed += size_t(kb) << 10;
+        }
+        std::fclose(smaps);
+#else
+        (void)p;
+#endif
+        return std::min(backed, bytes);
+    }
+
+    class Allocator : public MatrixAllocator
+    {
+    public:
+        explicit Allocator(Mode mode = Mode::Transparent, size_t threshold = size_t(32) << 20)
+            : mode(mode), threshold(threshold)
+        {
+        }
+
+        void* allocate(size_t rows, size_t rowBytes) const override
+        {
+            const size_t bytes = rows*rowBytes;
+#if defined(__linux__)
+            if(bytes >= threshold)
+            {
+                const size_t length = mappedLength(bytes);
+                if(mode == Mode::HugeTlb)
+                {
+                    void* p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+                    if(p != MAP_FAILED) return p;
+                }
+                // over-allocate by a huge page and trim, so the start is 2 MB aligned
+                void* raw = mmap(nullptr, length + HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if(raw == MAP_FAILED) throw std::bad_alloc();
+                char* base = static_cast<char*>(raw);
+                char* aligned = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(base) + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1));
+                if(aligned > base) munmap(base, aligned - base);
+                if(aligned + length < base + length + HUGE_PAGE) munmap(aligned + length, base + HUGE_PAGE - aligned);
+                madvise(aligned, length, MADV_HUGEPAGE);        // fails harmlessly where THP is off
+                return aligned;
+            }
+#endif
+            return ::operator new(bytes, std::align_val_t(64));
+        }
+
+        void deallocate(void* p, size_t bytes) const override
+        {
+#if defined(__linux__)
+            if(bytes >= threshold)
+            {
+                munmap(p, mappedLength(bytes));
+                return;
+            }
+#endif
+            ::operator delete(p, std::align_val_t(64));
+        }
+
+    private:
+        Mode mode;
+        size_t threshold;
+
+        // whole huge pages, which hugetlb mappings have to be
+        static size_t mappedLength(size_t bytes) { return (bytes + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1); }
+    };
+
+    // shared instances with the default 32 MB threshold
+    inline const Allocator& transparent()
+    {
+        static const Allocator a(Mode::Transparent);
+        return a;
+    }
+
+    inline const Allocator& hugeTlb()
+    {
+        static const Allocator a(Mode::HugeTlb);
+        return a;
+    }
+}
+
+#endif
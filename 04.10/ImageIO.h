@@ -0,0 +1,241 @@
+#ifndef __ImageIO_h
+#define __ImageIO_h
+
+// Netpbm I/O for Matrix/Image: binary PGM (P5) and PPM (P6).
+//
+// Whole-image helpers:
+//     auto img = readPPM("in.ppm");                 // Image
+//     auto depth = readPNM<uint16_t>("depth.pgm");  // Matrix<uint16_t>
+//     writePNM("out.pgm", depth);
+//
+// Streaming: a reader/writer moves N rows at a time through a strip
+// Matrix that the caller owns and reuses, so the whole image never has
+// to be resident.
+//     PnmReader<Color> in("big.ppm");
+//     PnmWriter<Color> out("big_out.ppm", in.width(), in.height());
+//     Image strip(64, in.width());
+//     while(int n = in.readRows(strip)) { filter(strip, n); out.writeRows(strip, n); }
+//     out.close();                                  // throws if rows are missing or a write failed
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <stdint.h>
+#include <vector>
+
+#include "Matrix.h"
+
+// which pixel types map to which netpbm flavour
+template<typename T> struct PnmTraits;
+
+template<> struct PnmTraits<Color>
+{
+    static constexpr char magic = '6';
+    static constexpr int channels = 3;
+    static constexpr int maxVal = 255;
+};
+
+template<> struct PnmTraits<uint8_t>
+{
+    static constexpr char magic = '5';
+    static constexpr int channels = 1;
+    static constexpr int maxVal = 255;
+};
+
+template<> struct PnmTraits<uint16_t>
+{
+    static constexpr char magic = '5';
+    static constexpr int channels = 1;
+    static constexpr int maxVal = 65535;
+};
+
+namespace pnm_detail
+{
+    // PNM stores 16 bit samples big-endian, we keep them native in memory
+    inline void swapBytes(uint16_t* ptr, size_t n)
+    {
+        for(size_t i = 0; i < n; ++i)
+            ptr[i] = static_cast<uint16_t>((ptr[i] << 8) | (ptr[i] >> 8));
+    }
+
+    inline bool isLittleEndian()
+    {
+        const uint16_t probe = 1;
+        return *reinterpret_cast<const uint8_t*>(&probe) == 1;
+    }
+
+    template<typename T>
+    void toFileOrder(T* ptr, size_t n)
+    {
+        if constexpr(sizeof(T) == 2)
+            if(isLittleEndian()) swapBytes(ptr, n);
+    }
+
+    // header tokens are separated by whitespace and may be interleaved with '#' comments
+    inline int readHeaderInt(std::istream& in)
+    {
+        int c = in.get();
+        while(in)
+        {
+            if(c == '#')
+                while(in && c != '\n') c = in.get();
+            else if(c == ' ' || c == '\t' || c == '\n' || c == '\r')
+                c = in.get();
+            else
+                break;
+        }
+        if(!in || c < '0' || c > '9')
+            throw std::runtime_error("pnm: malformed header");
+        int value = 0;
+        while(in && c >= '0' && c <= '9')
+        {
+            value = value*10 + (c - '0');
+            c = in.get();
+        }
+        // the single whitespace after maxval (start of raster) was consumed above
+        return value;
+    }
+}
+
+template<typename T>
+class PnmReader
+{
+    std::ifstream in;
+    int nCols = 0, nRows = 0;
+    int rowsRead = 0;
+
+public:
+    explicit PnmReader(const std::string& path) : in(path, std::ios::binary)
+    {
+        if(!in) throw std::runtime_error("pnm: cannot open " + path);
+        char p = 0, magic = 0;
+        in.get(p).get(magic);
+        if(p != 'P' || magic != PnmTraits<T>::magic)
+            throw std::runtime_error("pnm: " + path + " is not a P" + PnmTraits<T>::magic + " file");
+        nCols = pnm_detail::readHeaderInt(in);
+        nRows = pnm_detail::readHeaderInt(in);
+        int maxVal = pnm_detail::readHeaderInt(in);
+        // the sample width follows maxval: one byte up to 255, two bytes above
+        if(maxVal <= 0 || maxVal > PnmTraits<T>::maxVal || (sizeof(T) == 2) != (maxVal > 255))
+            throw std::runtime_error("pnm: unsupported maxval " + std::to_string(maxVal) + " in " + path);
+    }
+
+    int width() const { return nCols; }
+    int height() const { return nRows; }
+    int rowsLeft() const { return nRows - rowsRead; }
+
+    // Fills the first rows of `strip` (which must be `width()` wide) and returns how many
+    // were read; 0 once the image is exhausted. The strip is never reallocated.
+    int readRows(Matrix<T>& strip)
+    {
+        if(strip.nCols != nCols)
+            throw std::runtime_error("pnm: strip width does not match image width");
+        int n = std::min(strip.nRows, rowsLeft());
+        if(n <= 0) return 0;
+        TRACE_SPAN("PnmReader::readRows");
+        size_t count = static_cast<size_t>(n)*nCols;
+        in.read(reinterpret_cast<char*>(strip.mem), count*sizeof(T));
+        if(!in) throw std::runtime_error("pnm: unexpected end of raster");
+        pnm_detail::toFileOrder(strip.mem, count);
+        rowsRead += n;
+        return n;
+    }
+};
+
+template<typename T>
+class PnmWriter
+{
+    std::ofstream out;
+    int nCols, nRows;
+    int rowsWritten = 0;
+    std::vector<T> rowBuffer;           // one row in file byte order, for 16 bit samples
+
+public:
+    PnmWriter(const std::string& path, int nCols, int nRows) : out(path, std::ios::binary), nCols(nCols), nRows(nRows)
+    {
+        if(!out) throw std::runtime_error("pnm: cannot open " + path);
+        out << 'P' << PnmTraits<T>::magic << '\n' << nCols << ' ' << nRows << '\n' << PnmTraits<T>::maxVal << '\n';
+    }
+
+    int rowsLeft() const { return nRows - rowsWritten; }
+
+    // Writes the first `n` rows of `strip`. The strip is left alone: 16 bit samples on a
+    // little-endian machine are byte-swapped a row at a time in a buffer of our own.
+    void writeRows(const Matrix<T>& strip, int n)
+    {
+        if(strip.nCols != nCols || n > strip.nRows || n > rowsLeft())
+            throw std::runtime_error("pnm: strip does not fit the image being written");
+        TRACE_SPAN("PnmWriter::writeRows");
+        if(sizeof(T) == 2 && pnm_detail::isLittleEndian())
+        {
+            rowBuffer.resize(nCols);
+            for(int i = 0; i < n; ++i)
+            {
+                std::copy(strip.mem + static_cast<size_t>(i)*nCols, strip.mem + static_cast<size_t>(i + 1)*nCols,
+                          rowBuffer.begin());
+                pnm_detail::toFileOrder(rowBuffer.data(), rowBuffer.size());
+                out.write(reinterpret_cast<const char*>(rowBuffer.data()), rowBuffer.size()*sizeof(T));
+            }
+        }
+        else
+            out.write(reinterpret_cast<const char*>(strip.mem), static_cast<size_t>(n)*nCols*sizeof(T));
+        if(!out) throw std::runtime_error("pnm: write failed");
+        rowsWritten += n;
+    }
+
+    void writeRows(const Matrix<T>& strip) { writeRows(strip, strip.nRows); }
+
+    // Flushes and closes the file, throwing if rows are missing or the write
+    // failed. Closing again does nothing.
+    void close()
+    {
+        if(!out.is_open()) return;
+        const int missing = rowsLeft();
+        out.close();
+        if(!out) throw std::runtime_error("pnm: write failed");
+        if(missing > 0) throw std::runtime_error("pnm: closed with " + std::to_string(missing) + " rows missing");
+    }
+
+    // closes too, but can only report a failure on std::cerr
+    ~PnmWriter()
+    {
+        try
+        {
+            close();
+        }
+        catch(const std::exception& e)
+        {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+};
+
+// whole-image convenience wrappers: the image itself is the (only) strip
+template<typename T>
+Matrix<T> readPNM(const std::string& path)
+{
+    PnmReader<T> in(path);
+    Matrix<T> mat(in.height(), in.width());
+    in.readRows(mat);
+    return mat;
+}
+
+inline Image readPPM(const std::string& path)
+{
+    PnmReader<Color> in(path);
+    Image img(in.height(), in.width());
+    in.readRows(img);
+    return img;
+}
+
+template<typename T>
+void writePNM(const std::string& path, const Matrix<T>& mat)
+{
+    PnmWriter<T> out(path, mat.nCols, mat.nRows);
+    out.writeRows(mat);
+    out.close();
+}
+
+#endif
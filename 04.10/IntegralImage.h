@@ -0,0 +1,284 @@
+#ifndef __IntegralImage_h
+#define __IntegralImage_h
+
+// Summed-area tables: after one pass over the image, the sum over any
+// rectangle takes four lookups, whatever its size.
+//
+//     Matrix<uint8_t> gray = ...;
+//     SummedAreaTable<uint32_t> sat(gray);            // built on several threads
+//     uint32_t s = sat.sum(10, 20, 64, 64);           // rows 10..73, cols 20..83
+//
+//     boxFilter(gray, 7, blurred);                    // 15x15 mean, same cost as 3x3
+//     meanVariance(gray, 7, mean, var);               // local statistics
+//     boxFilter(img, 7, blurredImg);                  // Image, per channel
+//
+// The table is (rows+1) x (cols+1) with a zero first row and column, so
+// queries need no edge cases. Accumulators are unsigned and wider than the
+// pixels, and are allowed to wrap: the corners are combined modulo 2^n as
+// well, so a rectangle sum is exact as long as the rectangle's own sum fits
+// (for uint32_t over uint8_t pixels, any window up to 16 million pixels).
+// The default accumulator per pixel type is in SatTraits.
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+#include "Matrix.h"
+
+// per-channel sums of an Image
+struct ColorSum
+{
+    uint32_t r = 0, g = 0, b = 0;
+
+    ColorSum() = default;
+    ColorSum(uint32_t v) : r(v), g(v), b(v) { }         // Matrix<ColorSum> zero-fills with 0
+    ColorSum(uint32_t r, uint32_t g, uint32_t b) : r(r), g(g), b(b) { }
+    ColorSum(const Color& c) : r(c.r), g(c.g), b(c.b) { }
+
+    ColorSum& operator+=(const ColorSum& o) { r += o.r; g += o.g; b += o.b; return *this; }
+    friend ColorSum operator+(ColorSum a, const ColorSum& o) { return a += o; }
+    friend ColorSum operator-(const ColorSum& a, const ColorSum& o) { return {a.r - o.r, a.g - o.g, a.b - o.b}; }
+};
+
+// the accumulator a pixel type gets by default, and the one for its squares
+template<typename T> struct SatTraits;
+template<> struct SatTraits<uint8_t>  { using Sum = uint32_t; using SquareSum = uint64_t; };
+template<> struct SatTraits<uint16_t> { using Sum = uint64_t; using SquareSum = uint64_t; };
+template<> struct SatTraits<float>    { using Sum = double;   using SquareSum = double; };
+template<> struct SatTraits<Color>    { using Sum = ColorSum; };
+
+namespace integral_detail
+{
+    inline int defaultThreads()
+    {
+        return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+
+    // splits [0, n) into nThreads bands and runs func(begin, end) on each
+    template<typename FUNC>
+    void parallelBands(int n, int nThreads, FUNC&& func)
+    {
+        nThreads = std::max(1, std::min(nThreads, n/64));      // not worth a thread below 64 rows/cols
+        if(nThreads == 1)
+        {
+            func(0, n);
+            return;
+        }
+        std::vector<std::thread> threads;
+        for(int t = 1; t < nThreads; ++t)
+            threads.emplace_back([&, t] { func(n*t/nThreads, n*(t + 1)/nThreads); });
+        func(0, n/nThreads);
+        for(auto& th : threads) th.join();
+    }
+
+    struct Identity
+    {
+        template<typename T> const T& operator()(const T& v) const { return v; }
+    };
+}
+
+template<typename Acc>
+class SummedAreaTable
+{
+    Matrix<Acc> table;      // table(i, j) = sum of src rows < i, cols < j
+
+public:
+    SummedAreaTable() = default;
+
+    // `transform` maps each pixel before it is summed, e.g. to its square
+    template<typename T, typename FUNC = integral_detail::Identity>
+    explicit SummedAreaTable(const Matrix<T>& src, FUNC transform = {}, int nThreads = integral_detail::defaultThreads())
+    {
+        build(src, transform, nThreads);
+    }
+
+    // Two passes, each split across threads: running sums along every row
+    // (bands of rows), then down every column (bands of columns, walked row
+    // by row so each thread still streams contiguous memory).
+    template<typename T, typename FUNC = integral_detail::Identity>
+    void build(const Matrix<T>& src, FUNC transform = {}, int nThreads = integral_detail::defaultThreads())
+    {
+        const int rows = src.nRows, cols = src.nCols;
+        table.init(rows + 1, cols + 1);
+        Acc* t = table.mem;
+        const size_t stride = static_cast<size_t>(cols) + 1;
+        std::fill(t, t + stride, Acc());
+
+        integral_detail::parallelBands(rows, nThreads, [&](int r0, int r1) {
+            for(int i = r0; i < r1; ++i)
+            {
+                const T* in = src.mem + static_cast<size_t>(i)*cols;
+                Acc* out = t + (i + 1)*stride;
+                Acc running = Acc();
+                out[0] = Acc();
+                for(int j = 0; j < cols; ++j)
+                {
+                    running += static_cast<Acc>(transform(in[j]));
+                    out[j + 1] = running;
+                }
+            }
+        });
+
+        integral_detail::parallelBands(cols, nThreads, [&](int c0, int c1) {
+            for(int i = 2; i <= rows; ++i)
+            {
+                const Acc* above = t + (i - 1)*stride + 1;
+                Acc* out = t + i*stride + 1;
+                for(int j = c0; j < c1; ++j) out[j] = out[j] + above[j];
+            }
+        });
+    }
+
+    int nRows() const { return table.nRows - 1; }
+    int nCols() const { return table.nCols - 1; }
+
+    // sum over the nRows x nCols rectangle whose top-left pixel is (row, col); no bounds checks
+    Acc sum(int row, int col, int nRows, int nCols) const
+    {
+        const size_t stride = static_cast<size_t>(table.nCols);
+        const Acc* top = table.mem + row*stride;
+        const Acc* bottom = table.mem + (row + nRows)*stride;
+        return bottom[col + nCols] - bottom[col] - top[col + nCols] + top[col];
+    }
+
+    // sum over rows [r0, r1) x cols [c0, c1), clipped to the image
+    Acc sumClipped(int r0, int c0, int r1, int c1) const
+    {
+        r0 = std::max(r0, 0);
+        c0 = std::max(c0, 0);
+        r1 = std::min(r1, nRows());
+        c1 = std::min(c1, nCols());
+        if(r1 <= r0 || c1 <= c0) return Acc();
+        return sum(r0, c0, r1 - r0, c1 - c0);
+    }
+
+    // For every column j: the sum over rows [r0, r1) and columns [j - radius, j + radius]
+    // clipped to the image. Away from the borders this is a plain loop over four
+    // table rows, which vectorizes.
+    void windowRowSums(int r0, int r1, int radius, Acc* out) const
+    {
+        const int cols = nCols();
+        const size_t stride = static_cast<size_t>(table.nCols);
+        const Acc* top = table.mem + r0*stride;
+        const Acc* bottom = table.mem + r1*stride;
+        const int left = std::min(radius, cols);                // below: window clipped on the left
+        const int right = std::max(cols - radius, left);        // from here: clipped on the right
+        for(int j = 0; j < left; ++j)
+        {
+            const int c1 = std::min(j + radius + 1, cols);
+            out[j] = bottom[c1] - bottom[0] - top[c1] + top[0];
+        }
+        for(int j = left; j < right; ++j)
+            out[j] = bottom[j + radius + 1] - bottom[j - radius] - top[j + radius + 1] + top[j - radius];
+        for(int j = right; j < cols; ++j)
+        {
+            const int c0 = std::max(j - radius, 0);
+            out[j] = bottom[cols] - bottom[c0] - top[cols] + top[c0];
+        }
+    }
+
+    const Matrix<Acc>& data() const { return table; }
+};
+
+namespace integral_detail
+{
+    // 1/width of the clipped window around every column
+    inline std::vector<double> inverseWidths(int cols, int radius)
+    {
+        std::vector<double> inv(cols);
+        for(int j = 0; j < cols; ++j)
+            inv[j] = 1.0/(std::min(j + radius + 1, cols) - std::max(j - radius, 0));
+        return inv;
+    }
+
+    // calls func(i, sums, invRows) for every row, sums[j] being the window sum around (i, j)
+    template<typename Acc, typename FUNC>
+    void forEachWindowRow(const SummedAreaTable<Acc>& sat, int radius, int nThreads, FUNC&& func)
+    {
+        if(radius < 0) throw std::invalid_argument("window radius must not be negative");
+        const int rows = sat.nRows(), cols = sat.nCols();
+        parallelBands(rows, nThreads, [&](int rBegin, int rEnd) {
+            std::vector<Acc> sums(cols);
+            for(int i = rBegin; i < rEnd; ++i)
+            {
+                const int r0 = std::max(i - radius, 0), r1 = std::min(i + radius + 1, rows);
+                sat.windowRowSums(r0, r1, radius, sums.data());
+                func(i, sums.data(), 1.0/(r1 - r0));
+            }
+        });
+    }
+
+    // Rounds sum/count to nearest with a multiply instead of a division. A
+    // quotient that is not a tie is at least 1/count away from the next
+    // rounding step, far more than the double product's error; the 1e-9 only
+    // keeps exact ties from rounding down. Windows are below 2^24 pixels anyway.
+    inline uint8_t roundedMean(double sum, double invCount)
+    {
+        return static_cast<uint8_t>(sum*invCount + (0.5 + 1e-9));
+    }
+}
+
+// mean over the (2*radius+1)^2 window around every pixel; the window shrinks at the borders
+inline void boxFilter(const Matrix<uint8_t>& src, int radius, Matrix<uint8_t>& dst,
+                      int nThreads = integral_detail::defaultThreads())
+{
+    TRACE_SPAN("boxFilter");
+    SummedAreaTable<uint32_t> sat(src, integral_detail::Identity(), nThreads);
+    if(dst.nRows != src.nRows || dst.nCols != src.nCols) dst.init(src.nRows, src.nCols);
+    const std::vector<double> invWidth = integral_detail::inverseWidths(src.nCols, radius);
+    integral_detail::forEachWindowRow(sat, radius, nThreads, [&](int i, const uint32_t* sums, double invRows) {
+        uint8_t* out = dst.mem + static_cast<size_t>(i)*dst.nCols;
+        for(int j = 0; j < dst.nCols; ++j) out[j] = integral_detail::roundedMean(sums[j], invRows*invWidth[j]);
+    });
+}
+
+inline void boxFilter(const Matrix<Color>& src, int radius, Matrix<Color>& dst,
+                      int nThreads = integral_detail::defaultThreads())
+{
+    TRACE_SPAN("boxFilter Image");
+    SummedAreaTable<SatTraits<Color>::Sum> sat(src, [](const Color& c) { return ColorSum(c); }, nThreads);
+    if(dst.nRows != src.nRows || dst.nCols != src.nCols) dst.init(src.nRows, src.nCols);
+    const std::vector<double> invWidth = integral_detail::inverseWidths(src.nCols, radius);
+    integral_detail::forEachWindowRow(sat, radius, nThreads, [&](int i, const ColorSum* sums, double invRows) {
+        Color* out = dst.mem + static_cast<size_t>(i)*dst.nCols;
+        for(int j = 0; j < dst.nCols; ++j)
+        {
+            const double inv = invRows*invWidth[j];
+            out[j] = Color(integral_detail::roundedMean(sums[j].r, inv), integral_detail::roundedMean(sums[j].g, inv),
+                           integral_detail::roundedMean(sums[j].b, inv));
+        }
+    });
+}
+
+// local mean and (population) variance over the same windows as boxFilter,
+// from a table of the pixels and a table of their squares
+inline void meanVariance(const Matrix<uint8_t>& src, int radius, Matrix<float>& mean, Matrix<float>& variance,
+                         int nThreads = integral_detail::defaultThreads())
+{
+    TRACE_SPAN("meanVariance");
+    SummedAreaTable<uint32_t> sums(src, integral_detail::Identity(), nThreads);
+    SummedAreaTable<SatTraits<uint8_t>::SquareSum> squares(src, [](uint8_t v) { return uint64_t(v)*v; }, nThreads);
+    if(mean.nRows != src.nRows || mean.nCols != src.nCols) mean.init(src.nRows, src.nCols);
+    if(variance.nRows != src.nRows || variance.nCols != src.nCols) variance.init(src.nRows, src.nCols);
+    const std::vector<double> invWidth = integral_detail::inverseWidths(src.nCols, radius);
+    const int cols = src.nCols;
+    integral_detail::forEachWindowRow(sums, radius, nThreads, [&](int i, const uint32_t* s, double invRows) {
+        thread_local std::vector<SatTraits<uint8_t>::SquareSum> sq;
+        sq.resize(cols);
+        const int r0 = std::max(i - radius, 0), r1 = std::min(i + radius + 1, src.nRows);
+        squares.windowRowSums(r0, r1, radius, sq.data());
+        float* m = mean.mem + static_cast<size_t>(i)*cols;
+        float* v = variance.mem + static_cast<size_t>(i)*cols;
+        for(int j = 0; j < cols; ++j)
+        {
+            const double inv = invRows*invWidth[j];
+            const double mu = s[j]*inv;
+            m[j] = static_cast<float>(mu);
+            v[j] = static_cast<float>(std::max(static_cast<double>(sq[j])*inv - mu*mu, 0.0));
+        }
+    });
+}
+
+#endif
@@ -0,0 +1,1005 @@
+#ifndef __Kernels_h
+#define __Kernels_h
+
+// Hot Matrix/Image kernels with one variant per instruction set, bound at
+// runtime to the best one the CPU supports (see CpuFeatures.h).
+//
+// Each kernel body is written once, as plain loops the compiler can
+// vectorize, and is then compiled again inside functions carrying a
+// target("...") attribute. So the AVX2 variant is the same C++ code, just
+// vectorized with 256 bit registers and FMA, the AVX-512 one with 512 bit.
+// Build with -O3: GCC's -O2 cost model will not vectorize loops that need
+// a scalar epilogue, which is most of them.
+//
+//     multiply(a, b, c);                  // c = a*b, c is resized if needed
+//     auto total = sum(mat);
+//     convert(mat, half);                 // Matrix<float> -> Matrix<float16>, F16C from AVX2 up
+//     kernelsFor(cpu::Isa::SSE42).sum(ptr, n);   // call one variant explicitly
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "CpuFeatures.h"
+#include "Half.h"
+#include "Matrix.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__)
+#define MATRIX_FORCE_INLINE inline __attribute__((always_inline))
+#else
+#define MATRIX_FORCE_INLINE inline
+#endif
+
+// 8 bit HSV: hue in 1/256 turns (h = 256*degrees/360), saturation and value 0..255
+struct Hsv
+{
+    uint8_t h, s, v;
+
+    Hsv(uint8_t v = 0) : h(0), s(0), v(v) { }      // a gray of brightness v, like Color(illum)
+    Hsv(uint8_t h, uint8_t s, uint8_t v) : h(h), s(s), v(v) { }
+};
+
+// Planar YUV 4:2:0 (I420): full-resolution luma, chroma at half resolution
+// in both directions, rounded up for odd sizes.
+struct Yuv420
+{
+    Matrix<uint8_t> y, u, v;
+};
+
+namespace kernels_detail
+{
+    // C(n x m) = A(n x k) * B(k x m), i-k-j order so the inner loop streams rows of B and C
+    MATRIX_FORCE_INLINE void matmul(const float* __restrict a, const float* __restrict b, float* __restrict c,
+                                    int n, int k, int m)
+    {
+        for(int i = 0; i < n; ++i)
+        {
+            float* __restrict cRow = c + static_cast<size_t>(i)*m;
+            for(int j = 0; j < m; ++j) cRow[j] = 0.f;
+            for(int p = 0; p < k; ++p)
+            {
+                const float aip = a[static_cast<size_t>(i)*k + p];
+                const float* __restrict bRow = b + static_cast<size_t>(p)*m;
+                for(int j = 0; j < m; ++j) cRow[j] += aip*bRow[j];
+            }
+        }
+    }
+
+    // C(n x m) = A(n x k) * Bt(m x k)^T in exact int32, for quantized inference: rows of
+    // A are uint8 activations, rows of Bt int8 weights (one row per output). Each output
+    // is a u8 x s8 dot product, which vectorizes to vpdpbusd with VNNI and to widening
+    // vpmaddwd otherwise (vpmaddubsw would saturate its int16 pair sums). Four rows of A
+    // share every load of a weight row.
+    MATRIX_FORCE_INLINE void matmulU8S8(const uint8_t* __restrict a, const int8_t* __restrict bt, int32_t* __restrict c,
+                                        int n, int k, int m)
+    {
+        int i = 0;
+        for(; i + 4 <= n; i += 4)
+        {
+            const uint8_t* __restrict a0 = a + static_cast<size_t>(i)*k;
+            const uint8_t* __restrict a1 = a0 + k;
+            const uint8_t* __restrict a2 = a1 + k;
+            const uint8_t* __restrict a3 = a2 + k;
+            for(int j = 0; j < m; ++j)
+            {
+                const int8_t* __restrict w = bt + static_cast<size_t>(j)*k;
+                int32_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+                for(int p = 0; p < k; ++p)
+                {
+                    const int32_t wp = w[p];
+                    s0 += int32_t(a0[p])*wp;
+                    s1 += int32_t(a1[p])*wp;
+                    s2 += int32_t(a2[p])*wp;
+                    s3 += int32_t(a3[p])*wp;
+                }
+                c[static_cast<size_t>(i)*m + j] = s0;
+                c[static_cast<size_t>(i + 1)*m + j] = s1;
+                c[static_cast<size_t>(i + 2)*m + j] = s2;
+                c[static_cast<size_t>(i + 3)*m + j] = s3;
+            }
+        }
+        for(; i < n; ++i)
+        {
+            const uint8_t* __restrict aRow = a + static_cast<size_t>(i)*k;
+            for(int j = 0; j < m; ++j)
+            {
+                const int8_t* __restrict w = bt + static_cast<size_t>(j)*k;
+                int32_t s = 0;
+                for(int p = 0; p < k; ++p) s += int32_t(aRow[p])*int32_t(w[p]);
+                c[static_cast<size_t>(i)*m + j] = s;
+            }
+        }
+    }
+
+    // 2D correlation with a kRows x kCols kernel centred on each output pixel,
+    // borders replicate the edge pixels. Every tap adds a shifted source row to
+    // the output row; only the few columns that hit the border are clamped.
+    MATRIX_FORCE_INLINE void convolve(const float* __restrict src, float* __restrict dst, int rows, int cols,
+                                      const float* __restrict kernel, int kRows, int kCols)
+    {
+        const int kr = kRows/2, kc = kCols/2;
+        for(int i = 0; i < rows; ++i)
+        {
+            float* __restrict out = dst + static_cast<size_t>(i)*cols;
+            for(int j = 0; j < cols; ++j) out[j] = 0.f;
+            for(int a = 0; a < kRows; ++a)
+            {
+                const int si = std::min(std::max(i + a - kr, 0), rows - 1);
+                const float* __restrict in = src + static_cast<size_t>(si)*cols;
+                for(int b = 0; b < kCols; ++b)
+                {
+                    const float w = kernel[a*kCols + b];
+                    const int off = b - kc;
+                    const int lo = std::min(std::max(-off, 0), cols);
+                    const int hi = std::max(std::min(cols - off, cols), lo);
+                    for(int j = 0; j < lo; ++j) out[j] += w*in[std::min(std::max(j + off, 0), cols - 1)];
+                    for(int j = lo; j < hi; ++j) out[j] += w*in[j + off];
+                    for(int j = hi; j < cols; ++j) out[j] += w*in[std::min(std::max(j + off, 0), cols - 1)];
+                }
+            }
+        }
+    }
+
+    // Independent partial sums per lane: the compiler may vectorize these
+    // without -ffast-math because no addition is reassociated.
+    constexpr int LANES = 16;
+
+    MATRIX_FORCE_INLINE float sum(const float* __restrict ptr, size_t n)
+    {
+        float acc[LANES] = {};
+        size_t i = 0;
+        for(; i + LANES <= n; i += LANES)
+            for(int l = 0; l < LANES; ++l) acc[l] += ptr[i + l];
+        float total = 0.f;
+        for(; i < n; ++i) total += ptr[i];
+        for(int l = 0; l < LANES; ++l) total += acc[l];
+        return total;
+    }
+
+    MATRIX_FORCE_INLINE void minMax(const float* __restrict ptr, size_t n, float* outMin, float* outMax)
+    {
+        if(n == 0) { *outMin = *outMax = 0.f; return; }
+        float lo[LANES], hi[LANES];
+        for(int l = 0; l < LANES; ++l) lo[l] = hi[l] = ptr[0];
+        size_t i = 0;
+        for(; i + LANES <= n; i += LANES)
+            for(int l = 0; l < LANES; ++l)
+            {
+                lo[l] = ptr[i + l] < lo[l] ? ptr[i + l] : lo[l];
+                hi[l] = ptr[i + l] > hi[l] ? ptr[i + l] : hi[l];
+            }
+        for(; i < n; ++i)
+        {
+            lo[0] = std::min(lo[0], ptr[i]);
+            hi[0] = std::max(hi[0], ptr[i]);
+        }
+        *outMin = *std::min_element(lo, lo + LANES);
+        *outMax = *std::max_element(hi, hi + LANES);
+    }
+
+    // 32 bit lanes over blocks small enough not to overflow, folded into 64 bits per block
+    MATRIX_FORCE_INLINE uint64_t sumU8(const uint8_t* __restrict ptr, size_t n)
+    {
+        constexpr size_t BLOCK = 1 << 16;
+        uint64_t total = 0;
+        for(size_t start = 0; start < n; start += BLOCK)
+        {
+            const size_t end = std::min(n, start + BLOCK);
+            uint32_t acc = 0;
+            for(size_t i = start; i < end; ++i) acc += ptr[i];
+            total += acc;
+        }
+        return total;
+    }
+
+    // ITU-R BT.601 luma in 8 bit fixed point: (77 R + 150 G + 29 B + 128) >> 8, |error| <= 1
+    MATRIX_FORCE_INLINE void rgbToGray(const Color* __restrict src, uint8_t* __restrict dst, size_t n)
+    {
+        const uint8_t* __restrict p = &src->r;
+        for(size_t i = 0; i < n; ++i)
+            dst[i] = static_cast<uint8_t>((77*p[3*i] + 150*p[3*i + 1] + 29*p[3*i + 2] + 128) >> 8);
+    }
+
+    MATRIX_FORCE_INLINE void grayToRgb(const uint8_t* __restrict src, Color* __restrict dst, size_t n)
+    {
+        uint8_t* __restrict p = &dst->r;
+        for(size_t i = 0; i < n; ++i)
+            p[3*i] = p[3*i + 1] = p[3*i + 2] = src[i];
+    }
+
+    // ---- Color spaces. JFIF (full-range BT.601) YUV with 14 bit coefficients,
+    // each triple adjusted so it sums exactly to 1 (Y) or 0 (U, V): gray stays gray.
+
+    MATRIX_FORCE_INLINE int clampByte(int x) { return std::min(std::max(x, 0), 255); }
+
+    // Y per pixel; U, V from the sum of each 2x2 block (edge pixels repeat for odd sizes)
+    MATRIX_FORCE_INLINE void rgbToYuv420(const Color* __restrict src, int rows, int cols,
+                                         uint8_t* __restrict y, uint8_t* __restrict u, uint8_t* __restrict v)
+    {
+        const uint8_t* __restrict p = &src->r;
+        const size_t n = static_cast<size_t>(rows)*cols;
+        for(size_t i = 0; i < n; ++i)
+            y[i] = static_cast<uint8_t>((4899*p[3*i] + 9617*p[3*i + 1] + 1868*p[3*i + 2] + 8192) >> 14);
+
+        const int cRows = (rows + 1)/2, cCols = (cols + 1)/2;
+        for(int bi = 0; bi < cRows; ++bi)
+        {
+            const uint8_t* __restrict top = p + static_cast<size_t>(2*bi)*cols*3;
+            const uint8_t* __restrict bottom = p + static_cast<size_t>(std::min(2*bi + 1, rows - 1))*cols*3;
+            uint8_t* __restrict uRow = u + static_cast<size_t>(bi)*cCols;
+            uint8_t* __restrict vRow = v + static_cast<size_t>(bi)*cCols;
+            for(int bj = 0; bj < cCols; ++bj)
+            {
+                const int k0 = 6*bj, k1 = 3*std::min(2*bj + 1, cols - 1);
+                const int r = top[k0] + top[k1] + bottom[k0] + bottom[k1];
+                const int g = top[k0 + 1] + top[k1 + 1] + bottom[k0 + 1] + bottom[k1 + 1];
+                const int b = top[k0 + 2] + top[k1 + 2] + bottom[k0 + 2] + bottom[k1 + 2];
+                // 4 pixels and 14 fraction bits: shift by 16; +128 can round up to 256
+                uRow[bj] = static_cast<uint8_t>(std::min(((-2765*r - 5427*g + 8192*b + 32768) >> 16) + 128, 255));
+                vRow[bj] = static_cast<uint8_t>(std::min(((8192*r - 6860*g - 1332*b + 32768) >> 16) + 128, 255));
+            }
+        }
+    }
+
+    // each chroma sample's R, G, B offsets are worked out once per chroma row,
+    // upsampled into `offsets`, and shared by both luma rows of the pair
+    MATRIX_FORCE_INLINE void yuv420ToRgb(const uint8_t* __restrict y, const uint8_t* __restrict u, const uint8_t* __restrict v,
+                                         int rows, int cols, Color* __restrict dst)
+    {
+        uint8_t* __restrict p = &dst->r;
+        const int cCols = (cols + 1)/2;
+        std::vector<int16_t> buffer(3*static_cast<size_t>(cCols)*2);
+        int16_t* __restrict offsets = buffer.data();
+        for(int i = 0; i < rows; ++i)
+        {
+            if(i % 2 == 0)
+            {
+                const uint8_t* __restrict uRow = u + static_cast<size_t>(i/2)*cCols;
+                const uint8_t* __restrict vRow = v + static_cast<size_t>(i/2)*cCols;
+                for(int k = 0; k < cCols; ++k)
+                {
+                    const int du = uRow[k] - 128, dv = vRow[k] - 128;
+                    const int16_t dr = static_cast<int16_t>((22970*dv + 8192) >> 14);
+                    const int16_t dg = static_cast<int16_t>((-5638*du - 11700*dv + 8192) >> 14);
+                    const int16_t db = static_cast<int16_t>((29032*du + 8192) >> 14);
+                    offsets[6*k] = offsets[6*k + 3] = dr;
+                    offsets[6*k + 1] = offsets[6*k + 4] = dg;
+                    offsets[6*k + 2] = offsets[6*k + 5] = db;
+                }
+            }
+            const uint8_t* __restrict yRow = y + static_cast<size_t>(i)*cols;
+            uint8_t* __restrict out = p + static_cast<size_t>(i)*cols*3;
+            for(int j = 0; j < cols; ++j)
+            {
+                const int l = yRow[j];
+                out[3*j]     = static_cast<uint8_t>(clampByte(l + offsets[3*j]));
+                out[3*j + 1] = static_cast<uint8_t>(clampByte(l + offsets[3*j + 1]));
+                out[3*j + 2] = static_cast<uint8_t>(clampByte(l + offsets[3*j + 2]));
+            }
+        }
+    }
+
+    // 16.16 reciprocals, so HSV needs no division: a hue step of (256/6)/delta, and 255/max
+    struct HsvTables
+    {
+        int32_t hueStep[256];
+        int32_t satScale[256];
+    };
+
+    constexpr HsvTables makeHsvTables()
+    {
+        HsvTables t{};
+        for(int d = 1; d < 256; ++d)
+        {
+            t.hueStep[d] = static_cast<int32_t>(256.0/6*65536/d + 0.5);
+            t.satScale[d] = static_cast<int32_t>(255.0*65536/d + 0.5);
+        }
+        return t;
+    }
+
+    inline constexpr HsvTables hsvTables = makeHsvTables();
+    constexpr int32_t HUE_THIRD = 5592405;     // 256/3 turns in 16.16
+
+    MATRIX_FORCE_INLINE void rgbToHsv(const Color* __restrict src, Hsv* __restrict dst, size_t n)
+    {
+        const uint8_t* __restrict p = &src->r;
+        uint8_t* __restrict q = &dst->h;
+        for(size_t i = 0; i < n; ++i)
+        {
+            const int r = p[3*i], g = p[3*i + 1], b = p[3*i + 2];
+            const int mx = std::max(r, std::max(g, b)), mn = std::min(r, std::min(g, b));
+            const int delta = mx - mn;
+            // the largest channel picks the sixth of the circle, the other two the position in it
+            const int x = mx == r ? g : mx == g ? b : r;
+            const int y = mx == r ? b : mx == g ? r : g;
+            const int32_t offset = mx == r ? 0 : mx == g ? HUE_THIRD : 2*HUE_THIRD;
+            const int32_t h = (offset + (x - y)*hsvTables.hueStep[delta] + 32768) >> 16;
+            q[3*i]     = static_cast<uint8_t>(h & 255);       // negative hues wrap around the circle
+            q[3*i + 1] = static_cast<uint8_t>((delta*hsvTables.satScale[mx] + 32768) >> 16);
+            q[3*i + 2] = static_cast<uint8_t>(mx);
+        }
+    }
+
+    // x/255, rounded, for 0 <= x <= 255*255
+    MATRIX_FORCE_INLINE int div255(int x) { return (x + 128 + ((x + 128) >> 8)) >> 8; }
+
+    // the piecewise-linear HSV ramp min(k, 4 - k) clamped to [0, 1], with k in
+    // 1/256 sectors; branch-free so hsvToRgb vectorizes
+    MATRIX_FORCE_INLINE int hsvRamp(int k)
+    {
+        k = k >= 6*256 ? k - 6*256 : k;
+        return std::min(std::max(std::min(k, 4*256 - k), 0), 256);
+    }
+
+    MATRIX_FORCE_INLINE void hsvToRgb(const Hsv* __restrict src, Color* __restrict dst, size_t n)
+    {
+        const uint8_t* __restrict q = &src->h;
+        uint8_t* __restrict p = &dst->r;
+        for(size_t i = 0; i < n; ++i)
+        {
+            const int h = q[3*i], s = q[3*i + 1], v = q[3*i + 2];
+            // distance of each channel from its peak, in 1/256 sectors: 0 keeps v, 256 is v*(1 - s)
+            const int t[3] = {hsvRamp(h*6 + 5*256), hsvRamp(h*6 + 3*256), hsvRamp(h*6 + 256)};
+            const int r = div255(v*(255 - ((s*t[0] + 128) >> 8)));
+            const int g = div255(v*(255 - ((s*t[1] + 128) >> 8)));
+            const int b = div255(v*(255 - ((s*t[2] + 128) >> 8)));
+            p[3*i] = static_cast<uint8_t>(r);
+            p[3*i + 1] = static_cast<uint8_t>(g);
+            p[3*i + 2] = static_cast<uint8_t>(b);
+        }
+    }
+
+    // ---- 16 bit floats. bfloat16 is a shift and a rounding add, which every ISA
+    // vectorizes; float16 uses F16C (vcvtph2ps/vcvtps2ph, 8 at a time) from AVX2 up
+    // and the branch-free bit manipulation of Half.h below that.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __attribute__((target("avx,f16c"))) inline void halfToFloatF16c(const float16* __restrict src,
+                                                                    float* __restrict dst, size_t n)
+    {
+        size_t i = 0;
+        for(; i + 8 <= n; i += 8)
+            _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i))));
+        for(; i < n; ++i) dst[i] = _cvtsh_ss(src[i].bits);
+    }
+
+    __attribute__((target("avx,f16c"))) inline void floatToHalfF16c(const float* __restrict src,
+                                                                    float16* __restrict dst, size_t n)
+    {
+        size_t i = 0;
+        for(; i + 8 <= n; i += 8)
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                             _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+        for(; i < n; ++i) dst[i].bits = static_cast<uint16_t>(_cvtss_sh(src[i], _MM_FROUND_TO_NEAREST_INT));
+    }
+#define MATRIX_HAS_F16C_KERNELS 1
+#endif
+
+    template<cpu::Isa ISA>
+    MATRIX_FORCE_INLINE void halfToFloat(const float16* __restrict src, float* __restrict dst, size_t n)
+    {
+#ifdef MATRIX_HAS_F16C_KERNELS
+        if constexpr(ISA >= cpu::Isa::AVX2)
+            return halfToFloatF16c(src, dst, n);
+#endif
+        for(size_t i = 0; i < n; ++i) dst[i] = half_detail::halfBitsToFloat(src[i].bits);
+    }
+
+    template<cpu::Isa ISA>
+    MATRIX_FORCE_INLINE void floatToHalf(const float* __restrict src, float16* __restrict dst, size_t n)
+    {
+#ifdef MATRIX_HAS_F16C_KERNELS
+        if constexpr(ISA >= cpu::Isa::AVX2)
+            return floatToHalfF16c(src, dst, n);
+#endif
+        for(size_t i = 0; i < n; ++i) dst[i].bits = half_detail::floatToHalfBits(src[i]);
+    }
+
+    MATRIX_FORCE_INLINE void bfloatToFloat(const bfloat16* __restrict src, float* __restrict dst, size_t n)
+    {
+        for(size_t i = 0; i < n; ++i) dst[i] = half_detail::bfloatBitsToFloat(src[i].bits);
+    }
+
+    MATRIX_FORCE_INLINE void floatToBfloat(const float* __restrict src, bfloat16* __restrict dst, size_t n)
+    {
+        for(size_t i = 0; i < n; ++i) dst[i].bits = half_detail::floatToBfloatBits(src[i]);
+    }
+
+    // ---- Content hash (XXH3-style): eight 64 bit lanes eat 64 byte stripes. Each word is
+    // xored with a per-position key and its halves multiplied (32x32 -> 64, vpmuludq), so
+    // the lanes only ever add and every ISA keeps them in registers. Keys differ for each
+    // stripe of a 1 KB block, so reordering stripes changes the hash, and the lanes are
+    // scrambled after every block. Fast, well mixed and the same on every ISA; it is not
+    // meant to stand up to deliberately crafted collisions.
+    MATRIX_FORCE_INLINE uint64_t mix64(uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ull;
+        return h ^ (h >> 33);
+    }
+
+    constexpr int HASH_LANES = 8, HASH_STRIPES = 16;
+
+    inline constexpr struct HashKeys
+    {
+        uint64_t key[HASH_STRIPES*HASH_LANES];
+        constexpr HashKeys() : key{}
+        {
+            uint64_t x = 0;                 // splitmix64
+            for(uint64_t& k : key)
+            {
+                x += 0x9e3779b97f4a7c15ull;
+                uint64_t z = (x ^ (x >> 30))*0xbf58476d1ce4e5b9ull;
+                z = (z ^ (z >> 27))*0x94d049bb133111ebull;
+                k = z ^ (z >> 31);
+            }
+        }
+    } hashKeys;
+
+    MATRIX_FORCE_INLINE void hashStripe(uint64_t* __restrict acc, const uint8_t* __restrict p, const uint64_t* __restrict key)
+    {
+        for(int l = 0; l < HASH_LANES; ++l)
+        {
+            uint64_t w;
+            std::memcpy(&w, p + 8*l, 8);
+            const uint64_t k = w ^ key[l];
+            acc[l] += uint64_t(uint32_t(k))*uint32_t(k >> 32) + w;
+        }
+    }
+
+    MATRIX_FORCE_INLINE uint64_t hashBytes(const uint8_t* __restrict p, size_t n, uint64_t seed)
+    {
+        constexpr size_t STRIPE = 8*HASH_LANES, BLOCK = STRIPE*HASH_STRIPES;
+        uint64_t acc[HASH_LANES];
+        for(int l = 0; l < HASH_LANES; ++l) acc[l] = mix64(seed + l);
+        size_t i = 0;
+        for(; i + BLOCK <= n; i += BLOCK)
+        {
+            for(int s = 0; s < HASH_STRIPES; ++s) hashStripe(acc, p + i + s*STRIPE, hashKeys.key + s*HASH_LANES);
+            for(int l = 0; l < HASH_LANES; ++l) acc[l] = (acc[l] ^ (acc[l] >> 47))*0x9e3779b1u;
+        }
+        for(int s = 0; i + STRIPE <= n; i += STRIPE, ++s) hashStripe(acc, p + i, hashKeys.key + s*HASH_LANES);
+
+        uint64_t h = mix64(seed ^ n);
+        for(int l = 0; l < HASH_LANES; ++l) h = mix64(h ^ acc[l]);
+        for(; i + 8 <= n; i += 8)
+        {
+            uint64_t w;
+            std::memcpy(&w, p + i, 8);
+            h = mix64(h ^ w);
+        }
+        uint64_t tail = 0;
+        for(int shift = 0; i < n; ++i, shift += 8) tail |= uint64_t(p[i]) << shift;
+        return mix64(h ^ tail);
+    }
+
+    // ---- Table lookups, dst[i] = table[src[i]] (in place is fine). A 256 byte table sits
+    // in registers as 16 slices of 16 bytes: one byte shuffle per slice looks up the low
+    // nibble in all of them, then four rounds of blends keep the slice the high nibble
+    // names, one bit at a time (blends go by each byte's top bit, so the index is shifted
+    // left to bring bits 4..7 up in turn). 65536 entry uint16 tables are too big for that
+    // and are gathered as 32 bit words, the last entry as the top half of the word before.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __attribute__((target("sse4.1,ssse3"))) inline size_t lookup8Sse(const uint8_t* src, uint8_t* dst, size_t n,
+                                                                     const uint8_t* table)
+    {
+        __m128i slice[16];
+        for(int k = 0; k < 16; ++k) slice[k] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(table + 16*k));
+        const __m128i nibble = _mm_set1_epi8(0x0f);
+        size_t i = 0;
+        for(; i + 16 <= n; i += 16)
+        {
+            const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            const __m128i lo = _mm_and_si128(x, nibble);
+            __m128i r[16];
+            for(int k = 0; k < 16; ++k) r[k] = _mm_shuffle_epi8(slice[k], lo);
+            for(int bit = 4; bit < 8; ++bit)
+            {
+                const __m128i select = _mm_slli_epi16(x, 7 - bit);
+                for(int k = 0; k < 1 << (7 - bit); ++k) r[k] = _mm_blendv_epi8(r[2*k], r[2*k + 1], select);
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), r[0]);
+        }
+        return i;
+    }
+
+    __attribute__((target("avx2"))) inline size_t lookup8Avx2(const uint8_t* src, uint8_t* dst, size_t n,
+                                                              const uint8_t* table)
+    {
+        __m256i slice[16];
+        for(int k = 0; k < 16; ++k)
+            slice[k] = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(table + 16*k)));
+        const __m256i nibble = _mm256_set1_epi8(0x0f);
+        size_t i = 0;
+        for(; i + 32 <= n; i += 32)
+        {
+            const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+            const __m256i lo = _mm256_and_si256(x, nibble);
+            __m256i r[16];
+            for(int k = 0; k < 16; ++k) r[k] = _mm256_shuffle_epi8(slice[k], lo);
+            for(int bit = 4; bit < 8; ++bit)
+            {
+                const __m256i select = _mm256_slli_epi16(x, 7 - bit);
+                for(int k = 0; k < 1 << (7 - bit); ++k) r[k] = _mm256_blendv_epi8(r[2*k], r[2*k + 1], select);
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), r[0]);
+        }
+        return i;
+    }
+
+    // GCC 12's AVX-512 intrinsics start from _mm512_undefined_epi32(), a self-initialized
+    // vector -Wall reports as maybe uninitialized wherever they inline; nothing here is.
+    // (Clang has neither the warning nor the option.)
+#if !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+    __attribute__((target("avx512f,avx512bw"))) inline size_t lookup8Avx512(const uint8_t* src, uint8_t* dst, size_t n,
+                                                                            const uint8_t* table)
+    {
+        __m512i slice[16];
+        for(int k = 0; k < 16; ++k)
+            slice[k] = _mm512_broadcast_i32x4(_mm_loadu_si128(reinterpret_cast<const __m128i*>(table + 16*k)));
+        const __m512i nibble = _mm512_set1_epi8(0x0f);
+        size_t i = 0;
+        for(; i + 64 <= n; i += 64)
+        {
+            const __m512i x = _mm512_loadu_si512(src + i);
+            const __m512i lo = _mm512_and_si512(x, nibble);
+            __m512i r[16];
+            for(int k = 0; k < 16; ++k) r[k] = _mm512_shuffle_epi8(slice[k], lo);
+            for(int bit = 4; bit < 8; ++bit)
+            {
+                const __mmask64 select = _mm512_movepi8_mask(_mm512_slli_epi16(x, 7 - bit));
+                for(int k = 0; k < 1 << (7 - bit); ++k) r[k] = _mm512_mask_blend_epi8(select, r[2*k], r[2*k + 1]);
+            }
+            _mm512_storeu_si512(dst + i, r[0]);
+        }
+        return i;
+    }
+
+    __attribute__((target("avx2"))) inline size_t lookup16Avx2(const uint16_t* src, uint16_t* dst, size_t n,
+                                                               const uint16_t* table)
+    {
+        const int* words = reinterpret_cast<const int*>(table);
+        const __m256i last = _mm256_set1_epi32(65534), low = _mm256_set1_epi32(0xffff);
+        size_t i = 0;
+        for(; i + 16 <= n; i += 16)
+        {
+            __m256i v[2];
+            for(int h = 0; h < 2; ++h)
+            {
+                const __m256i idx = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8*h)));
+                const __m256i at = _mm256_min_epu32(idx, last);
+                const __m256i shift = _mm256_slli_epi32(_mm256_sub_epi32(idx, at), 4);
+                v[h] = _mm256_and_si256(_mm256_srlv_epi32(_mm256_i32gather_epi32(words, at, 2), shift), low);
+            }
+            // packus works within 128 bit lanes, the permute puts them back in order
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i),
+                                _mm256_permute4x64_epi64(_mm256_packus_epi32(v[0], v[1]), 0xd8));
+        }
+        return i;
+    }
+
+    __attribute__((target("avx512f,avx512bw"))) inline size_t lookup16Avx512(const uint16_t* src, uint16_t* dst, size_t n,
+                                                                             const uint16_t* table)
+    {
+        const __m512i last = _mm512_set1_epi32(65534);
+        size_t i = 0;
+        for(; i + 16 <= n; i += 16)
+        {
+            const __m512i idx = _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i)));
+            const __m512i at = _mm512_min_epu32(idx, last);
+            const __m512i shift = _mm512_slli_epi32(_mm512_sub_epi32(idx, at), 4);
+            const __m512i v = _mm512_srlv_epi32(_mm512_i32gather_epi32(at, table, 2), shift);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm512_cvtepi32_epi16(v));  // keeps the low halves
+        }
+        return i;
+    }
+#if !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#define MATRIX_HAS_LOOKUP_KERNELS 1
+#endif
+
+    template<cpu::Isa ISA>
+    MATRIX_FORCE_INLINE void lookup8(const uint8_t* src, uint8_t* dst, size_t n, const uint8_t* table)
+    {
+        size_t i = 0;
+#ifdef MATRIX_HAS_LOOKUP_KERNELS
+        if constexpr(ISA >= cpu::Isa::AVX512) i = lookup8Avx512(src, dst, n, table);
+        else if constexpr(ISA >= cpu::Isa::AVX2) i = lookup8Avx2(src, dst, n, table);
+        else if constexpr(ISA >= cpu::Isa::SSE42) i = lookup8Sse(src, dst, n, table);
+#endif
+        for(; i < n; ++i) dst[i] = table[src[i]];
+    }
+
+    template<cpu::Isa ISA>
+    MATRIX_FORCE_INLINE void lookup16(const uint16_t* src, uint16_t* dst, size_t n, const uint16_t* table)
+    {
+        size_t i = 0;
+#ifdef MATRIX_HAS_LOOKUP_KERNELS
+        if constexpr(ISA >= cpu::Isa::AVX512) i = lookup16Avx512(src, dst, n, table);
+        else if constexpr(ISA >= cpu::Isa::AVX2) i = lookup16Avx2(src, dst, n, table);
+#endif
+        for(; i < n; ++i) dst[i] = table[src[i]];
+    }
+}
+
+static_assert(sizeof(Color) == 3, "kernels treat Image memory as packed RGB bytes");
+static_assert(sizeof(Hsv) == 3, "kernels treat Hsv memory as packed bytes");
+
+struct KernelTable
+{
+    cpu::Isa isa;
+    void (*matmul)(const float* a, const float* b, float* c, int n, int k, int m);
+    void (*matmulU8S8)(const uint8_t* a, const int8_t* bt, int32_t* c, int n, int k, int m);
+    void (*convolve)(const float* src, float* dst, int rows, int cols, const float* kernel, int kRows, int kCols);
+    float (*sum)(const float* ptr, size_t n);
+    void (*minMax)(const float* ptr, size_t n, float* outMin, float* outMax);
+    uint64_t (*sumU8)(const uint8_t* ptr, size_t n);
+    void (*rgbToGray)(const Color* src, uint8_t* dst, size_t n);
+    void (*grayToRgb)(const uint8_t* src, Color* dst, size_t n);
+    void (*rgbToYuv420)(const Color* src, int rows, int cols, uint8_t* y, uint8_t* u, uint8_t* v);
+    void (*yuv420ToRgb)(const uint8_t* y, const uint8_t* u, const uint8_t* v, int rows, int cols, Color* dst);
+    void (*rgbToHsv)(const Color* src, Hsv* dst, size_t n);
+    void (*hsvToRgb)(const Hsv* src, Color* dst, size_t n);
+    void (*halfToFloat)(const float16* src, float* dst, size_t n);
+    void (*floatToHalf)(const float* src, float16* dst, size_t n);
+    void (*bfloatToFloat)(const bfloat16* src, float* dst, size_t n);
+    void (*floatToBfloat)(const float* src, bfloat16* dst, size_t n);
+    uint64_t (*hashBytes)(const uint8_t* ptr, size_t n, uint64_t seed);
+    void (*lookup8)(const uint8_t* src, uint8_t* dst, size_t n, const uint8_t* table);
+    void (*lookup16)(const uint16_t* src, uint16_t* dst, size_t n, const uint16_t* table);
+};
+
+// One namespace of thin wrappers per ISA, each compiled for its target.
+#define MATRIX_KERNEL_VARIANTS(NS, ISA, TARGET)                                                                   \
+    namespace NS                                                                                                 \
+    {                                                                                                            \
+        TARGET inline void matmul(const float* a, const float* b, float* c, int n, int k, int m)                 \
+        { kernels_detail::matmul(a, b, c, n, k, m); }                                                            \
+        TARGET inline void matmulU8S8(const uint8_t* a, const int8_t* b, int32_t* c, int n, int k, int m)        \
+        { kernels_detail::matmulU8S8(a, b, c, n, k, m); }                                                        \
+        TARGET inline void convolve(const float* s, float* d, int r, int c, const float* k, int kr, int kc)      \
+        { kernels_detail::convolve(s, d, r, c, k, kr, kc); }                                                     \
+        TARGET inline float sum(const float* p, size_t n) { return kernels_detail::sum(p, n); }                  \
+        TARGET inline void minMax(const float* p, size_t n, float* lo, float* hi)                                \
+        { kernels_detail::minMax(p, n, lo, hi); }                                                                \
+        TARGET inline uint64_t sumU8(const uint8_t* p, size_t n) { return kernels_detail::sumU8(p, n); }         \
+        TARGET inline void rgbToGray(const Color* s, uint8_t* d, size_t n) { kernels_detail::rgbToGray(s, d, n); } \
+        TARGET inline void grayToRgb(const uint8_t* s, Color* d, size_t n) { kernels_detail::grayToRgb(s, d, n); } \
+        TARGET inline void rgbToYuv420(const Color* s, int r, int c, uint8_t* y, uint8_t* u, uint8_t* v)         \
+        { kernels_detail::rgbToYuv420(s, r, c, y, u, v); }                                                       \
+        TARGET inline void yuv420ToRgb(const uint8_t* y, const uint8_t* u, const uint8_t* v, int r, int c, Color* d) \
+        { kernels_detail::yuv420ToRgb(y, u, v, r, c, d); }                                                       \
+        TARGET inline void rgbToHsv(const Color* s, Hsv* d, size_t n) { kernels_detail::rgbToHsv(s, d, n); }     \
+        TARGET inline void hsvToRgb(const Hsv* s, Color* d, size_t n) { kernels_detail::hsvToRgb(s, d, n); }     \
+        TARGET inline void halfToFloat(const float16* s, float* d, size_t n)                                     \
+        { kernels_detail::halfToFloat<ISA>(s, d, n); }                                                           \
+        TARGET inline void floatToHalf(const float* s, float16* d, size_t n)                                     \
+        { kernels_detail::floatToHalf<ISA>(s, d, n); }                                                           \
+        TARGET inline void bfloatToFloat(const bfloat16* s, float* d, size_t n)                                  \
+        { kernels_detail::bfloatToFloat(s, d, n); }                                                              \
+        TARGET inline void floatToBfloat(const float* s, bfloat16* d, size_t n)                                  \
+        { kernels_detail::floatToBfloat(s, d, n); }                                                              \
+        TARGET inline uint64_t hashBytes(const uint8_t* p, size_t n, uint64_t seed)                             \
+        { return kernels_detail::hashBytes(p, n, seed); }                                                        \
+        TARGET inline void lookup8(const uint8_t* s, uint8_t* d, size_t n, const uint8_t* t)                     \
+        { kernels_detail::lookup8<ISA>(s, d, n, t); }                                                            \
+        TARGET inline void lookup16(const uint16_t* s, uint16_t* d, size_t n, const uint16_t* t)                 \
+        { kernels_detail::lookup16<ISA>(s, d, n, t); }                                                           \
+        inline const KernelTable table{ISA, matmul, matmulU8S8, convolve, sum, minMax, sumU8, rgbToGray,        \
+                                       grayToRgb, rgbToYuv420, yuv420ToRgb, rgbToHsv, hsvToRgb, halfToFloat,     \
+                                       floatToHalf, bfloatToFloat, floatToBfloat, hashBytes, lookup8, lookup16}; \
+    }
+
+MATRIX_KERNEL_VARIANTS(kernels_baseline, cpu::Isa::Baseline, )
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+// cpu::detectIsa() checks for every feature named here (and in the helpers' targets) before picking a level
+MATRIX_KERNEL_VARIANTS(kernels_sse42, cpu::Isa::SSE42, __attribute__((target("sse4.2,popcnt"))))
+MATRIX_KERNEL_VARIANTS(kernels_avx2, cpu::Isa::AVX2, __attribute__((target("avx2,fma,bmi2,f16c"))))
+MATRIX_KERNEL_VARIANTS(kernels_avx512, cpu::Isa::AVX512,
+                       __attribute__((target("avx512f,avx512bw,avx512vl,avx512dq,fma,bmi2,prefer-vector-width=512"))))
+// the same plus 8-bit dot products (vpdpbusd), which only the quantized kernels use
+MATRIX_KERNEL_VARIANTS(kernels_avx512vnni, cpu::Isa::AVX512VNNI,
+                       __attribute__((target("avx512f,avx512bw,avx512vl,avx512dq,avx512vnni,fma,bmi2,"
+                                             "prefer-vector-width=512"))))
+#define MATRIX_HAS_ISA_VARIANTS 1
+#endif
+
+#undef MATRIX_KERNEL_VARIANTS
+#undef MATRIX_HAS_F16C_KERNELS
+#undef MATRIX_HAS_LOOKUP_KERNELS
+
+inline const KernelTable& kernelsFor(cpu::Isa isa)
+{
+#ifdef MATRIX_HAS_ISA_VARIANTS
+    switch(isa)
+    {
+        case cpu::Isa::AVX512VNNI: return kernels_avx512vnni::table;
+        case cpu::Isa::AVX512: return kernels_avx512::table;
+        case cpu::Isa::AVX2:   return kernels_avx2::table;
+        case cpu::Isa::SSE42:  return kernels_sse42::table;
+        default: break;
+    }
+#endif
+    (void)isa;
+    return kernels_baseline::table;
+}
+
+// bound once, then every call is a plain indirect call
+inline const KernelTable& kernels()
+{
+    static const KernelTable& table = kernelsFor(cpu::activeIsa());
+    return table;
+}
+
+// ---- Matrix/Image front ends. Outputs are reshaped (re-init'ed) only when their shape differs.
+
+template<typename T>
+void reshape(Matrix<T>& mat, int nRows, int nCols)
+{
+    if(mat.nRows != nRows || mat.nCols != nCols || !mat.mem)
+        mat.init(nRows, nCols);
+}
+
+inline void multiply(const Matrix<float>& a, const Matrix<float>& b, Matrix<float>& c)
+{
+    TRACE_SPAN("multiply");
+    if(a.nCols != b.nRows)
+        throw std::invalid_argument("multiply: inner dimensions differ");
+    reshape(c, a.nRows, b.nCols);
+    kernels().matmul(a.mem, b.mem, c.mem, a.nRows, a.nCols, b.nCols);
+}
+
+inline void convolve(const Matrix<float>& src, const Matrix<float>& kernel, Matrix<float>& dst)
+{
+    TRACE_SPAN("convolve");
+    reshape(dst, src.nRows, src.nCols);
+    kernels().convolve(src.mem, dst.mem, src.nRows, src.nCols, kernel.mem, kernel.nRows, kernel.nCols);
+}
+
+inline float sum(const Matrix<float>& mat)
+{
+    TRACE_SPAN("sum");
+    return kernels().sum(mat.mem, mat.numElements());
+}
+
+inline uint64_t sum(const Matrix<uint8_t>& mat)
+{
+    TRACE_SPAN("sum u8");
+    return kernels().sumU8(mat.mem, mat.numElements());
+}
+
+inline void minMax(const Matrix<float>& mat, float& lo, float& hi)
+{
+    TRACE_SPAN("minMax");
+    kernels().minMax(mat.mem, mat.numElements(), &lo, &hi);
+}
+
+// ---- float16 / bfloat16 matrices: bulk conversions, and reductions and element-wise
+// operations that convert a block at a time into an L1-sized float buffer and run
+// in float, so the 16 bit data is only ever read and written once.
+
+inline void convert(const Matrix<float16>& src, Matrix<float>& dst)
+{
+    TRACE_SPAN("convert f16 -> float");
+    reshape(dst, src.nRows, src.nCols);
+    kernels().halfToFloat(src.mem, dst.mem, src.numElements());
+}
+
+inline void convert(const Matrix<float>& src, Matrix<float16>& dst)
+{
+    TRACE_SPAN("convert float -> f16");
+    reshape(dst, src.nRows, src.nCols);
+    kernels().floatToHalf(src.mem, dst.mem, src.numElements());
+}
+
+inline void convert(const Matrix<bfloat16>& src, Matrix<float>& dst)
+{
+    TRACE_SPAN("convert bf16 -> float");
+    reshape(dst, src.nRows, src.nCols);
+    kernels().bfloatToFloat(src.mem, dst.mem, src.numElements());
+}
+
+inline void convert(const Matrix<float>& src, Matrix<bfloat16>& dst)
+{
+    TRACE_SPAN("convert float -> bf16");
+    reshape(dst, src.nRows, src.nCols);
+    kernels().floatToBfloat(src.mem, dst.mem, src.numElements());
+}
+
+namespace kernels_detail
+{
+    constexpr size_t FLOAT_BLOCK = 2048;       // 8 KB
+
+    // n elements as floats: in place for float, converted into buf otherwise
+    inline const float* loadFloats(const float* src, size_t, float*) { return src; }
+    inline const float* loadFloats(const float16* src, size_t n, float* buf) { kernels().halfToFloat(src, buf, n); return buf; }
+    inline const float* loadFloats(const bfloat16* src, size_t n, float* buf) { kernels().bfloatToFloat(src, buf, n); return buf; }
+
+    // where to compute n floats bound for dst, and storing them there afterwards
+    inline float* floatOutput(float* dst, float*) { return dst; }
+    template<typename T> float* floatOutput(T*, float* buf) { return buf; }
+    inline void storeFloats(const float*, size_t, float*) { }
+    inline void storeFloats(const float* buf, size_t n, float16* dst) { kernels().floatToHalf(buf, dst, n); }
+    inline void storeFloats(const float* buf, size_t n, bfloat16* dst) { kernels().floatToBfloat(buf, dst, n); }
+
+    template<typename T, typename FUNC>
+    void forEachFloatBlock(const Matrix<T>& mat, FUNC&& func)
+    {
+        float buf[FLOAT_BLOCK];
+        const size_t n = mat.numElements();
+        for(size_t i = 0; i < n; i += FLOAT_BLOCK)
+        {
+            const size_t len = std::min(FLOAT_BLOCK, n - i);
+            func(loadFloats(mat.mem + i, len, buf), len);
+        }
+    }
+
+    template<typename T>
+    float sumInFloat(const Matrix<T>& mat)
+    {
+        double total = 0;
+        forEachFloatBlock(mat, [&](const float* p, size_t n) { total += kernels().sum(p, n); });
+        return static_cast<float>(total);
+    }
+
+    template<typename T>
+    void minMaxInFloat(const Matrix<T>& mat, float& lo, float& hi)
+    {
+        if(mat.numElements() == 0) { lo = hi = 0.f; return; }     // as minMax on floats
+        lo = std::numeric_limits<float>::infinity();
+        hi = -lo;
+        forEachFloatBlock(mat, [&](const float* p, size_t n) {
+            float blockLo, blockHi;
+            kernels().minMax(p, n, &blockLo, &blockHi);
+            lo = std::min(lo, blockLo);
+            hi = std::max(hi, blockHi);
+        });
+    }
+}
+
+inline float sum(const Matrix<float16>& mat)
+{
+    TRACE_SPAN("sum f16");
+    return kernels_detail::sumInFloat(mat);
+}
+
+inline float sum(const Matrix<bfloat16>& mat)
+{
+    TRACE_SPAN("sum bf16");
+    return kernels_detail::sumInFloat(mat);
+}
+
+inline void minMax(const Matrix<float16>& mat, float& lo, float& hi)
+{
+    TRACE_SPAN("minMax f16");
+    kernels_detail::minMaxInFloat(mat, lo, hi);
+}
+
+inline void minMax(const Matrix<bfloat16>& mat, float& lo, float& hi)
+{
+    TRACE_SPAN("minMax bf16");
+    kernels_detail::minMaxInFloat(mat, lo, hi);
+}
+
+// dst = func(src) element by element, in float, for any mix of float, float16 and
+// bfloat16 matrices. func runs in a plain loop over a block, so a simple lambda
+// vectorizes.
+//     transformInFloat(h, h, [](float x) { return 0.5f*x + 1; });
+template<typename S, typename D, typename FUNC>
+void transformInFloat(const Matrix<S>& src, Matrix<D>& dst, FUNC func)
+{
+    TRACE_SPAN("transformInFloat");
+    reshape(dst, src.nRows, src.nCols);
+    float in[kernels_detail::FLOAT_BLOCK], out[kernels_detail::FLOAT_BLOCK];
+    const size_t n = src.numElements();
+    for(size_t i = 0; i < n; i += kernels_detail::FLOAT_BLOCK)
+    {
+        const size_t len = std::min(kernels_detail::FLOAT_BLOCK, n - i);
+        const float* x = kernels_detail::loadFloats(src.mem + i, len, in);
+        float* y = kernels_detail::floatOutput(dst.mem + i, out);
+        for(size_t j = 0; j < len; ++j) y[j] = func(x[j]);
+        kernels_detail::storeFloats(y, len, dst.mem + i);
+    }
+}
+
+// dst = func(a, b), the binary form; a and b must have the same shape
+template<typename A, typename B, typename D, typename FUNC>
+void transformInFloat(const Matrix<A>& a, const Matrix<B>& b, Matrix<D>& dst, FUNC func)
+{
+    TRACE_SPAN("transformInFloat");
+    if(a.nRows != b.nRows || a.nCols != b.nCols)
+        throw std::invalid_argument("transformInFloat: operands differ in shape");
+    reshape(dst, a.nRows, a.nCols);
+    float inA[kernels_detail::FLOAT_BLOCK], inB[kernels_detail::FLOAT_BLOCK], out[kernels_detail::FLOAT_BLOCK];
+    const size_t n = a.numElements();
+    for(size_t i = 0; i < n; i += kernels_detail::FLOAT_BLOCK)
+    {
+        const size_t len = std::min(kernels_detail::FLOAT_BLOCK, n - i);
+        const float* x = kernels_detail::loadFloats(a.mem + i, len, inA);
+        const float* y = kernels_detail::loadFloats(b.mem + i, len, inB);
+        float* z = kernels_detail::floatOutput(dst.mem + i, out);
+        for(size_t j = 0; j < len; ++j) z[j] = func(x[j], y[j]);
+        kernels_detail::storeFloats(z, len, dst.mem + i);
+    }
+}
+
+// 64 bit hash of a matrix's shape, element size and bytes: equal matrices hash
+// equal, on every ISA. For keying caches of derived results (see MemoCache.h);
+// elements are hashed as raw bytes, so types with padding need it zeroed.
+template<typename T>
+uint64_t contentHash(const Matrix<T>& mat, uint64_t seed = 0)
+{
+    TRACE_SPAN("contentHash");
+    const uint64_t shape = uint64_t(uint32_t(mat.nRows)) << 32 | uint32_t(mat.nCols);
+    return kernels().hashBytes(reinterpret_cast<const uint8_t*>(mat.mem), mat.numElements()*sizeof(T),
+                               kernels_detail::mix64(seed ^ kernels_detail::mix64(shape + sizeof(T))));
+}
+
+inline void toGray(const Matrix<Color>& img, Matrix<uint8_t>& gray)
+{
+    TRACE_SPAN("toGray");
+    reshape(gray, img.nRows, img.nCols);
+    kernels().rgbToGray(img.mem, gray.mem, img.numElements());
+}
+
+inline void toColor(const Matrix<uint8_t>& gray, Matrix<Color>& img)
+{
+    TRACE_SPAN("toColor");
+    reshape(img, gray.nRows, gray.nCols);
+    kernels().grayToRgb(gray.mem, img.mem, gray.numElements());
+}
+
+// Conversions below, measured against double-precision references over
+// every input they accept (bench_color_convert checks them):
+//   toYuv420     Y, U, V within 1 of the exact rounded value
+//   fromYuv420   R, G, B within 1 (for in-gamut YUV)
+//   toHsv        H within 1/256 turn, S and V within 1
+//   fromHsv      R, G, B within 1
+inline void toYuv420(const Matrix<Color>& img, Yuv420& yuv)
+{
+    TRACE_SPAN("toYuv420");
+    reshape(yuv.y, img.nRows, img.nCols);
+    reshape(yuv.u, (img.nRows + 1)/2, (img.nCols + 1)/2);
+    reshape(yuv.v, (img.nRows + 1)/2, (img.nCols + 1)/2);
+    kernels().rgbToYuv420(img.mem, img.nRows, img.nCols, yuv.y.mem, yuv.u.mem, yuv.v.mem);
+}
+
+inline void fromYuv420(const Yuv420& yuv, Matrix<Color>& img)
+{
+    TRACE_SPAN("fromYuv420");
+    const int cRows = (yuv.y.nRows + 1)/2, cCols = (yuv.y.nCols + 1)/2;
+    if(yuv.u.nRows != cRows || yuv.u.nCols != cCols || yuv.v.nRows != cRows || yuv.v.nCols != cCols)
+        throw std::invalid_argument("fromYuv420: chroma planes must be half the luma size");
+    reshape(img, yuv.y.nRows, yuv.y.nCols);
+    kernels().yuv420ToRgb(yuv.y.mem, yuv.u.mem, yuv.v.mem, yuv.y.nRows, yuv.y.nCols, img.mem);
+}
+
+inline void toHsv(const Matrix<Color>& img, Matrix<Hsv>& hsv)
+{
+    TRACE_SPAN("toHsv");
+    reshape(hsv, img.nRows, img.nCols);
+    kernels().rgbToHsv(img.mem, hsv.mem, img.numElements());
+}
+
+inline void fromHsv(const Matrix<Hsv>& hsv, Matrix<Color>& img)
+{
+    TRACE_SPAN("fromHsv");
+    reshape(img, hsv.nRows, hsv.nCols);
+    kernels().hsvToRgb(hsv.mem, img.mem, hsv.numElements());
+}
+
+#endif
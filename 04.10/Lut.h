@@ -0,0 +1,228 @@
+#ifndef __Lut_h
+#define __Lut_h
+
+// Lookup tables for per-pixel transforms, generated at compile time. A
+// gamma or tone curve has at most 256 (or 65536) distinct inputs, so
+// instead of a pow() or exp() per pixel it is evaluated once per input
+// value, by the compiler, and the table ends up in read-only data: no work
+// at run time, none at startup.
+//
+//     applyLut(img, out, luts::gamma22);              // every channel of an Image
+//
+//     constexpr auto stretch = makeCurveLut<uint8_t, 256>([](double x) { return curves::contrast(x, 0.1, 0.9); });
+//     applyLut(gray, gray, stretch);                  // in place is fine
+//
+//     applyLut(raw16, display16, luts::srgbEncode16<>); // 65536 entries, uint16_t
+//
+// Curves are plain constexpr functions on [0, 1], built on the constexpr
+// exp/log/pow below (std:: ones are not constexpr before C++26); anything
+// constexpr works with makeLut/makeCurveLut. Applying a table is
+// dispatched (Kernels.h): 256 byte tables go through byte shuffles, 16 to
+// 64 pixels at a time, 65536 entry ones through gathers. Those are about
+// even with a plain loop, since a gather is still a load per element; the
+// shuffles are not (bench/lut_transform.cpp).
+
+#include <limits>
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+
+#include "Kernels.h"
+#include "Matrix.h"
+
+template<typename Out, size_t N>
+struct Lut
+{
+    Out table[N];
+
+    constexpr const Out& operator[](size_t i) const { return table[i]; }
+    static constexpr size_t size() { return N; }
+    const Out* data() const { return table; }
+};
+
+// entry i = f(i), for any constexpr callable
+template<typename Out, size_t N, typename FUNC>
+constexpr Lut<Out, N> makeLut(FUNC f)
+{
+    Lut<Out, N> lut{};
+    for(size_t i = 0; i < N; ++i) lut.table[i] = static_cast<Out>(f(i));
+    return lut;
+}
+
+// Entry i = curve(i/(N - 1)) for a curve from [0, 1] to [0, 1], scaled to
+// the full range of an integer Out (rounded, clamped) or left as is for a
+// floating-point one.
+template<typename Out, size_t N, typename CURVE>
+constexpr Lut<Out, N> makeCurveLut(CURVE curve)
+{
+    constexpr double top = std::is_floating_point<Out>::value ? 1 : std::numeric_limits<Out>::max();
+    Lut<Out, N> lut{};
+    for(size_t i = 0; i < N; ++i)
+    {
+        const double y = curve(static_cast<double>(i)/(N - 1));
+        if constexpr(std::is_floating_point<Out>::value) lut.table[i] = static_cast<Out>(y);
+        else lut.table[i] = static_cast<Out>((y < 0 ? 0 : y > 1 ? 1 : y)*top + 0.5);
+    }
+    return lut;
+}
+
+// Kept cheap: a 65536 entry table has to fit the compiler's budget for one
+// constant expression (-fconstexpr-ops-limit, 2^25 in GCC), about 500
+// operations per entry, and loop iterations are what costs there. So the
+// common path has none: range reduction by tables and unrolled steps, then
+// a short polynomial around 2^(j/8), good to a few ulp.
+namespace lut_math
+{
+    constexpr double LN2 = 0.69314718055994530942;
+    constexpr double ROOTS_OF_2[8] = {1.0, 1.0905077326652577, 1.1892071150027211, 1.2968395546510096,
+                                      1.4142135623730951, 1.5422108254079408, 1.6817928305074290, 1.8340080864093424};
+
+    // 2^-64 .. 2^63
+    struct PowersOf2 { double v[128]; };
+
+    constexpr PowersOf2 makePowersOf2()
+    {
+        PowersOf2 p{};
+        p.v[64] = 1;
+        for(int i = 65; i < 128; ++i) p.v[i] = 2*p.v[i - 1];
+        for(int i = 63; i >= 0; --i) p.v[i] = p.v[i + 1]/2;
+        return p;
+    }
+
+    constexpr PowersOf2 POWERS_OF_2 = makePowersOf2();
+
+    // x*2^e
+    constexpr double scale2(double x, long e)
+    {
+        for(; e > 63; e -= 63) x *= 0x1p63;
+        for(; e < -64; e += 64) x *= 0x1p-64;
+        return x*POWERS_OF_2.v[e + 64];
+    }
+
+    // x = (8q + j)*ln2/8 + r with |r| <= ln2/16: e^x = 2^q * 2^(j/8) * e^r, e^r from its series
+    constexpr double exp(double x)
+    {
+        if(x < -745) return 0;
+        const double kf = x*8/LN2;
+        const long k = static_cast<long>(kf < 0 ? kf - 0.5 : kf + 0.5);
+        const double r = x - k*(LN2/8);
+        const double er = 1 + r*(1 + r/2*(1 + r/3*(1 + r/4*(1 + r/5*(1 + r/6*(1 + r/7*(1 + r/8)))))));
+        const long q = k >= 0 ? k/8 : -((7 - k)/8);
+        return scale2(er*ROOTS_OF_2[k - 8*q], q);
+    }
+
+    // x = 2^e * 2^(j/8) * m with m in [1, 1.125]: log(m) = 2 atanh((m - 1)/(m + 1)) from its series
+    constexpr double log(double x)
+    {
+        long e = 0;
+        for(; x >= 0x1p32; e += 32) x *= 0x1p-32;
+        for(; x < 1; e -= 32) x *= 0x1p32;
+        // [1, 2^32) down to [1, 2)
+        if(x >= 0x1p16) { x *= 0x1p-16; e += 16; }
+        if(x >= 0x1p8) { x *= 0x1p-8; e += 8; }
+        if(x >= 0x1p4) { x *= 0x1p-4; e += 4; }
+        if(x >= 0x1p2) { x *= 0x1p-2; e += 2; }
+        if(x >= 0x1p1) { x *= 0x1p-1; e += 1; }
+        const int j = static_cast<int>(8*(x - 1));
+        const double m = x/ROOTS_OF_2[j];
+        const double t = (m - 1)/(m + 1), t2 = t*t;
+        const double atanh = t*(1 + t2*(1.0/3 + t2*(1.0/5 + t2*(1.0/7 + t2*(1.0/9 + t2*(1.0/11 + t2/13))))));
+        return 2*atanh + (e + j/8.0)*LN2;
+    }
+
+    // for x >= 0
+    constexpr double pow(double x, double y) { return x <= 0 ? (y == 0 ? 1 : 0) : exp(y*log(x)); }
+}
+
+// curves on [0, 1]
+namespace curves
+{
+    constexpr double gamma(double x, double g) { return lut_math::pow(x, g); }
+
+    // the sRGB transfer function: linear light -> encoded, and back
+    constexpr double srgbEncode(double x)
+    {
+        return x <= 0.0031308 ? 12.92*x : 1.055*lut_math::pow(x, 1/2.4) - 0.055;
+    }
+
+    constexpr double srgbDecode(double x)
+    {
+        return x <= 0.04045 ? x/12.92 : lut_math::pow((x + 0.055)/1.055, 2.4);
+    }
+
+    // [lo, hi] stretched over the whole range, clipped outside it
+    constexpr double contrast(double x, double lo, double hi)
+    {
+        const double y = (x - lo)/(hi - lo);
+        return y < 0 ? 0 : y > 1 ? 1 : y;
+    }
+
+    // Reinhard tone mapping x*e/(1 + x*e), scaled so that 1 stays 1
+    constexpr double reinhard(double x, double exposure)
+    {
+        return x*exposure/(1 + x*exposure)*(1 + exposure)/exposure;
+    }
+
+    // logistic S-curve around mid-gray, through (0, 0) and (1, 1); steeper for larger strength
+    constexpr double sCurve(double x, double strength)
+    {
+        const double lo = 1/(1 + lut_math::exp(strength/2)), hi = 1/(1 + lut_math::exp(-strength/2));
+        return (1/(1 + lut_math::exp(-strength*(x - 0.5))) - lo)/(hi - lo);
+    }
+}
+
+// predefined tables, all constant-initialized
+namespace luts
+{
+    inline constexpr Lut<uint8_t, 256> gamma22 = makeCurveLut<uint8_t, 256>([](double x) { return curves::gamma(x, 1/2.2); });
+    inline constexpr Lut<uint8_t, 256> degamma22 = makeCurveLut<uint8_t, 256>([](double x) { return curves::gamma(x, 2.2); });
+    inline constexpr Lut<uint8_t, 256> srgbEncode = makeCurveLut<uint8_t, 256>(curves::srgbEncode);
+    inline constexpr Lut<uint8_t, 256> srgbDecode = makeCurveLut<uint8_t, 256>(curves::srgbDecode);
+    inline constexpr Lut<uint8_t, 256> sCurve = makeCurveLut<uint8_t, 256>([](double x) { return curves::sCurve(x, 6); });
+    inline constexpr Lut<uint8_t, 256> reinhard = makeCurveLut<uint8_t, 256>([](double x) { return curves::reinhard(x, 4); });
+    // 8 bit sRGB to 16 bit linear, for working on it without banding
+    inline constexpr Lut<uint16_t, 256> srgbToLinear16 = makeCurveLut<uint16_t, 256>(curves::srgbDecode);
+    // 16 bit linear to sRGB. Building 65536 entries takes the compiler some seconds, so it is a
+    // template, only built in translation units that use it: luts::srgbEncode16<> (or <float>)
+    template<typename Out = uint16_t>
+    inline constexpr Lut<Out, 65536> srgbEncode16 = makeCurveLut<Out, 65536>(curves::srgbEncode);
+}
+
+// ---- Applying tables. Outputs are reshaped only when their shape differs.
+
+inline void applyLut(const Matrix<uint8_t>& src, Matrix<uint8_t>& dst, const Lut<uint8_t, 256>& lut)
+{
+    TRACE_SPAN("applyLut u8");
+    reshape(dst, src.nRows, src.nCols);
+    kernels().lookup8(src.mem, dst.mem, src.numElements(), lut.data());
+}
+
+// the same table for every channel
+inline void applyLut(const Matrix<Color>& src, Matrix<Color>& dst, const Lut<uint8_t, 256>& lut)
+{
+    TRACE_SPAN("applyLut Image");
+    reshape(dst, src.nRows, src.nCols);
+    kernels().lookup8(reinterpret_cast<const uint8_t*>(src.mem), reinterpret_cast<uint8_t*>(dst.mem),
+                      3*src.numElements(), lut.data());
+}
+
+inline void applyLut(const Matrix<uint16_t>& src, Matrix<uint16_t>& dst, const Lut<uint16_t, 65536>& lut)
+{
+    TRACE_SPAN("applyLut u16");
+    reshape(dst, src.nRows, src.nCols);
+    kernels().lookup16(src.mem, dst.mem, src.numElements(), lut.data());
+}
+
+// any other full table over an unsigned integer type, e.g. srgbToLinear16; a plain loop
+template<typename In, typename Out, size_t N>
+void applyLut(const Matrix<In>& src, Matrix<Out>& dst, const Lut<Out, N>& lut)
+{
+    static_assert(std::is_unsigned<In>::value && sizeof(In) <= 2 && N == size_t(1) << 8*sizeof(In),
+                  "the table needs an entry for every value of the input type");
+    TRACE_SPAN("applyLut");
+    reshape(dst, src.nRows, src.nCols);
+    const size_t n = src.numElements();
+    for(size_t i = 0; i < n; ++i) dst.mem[i] = lut[src.mem[i]];
+}
+
+#endif
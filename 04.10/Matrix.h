@@ -1,69 +1,209 @@
 #ifndef __Matrix_h
 #define __Matrix_h
 
+#include <algorithm>
+#include <cstddef>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "Trace.h"
 #include <stdint.h>
 
+// Element access policy for Matrix::operator().
+// Checked (bounds + null memory, throws std::out_of_range) in debug builds,
+// a plain branch-free mem[row*nCols+col] once NDEBUG is set. Define
+// MATRIX_CHECKED_ACCESS to 0/1 to force either one.
+#ifndef MATRIX_CHECKED_ACCESS
+#ifdef NDEBUG
+#define MATRIX_CHECKED_ACCESS 0
+#else
+#define MATRIX_CHECKED_ACCESS 1
+#endif
+#endif
+
+// The lessons trace every construction/destruction on stdout. Benchmarks and
+// other hot paths build with MATRIX_VERBOSE=0 to keep that out of the timings.
+#ifndef MATRIX_VERBOSE
+#define MATRIX_VERBOSE 1
+#endif
+
+// a contiguous run of elements, e.g. one matrix row. (std::span is C++20)
+template<typename T>
+struct Span
+{
+    T* ptr;
+    size_t n;
+
+    T* data() const { return ptr; }
+    size_t size() const { return n; }
+    T* begin() const { return ptr; }
+    T* end() const { return ptr + n; }
+    T& operator[](size_t i) const { return ptr[i]; }
+};
+
+// Iterator that jumps `step` elements at a time.
+// With Ref = T& it walks a column (step = nCols) and is random access.
+// With Ref = Span<T> it walks whole rows (step = nCols, each row is a Span
+// of nCols elements). A row is handed out by value, which a forward
+// iterator may not do, so that one is only an input iterator: fine for
+// range-for and the sequential algorithms, but the std::execution ones
+// need forward iterators. Run those over a row's elements instead.
+template<typename T, typename Ref>
+class StepIterator
+{
+    T* ptr = nullptr;
+    std::ptrdiff_t step = 1;
+
+public:
+    using iterator_category = typename std::conditional<std::is_reference<Ref>::value, std::random_access_iterator_tag,
+                                                        std::input_iterator_tag>::type;
+    using value_type = typename std::remove_cv<typename std::remove_reference<Ref>::type>::type;
+    using difference_type = std::ptrdiff_t;
+    using reference = Ref;
+    using pointer = void;
+
+    StepIterator() = default;
+    StepIterator(T* ptr, std::ptrdiff_t step) : ptr(ptr), step(step) { }
+
+    Ref operator*() const
+    {
+        if constexpr(std::is_same<Ref, T&>::value) return *ptr;
+        else return Ref{ptr, static_cast<size_t>(step)};
+    }
+    Ref operator[](difference_type n) const { return *(*this + n); }
+
+    StepIterator& operator++() { ptr += step; return *this; }
+    StepIterator& operator--() { ptr -= step; return *this; }
+    StepIterator operator++(int) { auto old = *this; ptr += step; return old; }
+    StepIterator operator--(int) { auto old = *this; ptr -= step; return old; }
+    StepIterator& operator+=(difference_type n) { ptr += n*step; return *this; }
+    StepIterator& operator-=(difference_type n) { ptr -= n*step; return *this; }
+    friend StepIterator operator+(StepIterator it, difference_type n) { return it += n; }
+    friend StepIterator operator+(difference_type n, StepIterator it) { return it += n; }
+    friend StepIterator operator-(StepIterator it, difference_type n) { return it -= n; }
+    friend difference_type operator-(const StepIterator& a, const StepIterator& b) { return a.step == 0 ? 0 : (a.ptr - b.ptr)/a.step; }
+
+    friend bool operator==(const StepIterator& a, const StepIterator& b) { return a.ptr == b.ptr; }
+    friend bool operator!=(const StepIterator& a, const StepIterator& b) { return a.ptr != b.ptr; }
+    friend bool operator<(const StepIterator& a, const StepIterator& b) { return a.ptr < b.ptr; }
+    friend bool operator>(const StepIterator& a, const StepIterator& b) { return a.ptr > b.ptr; }
+    friend bool operator<=(const StepIterator& a, const StepIterator& b) { return a.ptr <= b.ptr; }
+    friend bool operator>=(const StepIterator& a, const StepIterator& b) { return a.ptr >= b.ptr; }
+};
+
+template<typename T> using ColumnIterator = StepIterator<T, T&>;
+template<typename T> using RowIterator = StepIterator<T, Span<T>>;
+
+template<typename It>
+struct Range
+{
+    It first, last;
+
+    It begin() const { return first; }
+    It end() const { return last; }
+    size_t size() const { return static_cast<size_t>(last - first); }
+};
+
 struct MatrixCore
 {
     virtual void load() = 0;
 };
 
+// Where a matrix's elements live, for matrices that should not simply get
+// new T[] (NUMA placement, huge pages). An allocator hands out untouched
+// memory and decides which threads write it first; the matrix only keeps a
+// pointer to it, so it has to outlive every matrix using it.
+//
+//     Matrix<float> big(rows, cols, numa::interleaved());
+struct MatrixAllocator
+{
+    virtual ~MatrixAllocator() = default;
+
+    // rows*rowBytes bytes, suitably aligned for any element type
+    virtual void* allocate(size_t rows, size_t rowBytes) const = 0;
+    virtual void deallocate(void* p, size_t bytes) const = 0;
+
+    // runs init(row0, row1) over all rows: the first write to a page decides
+    // where the kernel puts it, so this may split the rows across threads
+    virtual void firstTouch(size_t rows, const std::function<void(size_t, size_t)>& init) const { init(0, rows); }
+};
+
 template<typename T>
 class Matrix : public MatrixCore
 {
 public:
     int nRows, nCols;
     T* mem;
+    const MatrixAllocator* allocator = nullptr;     // null: new T[]; kept by init(), taken from the source by copies and moves
 
     void printMemoryUsage() const
     {
         std::cout << "memory allocated: (" << nRows << ", " << nCols << ") = " << (numElements()*sizeof(T)) << " bytes" << std::endl;
     }
 
-    size_t numElements() const { return static_cast<size_t>(nRows*nCols); }
+    size_t numElements() const { return static_cast<size_t>(nRows)*nCols; }
 
     void fillWithZeros() {
         if(!mem) return;
+        TRACE_SPAN("Matrix::fillWithZeros");
         auto nElems = numElements();
         // starting address
         auto ptr = mem;
-        for (int i = 0; i < nElems; ++i, ++ptr) *ptr = 0;
+        for (size_t i = 0; i < nElems; ++i, ++ptr) *ptr = 0;
     }
 
     void init(int nRows, int nCols)
     {
+        TRACE_SPAN("Matrix::init");
         clear();
         this->nRows = nRows;
         this->nCols = nCols;
-        mem = new T[numElements()];
-        fillWithZeros();
-        printMemoryUsage();
+        if(allocator) allocateFrom(*allocator);
+        else
+        {
+            mem = new T[numElements()];
+            fillWithZeros();
+        }
+        if constexpr(MATRIX_VERBOSE) printMemoryUsage();
+    }
+
+    Matrix(int nRows, int nCols) : Matrix(nRows, nCols, nullptr)
+    {
     }
 
-    Matrix(int nRows, int nCols) : nRows(nRows), nCols(nCols), mem(numElements() == 0 ? nullptr : new T[numElements()])
+    // zeroed like the one above, the zeros written as the allocator's first touch
+    Matrix(int nRows, int nCols, const MatrixAllocator& allocator) : Matrix(nRows, nCols, &allocator)
     {
-        fillWithZeros();
-        std::cout << "created" << std::endl;
-        printMemoryUsage();
+        static_assert(std::is_trivially_destructible<T>::value, "Matrix: allocators only hold trivially destructible elements");
     }
 
     Matrix() : Matrix(0, 0) // delegated ctor
     {
     }
 
-    Matrix(const Matrix& other) : Matrix(other.nRows, other.nCols)
+    // a copy lives where the original does, whether constructed or assigned (as with moves)
+    Matrix(const Matrix& other) : Matrix(other.nRows, other.nCols, other.allocator)
     {
-        copy(other.mem, other.mem + other.numElements(), mem);
+        TRACE_SPAN("Matrix copy ctor");
+        std::copy(other.mem, other.mem + other.numElements(), mem);
     }
 
     void operator=(const Matrix& other)
     {
+        if(this == &other) return;
+        TRACE_SPAN("Matrix copy assign");
+        clear();
+        allocator = other.allocator;
         init(other.nRows, other.nCols);
-        copy(other.mem, other.mem + other.numElements(), mem);
+        std::copy(other.mem, other.mem + other.numElements(), mem);
     }
 
-    Matrix(Matrix&& other) : nRows(other.nRows), nCols(other.nCols), mem(other.mem)
+    Matrix(Matrix&& other) : nRows(other.nRows), nCols(other.nCols), mem(other.mem), allocator(other.allocator)
     {
         other.mem = nullptr;
     }
@@ -74,39 +214,134 @@ public:
         nRows = other.nRows;
         nCols = other.nCols;
         mem = other.mem;
+        allocator = other.allocator;
         other.mem = nullptr;
     }
 
+    // init() with memory from `allocator`, which later init()s keep using
+    void init(int nRows, int nCols, const MatrixAllocator& allocator)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "Matrix: allocators only hold trivially destructible elements");
+        clear();
+        this->allocator = &allocator;
+        init(nRows, nCols);
+    }
+
+    // no more static dummy to fall back on: it was shared by every thread and
+    // the branch in front of every access kept loops from vectorizing.
     T& operator()(int row, int col) const
     {
-        static T dummy;
-//        if(mem == nullptr)
+        if constexpr(MATRIX_CHECKED_ACCESS)
+            return at(row, col);
+        else
+            return unchecked(row, col);
+    }
+
+    T& at(int row, int col) const
+    {
         if(!mem)
-        {
-            std::cout << "OOOPS!" << std::endl;
-            return dummy;
-        }
-        return mem[row*nCols+col];
+            throw std::out_of_range("OOOPS! Matrix has no memory");
+        if(row < 0 || row >= nRows || col < 0 || col >= nCols)
+            throw std::out_of_range("Matrix index (" + std::to_string(row) + ", " + std::to_string(col) + ") out of range");
+        return mem[static_cast<size_t>(row)*nCols+col];
+    }
+
+    T& unchecked(int row, int col) const { return mem[static_cast<size_t>(row)*nCols+col]; }
+
+    // whole row as raw contiguous memory, for inner loops
+    Span<T> row(int i)
+    {
+        if constexpr(MATRIX_CHECKED_ACCESS)
+            if(i < 0 || i >= nRows) throw std::out_of_range("Matrix row " + std::to_string(i) + " out of range");
+        return {mem + static_cast<size_t>(i)*nCols, static_cast<size_t>(nCols)};
+    }
+
+    Span<const T> row(int i) const
+    {
+        if constexpr(MATRIX_CHECKED_ACCESS)
+            if(i < 0 || i >= nRows) throw std::out_of_range("Matrix row " + std::to_string(i) + " out of range");
+        return {mem + static_cast<size_t>(i)*nCols, static_cast<size_t>(nCols)};
     }
 
+    // Contiguous row-major iteration over all elements. These are raw pointers,
+    // so std algorithms (including the std::execution::par ones) take them as is.
+    T* begin() { return mem; }
+    T* end() { return mem + numElements(); }
+    const T* begin() const { return mem; }
+    const T* end() const { return mem + numElements(); }
+
+    // for(auto row : mat.rows()) for(auto& v : row) ...    (input iterators, see StepIterator)
+    Range<RowIterator<T>> rows() { return {{mem, nCols}, {end(), nCols}}; }
+    Range<RowIterator<const T>> rows() const { return {{mem, nCols}, {end(), nCols}}; }
+
+    // for(auto& v : mat.column(j)) ...
+    Range<ColumnIterator<T>> column(int j) { return {{mem + j, nCols}, {mem + j + numElements(), nCols}}; }
+    Range<ColumnIterator<const T>> column(int j) const { return {{mem + j, nCols}, {mem + j + numElements(), nCols}}; }
+
     void clear()
     {
-        delete[] mem;
+        if(allocator)
+        {
+            if(mem) allocator->deallocate(mem, numElements()*sizeof(T));
+        }
+        else delete[] mem;
         mem = nullptr;
-        std::cout << "memory cleared" << std::endl;
+        if constexpr(MATRIX_VERBOSE) std::cout << "memory cleared" << std::endl;
     }
 
     ~Matrix()
     {
         clear();
-        std::cout << "destroyed" << std::endl;
+        if constexpr(MATRIX_VERBOSE) std::cout << "destroyed" << std::endl;
     }
 
     void load() override
     {
+        TRACE_SPAN("Matrix::load");
         std::cout << "Matrix loaded!" << std::endl;
     }
 
+private:
+    // null: new T[]
+    Matrix(int nRows, int nCols, const MatrixAllocator* from) : nRows(nRows), nCols(nCols), mem(nullptr)
+    {
+        TRACE_SPAN("Matrix::Matrix");
+        if(from) allocateFrom(*from);
+        else if(numElements() != 0)
+        {
+            mem = new T[numElements()];
+            fillWithZeros();
+        }
+        if constexpr(MATRIX_VERBOSE)
+        {
+            std::cout << "created" << std::endl;
+            printMemoryUsage();
+        }
+    }
+
+    void allocateFrom(const MatrixAllocator& from)
+    {
+        // the public ways in static_assert this; copies of other matrices never have an allocator
+        if constexpr(!std::is_trivially_destructible<T>::value)
+            throw std::logic_error("Matrix: allocators only hold trivially destructible elements");
+        allocator = &from;
+        if(numElements() == 0) return;
+        const size_t rowBytes = static_cast<size_t>(nCols)*sizeof(T);
+        T* p = static_cast<T*>(from.allocate(static_cast<size_t>(nRows), rowBytes));
+        try
+        {
+            from.firstTouch(static_cast<size_t>(nRows), [p, this](size_t r0, size_t r1) {
+                std::uninitialized_value_construct(p + r0*nCols, p + r1*nCols);
+            });
+        }
+        catch(...)
+        {
+            // e.g. std::system_error from starting a thread
+            from.deallocate(p, static_cast<size_t>(nRows)*rowBytes);
+            throw;
+        }
+        mem = p;
+    }
 };
 
 struct Color
@@ -126,6 +361,7 @@ struct Image : public Matrix<Color>
 
     void load() override
     {
+        TRACE_SPAN("Image::load");
         std::cout << "Image loaded!" << std::endl;
     }
 };
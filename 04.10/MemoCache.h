@@ -0,0 +1,243 @@
+#ifndef __MemoCache_h
+#define __MemoCache_h
+
+// Memoization of derived results (thumbnails, filtered images, statistics),
+// keyed by what they were computed from: the content hash of the input, the
+// operation and its parameters. The same source arriving again, even in a
+// different buffer, then costs a hash instead of the whole computation.
+//
+//     MemoCache cache(256 << 20);             // 256 MB of results at most
+//
+//     MemoKey key{contentHash(img), "thumbnail", hashParams(160, 120)};
+//     std::shared_ptr<const Image> thumb = cache.get<Image>(key, [&] { return makeThumbnail(img, 160, 120); });
+//
+//     printf("hit rate %.1f%%\n", 100*cache.stats().hitRate());
+//
+// Results are shared and immutable: get() hands out shared_ptr<const R>, so
+// a result stays valid after it has been evicted. Least recently used
+// results go first once the byte budget is exceeded; a result larger than
+// the whole budget is returned but not kept. Sizes come from memoBytes(),
+// which knows Matrix<T>; overload it for result types that own memory.
+//
+// Thread-safe. The computation runs outside the lock, so two threads missing
+// on the same key at once both compute it, and the first to finish is kept.
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <typeindex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Kernels.h"
+#include "Matrix.h"
+#include "Trace.h"
+
+struct MemoKey
+{
+    uint64_t content = 0;       // contentHash() of the input, or a combination of several
+    std::string operation;      // what was done to it
+    uint64_t params = 0;        // hashParams() of the operation's arguments
+
+    bool operator==(const MemoKey& other) const
+    {
+        return content == other.content && params == other.params && operation == other.operation;
+    }
+    bool operator!=(const MemoKey& other) const { return !(*this == other); }
+};
+
+namespace memo_detail
+{
+    inline uint64_t hashValue(std::string_view s)
+    {
+        return kernels().hashBytes(reinterpret_cast<const uint8_t*>(s.data()), s.size(), 0);
+    }
+    inline uint64_t hashValue(const std::string& s) { return hashValue(std::string_view(s)); }
+    // the characters, not the pointer: "abc" hashes like std::string("abc") wherever it lives
+    inline uint64_t hashValue(const char* s) { return hashValue(std::string_view(s)); }
+
+    template<typename T>
+    uint64_t hashValue(const T& value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "hashParams takes plain values and strings");
+        return kernels().hashBytes(reinterpret_cast<const uint8_t*>(&value), sizeof value, 0);
+    }
+
+    struct KeyHash
+    {
+        size_t operator()(const MemoKey& key) const
+        {
+            return static_cast<size_t>(kernels_detail::mix64(key.content ^ kernels_detail::mix64(key.params)) ^
+                                       std::hash<std::string>()(key.operation));
+        }
+    };
+}
+
+// one hash for any number of parameters; the order matters, hashParams(1, 2) != hashParams(2, 1)
+template<typename... Args>
+uint64_t hashParams(const Args&... args)
+{
+    uint64_t h = 0;
+    ((h = kernels_detail::mix64(h ^ memo_detail::hashValue(args)) + 0x9e3779b97f4a7c15ull), ...);
+    return h;
+}
+
+// bytes a cached result accounts for
+template<typename R>
+size_t memoBytes(const R&)
+{
+    return sizeof(R);
+}
+
+template<typename T>
+size_t memoBytes(const Matrix<T>& mat)
+{
+    return sizeof mat + mat.numElements()*sizeof(T);
+}
+
+// (the generic overload would otherwise be the better match for the derived class)
+inline size_t memoBytes(const Image& img)
+{
+    return memoBytes<Color>(img);
+}
+
+template<typename T>
+size_t memoBytes(const std::vector<T>& v)
+{
+    return sizeof v + v.capacity()*sizeof(T);
+}
+
+class MemoCache
+{
+public:
+    struct Stats
+    {
+        uint64_t hits = 0, misses = 0, evictions = 0;
+        size_t entries = 0, bytes = 0;
+
+        double hitRate() const { return hits + misses == 0 ? 0.0 : double(hits)/double(hits + misses); }
+    };
+
+    explicit MemoCache(size_t byteBudget) : budget(byteBudget) { }
+
+    MemoCache(const MemoCache&) = delete;
+    void operator=(const MemoCache&) = delete;
+
+    // the cached result for key, or compute() (which returns an R) stored under it
+    template<typename R, typename FUNC>
+    std::shared_ptr<const R> get(const MemoKey& key, FUNC&& compute)
+    {
+        if(auto found = find<R>(key)) return found;
+        std::shared_ptr<const R> result;
+        {
+            TRACE_SPAN("MemoCache compute");
+            result = std::make_shared<const R>(compute());
+        }
+        return insert(key, std::move(result));
+    }
+
+    // the cached result, or null; counts as a hit or a miss
+    template<typename R>
+    std::shared_ptr<const R> find(const MemoKey& key)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(key);
+        if(it == index.end())
+        {
+            ++counters.misses;
+            return nullptr;
+        }
+        Entry& e = *it->second;
+        if(e.type != std::type_index(typeid(R)))
+            throw std::invalid_argument("MemoCache: \"" + key.operation + "\" is cached with a different result type");
+        ++counters.hits;
+        lru.splice(lru.begin(), lru, it->second);
+        return std::static_pointer_cast<const R>(e.value);
+    }
+
+    // stores value under key unless it is already there; returns the cached one
+    template<typename R>
+    std::shared_ptr<const R> insert(const MemoKey& key, std::shared_ptr<const R> value)
+    {
+        const size_t bytes = memoBytes(*value);
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(key);
+        if(it != index.end())
+        {
+            // another thread got there first
+            if(it->second->type == std::type_index(typeid(R))) return std::static_pointer_cast<const R>(it->second->value);
+            throw std::invalid_argument("MemoCache: \"" + key.operation + "\" is cached with a different result type");
+        }
+        if(bytes > budget) return value;
+        lru.push_front(Entry{key, value, std::type_index(typeid(R)), bytes});
+        index.emplace(key, lru.begin());
+        counters.bytes += bytes;
+        evictToBudget();
+        return value;
+    }
+
+    void setBudget(size_t byteBudget)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        budget = byteBudget;
+        evictToBudget();
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        index.clear();
+        lru.clear();
+        counters.bytes = 0;
+    }
+
+    Stats stats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Stats s = counters;
+        s.entries = lru.size();
+        return s;
+    }
+
+    void resetStats()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        counters.hits = counters.misses = counters.evictions = 0;
+    }
+
+private:
+    struct Entry
+    {
+        MemoKey key;
+        std::shared_ptr<const void> value;
+        std::type_index type;
+        size_t bytes;
+    };
+
+    mutable std::mutex mutex;
+    size_t budget;
+    std::list<Entry> lru;               // front = most recently used
+    std::unordered_map<MemoKey, std::list<Entry>::iterator, memo_detail::KeyHash> index;
+    Stats counters;
+
+    void evictToBudget()
+    {
+        while(counters.bytes > budget && !lru.empty())
+        {
+            const Entry& victim = lru.back();
+            counters.bytes -= victim.bytes;
+            index.erase(victim.key);
+            lru.pop_back();
+            ++counters.evictions;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,310 @@
+#ifndef __MortonMatrix_h
+#define __MortonMatrix_h
+
+// Z-order (Morton) tiled storage: the matrix is cut into square tiles of
+// 2^LOG_TILE elements a side, stored one after the other (row-major over
+// tiles), and the elements inside a tile follow the Z curve, so both the
+// row and the column neighbours of an element are a few cache lines away,
+// not a whole image row. By default a tile is the largest one that fits a
+// 4 KB page (64x64 uint8_t, 32x32 Color or float), so a neighbourhood walk
+// touches one or two pages instead of one per row.
+//
+//     MortonImage z(img);                     // from row-major
+//     z(row, col) = Color(255);               // same (row, col) access as Matrix
+//     Matrix<Color> back = z.toRowMajor();
+//
+//     size_t m = z.index(row, col);           // storage offset of an element
+//     z.mem()[morton::addX<5>(m, 1)]          // the right neighbour, if it is in the same tile
+//
+// The dimensions are padded to whole tiles, which costs at most one tile
+// row and column of memory.
+//
+// Coordinates interleave as col -> even bits, row -> odd bits. morton::encode
+// and decode use BMI2 pdep/pext where the CPU has it, picked at run time
+// like the kernels in Kernels.h (always, in builds targeting BMI2), and
+// shift-and-mask otherwise. That is a call per code, so for a loop over
+// many of them, use encodeBmi2/decodeBmi2 after checking morton::hasBmi2(),
+// from a function that is itself target("bmi2") so they inline; spread and
+// compact vectorize, and beat the call (bench/morton_layout.cpp).
+// MortonMatrix looks up tiles up to 256x256 in a table, and encodes bigger
+// ones with morton::encode.
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#endif
+
+#include "CpuFeatures.h"
+#include "Matrix.h"
+#include "Trace.h"
+
+namespace morton
+{
+    constexpr uint32_t EVEN_BITS = 0x55555555u, ODD_BITS = 0xaaaaaaaau;
+
+    // 0b0000abcd -> 0b0a0b0c0d, for the low 16 bits
+    constexpr uint32_t spread(uint32_t x)
+    {
+        x &= 0xffff;
+        x = (x | (x << 8)) & 0x00ff00ffu;
+        x = (x | (x << 4)) & 0x0f0f0f0fu;
+        x = (x | (x << 2)) & 0x33333333u;
+        x = (x | (x << 1)) & 0x55555555u;
+        return x;
+    }
+
+    // the inverse: every other bit, starting at bit 0
+    constexpr uint32_t compact(uint32_t x)
+    {
+        x &= 0x55555555u;
+        x = (x | (x >> 1)) & 0x33333333u;
+        x = (x | (x >> 2)) & 0x0f0f0f0fu;
+        x = (x | (x >> 4)) & 0x00ff00ffu;
+        x = (x | (x >> 8)) & 0x0000ffffu;
+        return x;
+    }
+
+    // spread() of every byte, for in-tile coordinates: two loads and an OR
+    inline constexpr struct SpreadTable
+    {
+        uint16_t bits[256];
+        constexpr SpreadTable() : bits{}
+        {
+            for(uint32_t i = 0; i < 256; ++i) bits[i] = static_cast<uint16_t>(spread(i));
+        }
+    } spreadTable;
+
+    // The kernels' AVX2 level and up require BMI2 (cpu::detectIsa), so this
+    // follows the same choice, MATRIX_ISA overrides included.
+    inline bool hasBmi2()
+    {
+        return cpu::activeIsa() >= cpu::Isa::AVX2;
+    }
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __attribute__((target("bmi2"))) inline uint32_t encodeBmi2(uint32_t col, uint32_t row)
+    {
+        return _pdep_u32(col, EVEN_BITS) | _pdep_u32(row, ODD_BITS);
+    }
+
+    __attribute__((target("bmi2"))) inline void decodeBmi2(uint32_t m, uint32_t& col, uint32_t& row)
+    {
+        col = _pext_u32(m, EVEN_BITS);
+        row = _pext_u32(m, ODD_BITS);
+    }
+#define MATRIX_HAS_MORTON_BMI2 1
+#endif
+
+    inline uint32_t encode(uint32_t col, uint32_t row)
+    {
+#if defined(__BMI2__)
+        return _pdep_u32(col, EVEN_BITS) | _pdep_u32(row, ODD_BITS);
+#else
+#ifdef MATRIX_HAS_MORTON_BMI2
+        static const bool bmi2 = hasBmi2();
+        if(bmi2) return encodeBmi2(col, row);
+#endif
+        return spread(col) | (spread(row) << 1);
+#endif
+    }
+
+    inline void decode(uint32_t m, uint32_t& col, uint32_t& row)
+    {
+#if defined(__BMI2__)
+        col = _pext_u32(m, EVEN_BITS);
+        row = _pext_u32(m, ODD_BITS);
+#else
+#ifdef MATRIX_HAS_MORTON_BMI2
+        static const bool bmi2 = hasBmi2();
+        if(bmi2) return decodeBmi2(m, col, row);
+#endif
+        col = compact(m);
+        row = compact(m >> 1);
+#endif
+    }
+
+    // Steps a Z index by dx columns (or dy rows) without decoding it. Only the low
+    // 2*LOG bits change, so a step off the edge wraps around inside the tile; the
+    // bits above them (the tile number, for MortonMatrix::index) are kept.
+    template<int LOG>
+    constexpr size_t addX(size_t m, int dx)
+    {
+        constexpr size_t X = EVEN_BITS & ((size_t(1) << 2*LOG) - 1);
+        return (((m | ~X) + spread(static_cast<uint32_t>(dx))) & X) | (m & ~X);
+    }
+
+    template<int LOG>
+    constexpr size_t addY(size_t m, int dy)
+    {
+        constexpr size_t Y = ODD_BITS & ((size_t(1) << 2*LOG) - 1);
+        return (((m | ~Y) + (size_t(spread(static_cast<uint32_t>(dy))) << 1)) & Y) | (m & ~Y);
+    }
+
+    // the largest square tile of T that fits in a 4 KB page
+    template<typename T>
+    constexpr int defaultLogTile()
+    {
+        int log = 0;
+        while(log < 8 && (size_t(1) << 2*(log + 1))*sizeof(T) <= 4096) ++log;
+        return log;
+    }
+}
+
+template<typename T, int LOG_TILE = morton::defaultLogTile<T>()>
+class MortonMatrix : public MatrixCore
+{
+    static_assert(LOG_TILE >= 1 && LOG_TILE <= 15, "tile side must be 2^1 .. 2^15");
+
+public:
+    static constexpr int TILE = 1 << LOG_TILE;
+    static constexpr size_t TILE_ELEMS = size_t(1) << 2*LOG_TILE;
+
+    int nRows = 0, nCols = 0;
+
+    MortonMatrix() = default;
+
+    MortonMatrix(int nRows, int nCols)
+        : nRows(nRows), nCols(nCols), tilesPerRow((nCols + TILE - 1)/TILE), tilesPerCol((nRows + TILE - 1)/TILE),
+          data(static_cast<size_t>(tilesPerRow)*tilesPerCol*TILE_ELEMS)
+    {
+        TRACE_SPAN("MortonMatrix::MortonMatrix");
+    }
+
+    explicit MortonMatrix(const Matrix<T>& src) : MortonMatrix(src.nRows, src.nCols)
+    {
+        fromRowMajor(src);
+    }
+
+    size_t numElements() const { return static_cast<size_t>(nRows)*nCols; }
+    size_t storedElements() const { return data.size(); }
+    int numTileRows() const { return tilesPerCol; }
+    int numTileCols() const { return tilesPerRow; }
+
+    // offset of (row, col) in mem()
+    size_t index(int row, int col) const
+    {
+        const size_t tile = static_cast<size_t>(row >> LOG_TILE)*tilesPerRow + (col >> LOG_TILE);
+        return (tile << 2*LOG_TILE) | inTile(col & (TILE - 1), row & (TILE - 1));
+    }
+
+    T& operator()(int row, int col) { return data[index(row, col)]; }
+    const T& operator()(int row, int col) const { return data[index(row, col)]; }
+
+    T& at(int row, int col)
+    {
+        if(row < 0 || row >= nRows || col < 0 || col >= nCols)
+            throw std::out_of_range("MortonMatrix index (" + std::to_string(row) + ", " + std::to_string(col) +
+                                    ") out of range");
+        return (*this)(row, col);
+    }
+
+    T* mem() { return data.data(); }
+    const T* mem() const { return data.data(); }
+
+    // first element of tile (tileRow, tileCol); its TILE_ELEMS elements follow in Z order
+    T* tile(int tileRow, int tileCol) { return data.data() + (static_cast<size_t>(tileRow)*tilesPerRow + tileCol)*TILE_ELEMS; }
+    const T* tile(int tileRow, int tileCol) const
+    {
+        return data.data() + (static_cast<size_t>(tileRow)*tilesPerRow + tileCol)*TILE_ELEMS;
+    }
+
+    // Both conversions go a tile at a time: TILE source rows are live at once, and the
+    // Z offsets of a tile row are a table lookup plus one OR per element.
+    void fromRowMajor(const Matrix<T>& src)
+    {
+        TRACE_SPAN("MortonMatrix::fromRowMajor");
+        if(src.nRows != nRows || src.nCols != nCols) *this = MortonMatrix(src.nRows, src.nCols);
+        forEachTileRow(*this, [&](T* tileBase, const uint32_t* colBits, uint32_t rowBits, int row, int col0, int cols) {
+            const T* s = src.mem + static_cast<size_t>(row)*nCols + col0;
+            for(int x = 0; x < cols; ++x) tileBase[colBits[x] | rowBits] = s[x];
+        });
+    }
+
+    void toRowMajor(Matrix<T>& dst) const
+    {
+        TRACE_SPAN("MortonMatrix::toRowMajor");
+        if(dst.nRows != nRows || dst.nCols != nCols || !dst.mem) dst.init(nRows, nCols);
+        forEachTileRow(*this, [&](const T* tileBase, const uint32_t* colBits, uint32_t rowBits, int row, int col0, int cols) {
+            T* d = dst.mem + static_cast<size_t>(row)*nCols + col0;
+            for(int x = 0; x < cols; ++x) d[x] = tileBase[colBits[x] | rowBits];
+        });
+    }
+
+    Matrix<T> toRowMajor() const
+    {
+        Matrix<T> out;
+        toRowMajor(out);
+        return out;
+    }
+
+    // Tile (tileRow, tileCol) plus `apron` elements on every side, row-major into dst
+    // ((TILE + 2*apron)^2 elements), replicating the edge outside the matrix. A
+    // neighbourhood kernel can then run its ordinary row-major loops one tile at a time.
+    void readTile(int tileRow, int tileCol, int apron, T* dst) const
+    {
+        const int side = TILE + 2*apron, row0 = tileRow*TILE - apron, col0 = tileCol*TILE - apron;
+        for(int y = 0; y < side; ++y)
+        {
+            const int r = std::clamp(row0 + y, 0, nRows - 1);
+            for(int x = 0; x < side; ++x) *dst++ = (*this)(r, std::clamp(col0 + x, 0, nCols - 1));
+        }
+    }
+
+    // a row-major TILE x TILE block back into tile (tileRow, tileCol); padding included
+    void writeTile(int tileRow, int tileCol, const T* src)
+    {
+        T* base = tile(tileRow, tileCol);
+        for(int y = 0; y < TILE; ++y)
+        {
+            const uint32_t rowBits = inTile(0, y);
+            for(int x = 0; x < TILE; ++x) base[rowBits | inTile(x, 0)] = src[y*TILE + x];
+        }
+    }
+
+    void load() override
+    {
+        std::cout << "MortonMatrix loaded! (" << tilesPerCol << "x" << tilesPerRow << " tiles of " << TILE << "x"
+                  << TILE << ")" << std::endl;
+    }
+
+private:
+    int tilesPerRow = 0, tilesPerCol = 0;
+    std::vector<T> data;
+
+    static uint32_t inTile(uint32_t col, uint32_t row)
+    {
+        if constexpr(LOG_TILE <= 8)
+            return morton::spreadTable.bits[col] | uint32_t(morton::spreadTable.bits[row]) << 1;
+        else
+            return morton::encode(col, row);
+    }
+
+    // func(tile base, Z bits of each column, Z bits of the row, row, first column, columns) per tile row
+    template<typename Self, typename FUNC>
+    static void forEachTileRow(Self& self, FUNC&& func)
+    {
+        uint32_t colBits[TILE];
+        for(int x = 0; x < TILE; ++x) colBits[x] = morton::spread(x);
+        for(int tr = 0; tr < self.tilesPerCol; ++tr)
+            for(int tc = 0; tc < self.tilesPerRow; ++tc)
+            {
+                auto* base = self.tile(tr, tc);
+                const int rows = std::min(TILE, self.nRows - tr*TILE), cols = std::min(TILE, self.nCols - tc*TILE);
+                for(int y = 0; y < rows; ++y)
+                    func(base, colBits, morton::spread(y) << 1, tr*TILE + y, tc*TILE, cols);
+            }
+    }
+};
+
+using MortonImage = MortonMatrix<Color>;
+
+#undef MATRIX_HAS_MORTON_BMI2
+
+#endif
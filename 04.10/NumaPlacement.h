@@ -0,0 +1,243 @@
+#ifndef __NumaPlacement_h
+#define __NumaPlacement_h
+
+// NUMA placement for big matrices. A Matrix that gets new T[] and is zeroed
+// by one thread ends up on that thread's node, and every other socket then
+// reads it over the interconnect. A numa::Placement is a MatrixAllocator
+// that puts the pages somewhere deliberate:
+//
+//   Interleaved   pages round-robin over all nodes: even bandwidth for data
+//                 every thread reads all of (lookup tables, the B of a GEMM)
+//   RowBands      row band t of nThreads on node t*nodes/nThreads, the split
+//                 integral_detail::parallelBands uses, so a kernel parallel
+//                 over row bands reads its own band locally
+//   Local         the node of the thread allocating it
+//
+//     Matrix<float> a(rows, cols, numa::rowBands());
+//     integral_detail::parallelBands(rows, nThreads, [&](int r0, int r1) {
+//         numa::rowBands().bindThread(r0, rows);  // run next to the band
+//         ...
+//     });
+//
+// In every case the zeros are written in parallel, one thread per band, so
+// initializing a big matrix also stops being single-threaded.
+//
+// libnuma is used when the build found it (MATRIX_HAVE_LIBNUMA, set by
+// CMake) and the kernel supports NUMA. Without it the policies degrade to
+// first touch, which is where the default kernel policy places a page:
+// each band is zeroed by its own thread, and a Local matrix entirely by the
+// allocating one. Without a multi-socket machine, try it in a multi-node VM
+// (qemu -numa) or under numactl.
+
+#include <algorithm>
+#include <functional>
+#include <new>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+#include "Matrix.h"
+
+#if MATRIX_HAVE_LIBNUMA
+#include <numa.h>
+#include <sched.h>
+#endif
+
+namespace numa
+{
+    enum class Policy { Interleaved, RowBands, Local };
+
+    inline bool available()
+    {
+#if MATRIX_HAVE_LIBNUMA
+        static const bool yes = numa_available() >= 0;
+        return yes;
+#else
+        return false;
+#endif
+    }
+
+    inline int nodeCount()
+    {
+#if MATRIX_HAVE_LIBNUMA
+        if(available()) return std::max(numa_num_configured_nodes(), 1);
+#endif
+        return 1;
+    }
+
+    // the node the calling thread runs on, 0 without libnuma
+    inline int currentNode()
+    {
+#if MATRIX_HAVE_LIBNUMA
+        if(available())
+        {
+            const int cpu = sched_getcpu();
+            if(cpu >= 0) return std::max(numa_node_of_cpu(cpu), 0);
+        }
+#endif
+        return 0;
+    }
+
+    // The node of every page in [p, p + bytes), -1 for pages not backed yet.
+    // Without libnuma the pages are taken to be on node 0.
+    inline std::vector<int> pageNodes(const void* p, size_t bytes)
+    {
+        const uintptr_t page = 4096;
+        const uintptr_t first = reinterpret_cast<uintptr_t>(p) & ~(page - 1);
+        const uintptr_t last = reinterpret_cast<uintptr_t>(p) + bytes;
+        std::vector<int> nodes(bytes == 0 ? 0 : (last - first + page - 1)/page, 0);
+#if MATRIX_HAVE_LIBNUMA
+        if(available() && !nodes.empty())
+        {
+            std::vector<void*> pages(nodes.size());
+            for(size_t i = 0; i < pages.size(); ++i) pages[i] = reinterpret_cast<void*>(first + i*page);
+            // with no target nodes move_pages only reports where each page is
+            if(numa_move_pages(0, pages.size(), pages.data(), nullptr, nodes.data(), 0) != 0)
+                std::fill(nodes.begin(), nodes.end(), -1);
+            for(int& n : nodes) n = n < 0 ? -1 : n;
+        }
+#endif
+        return nodes;
+    }
+
+    class Placement : public MatrixAllocator
+    {
+    public:
+        explicit Placement(Policy policy, int nThreads = static_cast<int>(std::thread::hardware_concurrency()))
+            : pol(policy), nThreads(std::max(nThreads, 1))
+        {
+        }
+
+        Policy policy() const { return pol; }
+        int threads() const { return nThreads; }
+
+        // bands a matrix of `rows` rows is split into: as in parallelBands, no band under 64 rows
+        int bands(size_t rows) const { return static_cast<int>(std::max<size_t>(1, std::min<size_t>(nThreads, rows/64))); }
+        int nodeOfBand(int band, int nBands) const { return static_cast<int>(static_cast<int64_t>(band)*nodeCount()/nBands); }
+
+        // Moves the calling thread onto the node that holds the band starting
+        // at row0, for the threads of the kernels working on the matrix. Only
+        // RowBands has a node per band; a no-op otherwise and without libnuma.
+        void bindThread(size_t row0, size_t rows) const
+        {
+            const int n = bands(rows);
+            // the last band whose first row, rows*band/n, is not past row0
+            const size_t band = (n*(row0 + 1) - 1)/std::max<size_t>(rows, 1);
+            bindToBand(static_cast<int>(std::min<size_t>(band, n - 1)), n);
+        }
+
+        void* allocate(size_t rows, size_t rowBytes) const override
+        {
+            const size_t bytes = rows*rowBytes;
+#if MATRIX_HAVE_LIBNUMA
+            if(available())
+            {
+                void* p = nullptr;
+                switch(pol)
+                {
+                case Policy::Interleaved: p = numa_alloc_interleaved(bytes); break;
+                case Policy::Local: p = numa_alloc_onnode(bytes, currentNode()); break;
+                case Policy::RowBands:
+                    p = numa_alloc(bytes);
+                    if(p) bindBands(static_cast<char*>(p), rows, rowBytes);
+                    break;
+                }
+                if(!p) throw std::bad_alloc();
+                return p;
+            }
+#endif
+            // page aligned, and big enough that malloc maps it fresh: nothing is touched yet
+            return ::operator new(bytes, std::align_val_t(PAGE));
+        }
+
+        void deallocate(void* p, size_t bytes) const override
+        {
+#if MATRIX_HAVE_LIBNUMA
+            if(available())
+            {
+                numa_free(p, bytes);
+                return;
+            }
+#endif
+            (void)bytes;
+            ::operator delete(p, std::align_val_t(PAGE));
+        }
+
+        // one thread per band, each on the band's node for RowBands. Without
+        // libnuma, Local has nothing but the touching thread to go by: just this one.
+        void firstTouch(size_t rows, const std::function<void(size_t, size_t)>& init) const override
+        {
+            const int n = pol == Policy::Local && !available() ? 1 : bands(rows);
+            auto touch = [&](int band) {
+                bindToBand(band, n);
+                init(rows*band/n, rows*(band + 1)/n);
+            };
+            std::vector<std::thread> threads;
+            try
+            {
+                for(int t = 1; t < n; ++t) threads.emplace_back(touch, t);
+                // the calling thread does band 0 and keeps where it runs
+                init(0, rows/n);
+            }
+            catch(...)
+            {
+                // the bands already started still write to the memory the caller is about to free
+                for(auto& th : threads) th.join();
+                throw;
+            }
+            for(auto& th : threads) th.join();
+        }
+
+    private:
+        static constexpr size_t PAGE = 4096;
+
+        Policy pol;
+        int nThreads;
+
+        void bindToBand(int band, int nBands) const
+        {
+#if MATRIX_HAVE_LIBNUMA
+            if(available() && pol == Policy::RowBands) numa_run_on_node(nodeOfBand(band, nBands));
+#else
+            (void)band;
+            (void)nBands;
+#endif
+        }
+
+#if MATRIX_HAVE_LIBNUMA
+        // each band's pages to its node; a page shared by two bands goes with the first
+        void bindBands(char* p, size_t rows, size_t rowBytes) const
+        {
+            const int n = bands(rows);
+            const size_t total = (rows*rowBytes + PAGE - 1)/PAGE*PAGE;
+            auto pageStart = [&](int band) { return band == n ? total : (rows*band/n*rowBytes + PAGE - 1)/PAGE*PAGE; };
+            for(int band = 0; band < n; ++band)
+            {
+                const size_t from = pageStart(band), to = pageStart(band + 1);
+                if(to > from) numa_tonode_memory(p + from, to - from, nodeOfBand(band, n));
+            }
+        }
+#endif
+    };
+
+    // shared instances with one band per hardware thread
+    inline const Placement& interleaved()
+    {
+        static const Placement p(Policy::Interleaved);
+        return p;
+    }
+
+    inline const Placement& rowBands()
+    {
+        static const Placement p(Policy::RowBands);
+        return p;
+    }
+
+    inline const Placement& local()
+    {
+        static const Placement p(Policy::Local);
+        return p;
+    }
+}
+
+#endif
@@ -0,0 +1,192 @@
+#ifndef __PackedTuple_h
+#define __PackedTuple_h
+
+// A tuple that stores its members sorted by alignment (largest first), so
+// the only padding left is at the end. Access stays in declaration order:
+//
+//     PackedTuple<char, double, int, char> rec{'a', 2.5, 7, 'z'};
+//     double d = get<1>(rec);                 // 2.5, whatever slot it lives in
+//     int i = get<int>(rec);                  // by type, when the type is unique
+//     auto [c, x, n, tag] = rec;              // structured bindings
+//
+//     sizeof(std::tuple<char, double, int, char>)  // 24
+//     sizeof(PackedTuple<char, double, int, char>) // 16
+//
+// (03.13's PairV002::Pair inherits std::tuple, which lays members out in
+// declaration order, or reversed, depending on the library.)
+//
+// Empty members (tags, stateless allocators, comparators) are stored as
+// base classes, so they take no space at all.
+//
+// The sort is stable, so members with the same alignment keep their order.
+
+#include <array>
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace packed_tuple_detail
+{
+    template<size_t I, typename... Ts>
+    using TypeAt = std::tuple_element_t<I, std::tuple<Ts...>>;
+
+    template<typename... Ts>
+    struct Layout
+    {
+        static constexpr size_t N = sizeof...(Ts);
+
+        // order[slot] = declaration index of the member stored in that slot
+        static constexpr std::array<size_t, N> order = [] {
+            constexpr size_t aligns[N + 1] = {alignof(Ts)..., 0};
+            std::array<size_t, N> o{};
+            for(size_t i = 0; i < N; ++i) o[i] = i;
+            // insertion sort, stable, by decreasing alignment
+            for(size_t i = 1; i < N; ++i)
+                for(size_t j = i; j > 0 && aligns[o[j - 1]] < aligns[o[j]]; --j)
+                {
+                    size_t t = o[j];
+                    o[j] = o[j - 1];
+                    o[j - 1] = t;
+                }
+            return o;
+        }();
+
+        // slotOf[declaration index] = slot
+        static constexpr std::array<size_t, N> slotOf = [] {
+            std::array<size_t, N> s{};
+            for(size_t slot = 0; slot < N; ++slot) s[order[slot]] = slot;
+            return s;
+        }();
+    };
+
+    // one member; empty classes are inherited instead, so they add no bytes
+    template<size_t Slot, typename T, bool Empty = std::is_empty<T>::value && !std::is_final<T>::value>
+    struct Leaf
+    {
+        T value;
+
+        constexpr Leaf() : value() { }
+        template<typename U>
+        constexpr explicit Leaf(U&& u) : value(std::forward<U>(u)) { }
+
+        constexpr T& ref() { return value; }
+        constexpr const T& ref() const { return value; }
+    };
+
+    template<size_t Slot, typename T>
+    struct Leaf<Slot, T, true> : T
+    {
+        constexpr Leaf() : T() { }
+        template<typename U>
+        constexpr explicit Leaf(U&& u) : T(std::forward<U>(u)) { }
+
+        constexpr T& ref() { return *this; }
+        constexpr const T& ref() const { return *this; }
+    };
+
+    template<typename Slots, typename... Ts>
+    struct Storage;
+
+    // the leaves are bases in slot order, i.e. sorted by alignment
+    template<size_t... Slots, typename... Ts>
+    struct Storage<std::index_sequence<Slots...>, Ts...>
+        : Leaf<Slots, TypeAt<Layout<Ts...>::order[Slots], Ts...>>...
+    {
+        constexpr Storage() = default;
+
+        // `args` is a tuple of references in declaration order
+        template<typename Args>
+        constexpr explicit Storage(Args&& args)
+            : Leaf<Slots, TypeAt<Layout<Ts...>::order[Slots], Ts...>>(
+                  std::get<Layout<Ts...>::order[Slots]>(std::forward<Args>(args)))...
+        {
+        }
+    };
+
+    template<typename T, typename... Ts>
+    constexpr size_t indexOfType()
+    {
+        constexpr bool same[sizeof...(Ts) + 1] = {std::is_same<T, Ts>::value..., false};
+        size_t found = sizeof...(Ts), count = 0;
+        for(size_t i = 0; i < sizeof...(Ts); ++i)
+            if(same[i])
+            {
+                found = i;
+                ++count;
+            }
+        return count == 1 ? found : sizeof...(Ts);
+    }
+}
+
+template<typename... Ts>
+class PackedTuple : public packed_tuple_detail::Storage<std::index_sequence_for<Ts...>, Ts...>
+{
+    using Base = packed_tuple_detail::Storage<std::index_sequence_for<Ts...>, Ts...>;
+
+public:
+    constexpr PackedTuple() = default;
+
+    // members in declaration order, as for std::tuple
+    template<bool NotEmpty = (sizeof...(Ts) > 0), typename = std::enable_if_t<NotEmpty>>
+    constexpr PackedTuple(Ts... args) : Base(std::forward_as_tuple(std::move(args)...))
+    {
+    }
+};
+
+template<typename... Ts>
+PackedTuple(Ts...) -> PackedTuple<Ts...>;
+
+template<size_t I, typename... Ts>
+constexpr packed_tuple_detail::TypeAt<I, Ts...>& get(PackedTuple<Ts...>& t)
+{
+    using namespace packed_tuple_detail;
+    return static_cast<Leaf<Layout<Ts...>::slotOf[I], TypeAt<I, Ts...>>&>(t).ref();
+}
+
+template<size_t I, typename... Ts>
+constexpr const packed_tuple_detail::TypeAt<I, Ts...>& get(const PackedTuple<Ts...>& t)
+{
+    using namespace packed_tuple_detail;
+    return static_cast<const Leaf<Layout<Ts...>::slotOf[I], TypeAt<I, Ts...>>&>(t).ref();
+}
+
+template<size_t I, typename... Ts>
+constexpr packed_tuple_detail::TypeAt<I, Ts...>&& get(PackedTuple<Ts...>&& t)
+{
+    return std::move(get<I>(t));
+}
+
+template<typename T, typename... Ts>
+constexpr T& get(PackedTuple<Ts...>& t)
+{
+    constexpr size_t i = packed_tuple_detail::indexOfType<T, Ts...>();
+    static_assert(i < sizeof...(Ts), "get<T>: T must appear exactly once");
+    return get<i>(t);
+}
+
+template<typename T, typename... Ts>
+constexpr const T& get(const PackedTuple<Ts...>& t)
+{
+    constexpr size_t i = packed_tuple_detail::indexOfType<T, Ts...>();
+    static_assert(i < sizeof...(Ts), "get<T>: T must appear exactly once");
+    return get<i>(t);
+}
+
+template<typename T, typename... Ts>
+constexpr T&& get(PackedTuple<Ts...>&& t)
+{
+    return std::move(get<T>(t));
+}
+
+// structured bindings
+namespace std
+{
+    template<typename... Ts>
+    struct tuple_size<PackedTuple<Ts...>> : std::integral_constant<size_t, sizeof...(Ts)> { };
+
+    template<size_t I, typename... Ts>
+    struct tuple_element<I, PackedTuple<Ts...>> { using type = packed_tuple_detail::TypeAt<I, Ts...>; };
+}
+
+#endif
@@ -0,0 +1,193 @@
+#ifndef __Quantized_h
+#define __Quantized_h
+
+// 8-bit quantized matrices and their multiply, for inference-style work:
+// weights take a quarter of the float footprint and the products run on
+// the int8 dot-product instructions (see matmulU8S8 in Kernels.h).
+//
+//     auto w = quantize<int8_t>(weights, Granularity::PerRow);      // m x k, one row per output
+//     auto x = quantize<uint8_t>(activations, Granularity::PerTensor); // n x k
+//     Matrix<float> y;
+//     multiply(x, w, y);                      // y = x * w^T, n x m
+//
+//     QuantizedMatrix<uint8_t> yq;
+//     multiply(x, w, QuantParams{0.05f, 128}, yq);   // requantized for the next layer
+//
+// A value q stands for scale*(q - zeroPoint). int8 matrices are quantized
+// symmetrically (zero point 0), uint8 ones asymmetrically over [min, max]
+// (the range always includes 0, so 0 is exact). The products accumulate in
+// exact int32; zero points are folded in afterwards from row sums, so the
+// only errors are the rounding of the inputs (at most half a step each) and
+// of the requantized output.
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <stdint.h>
+#include <type_traits>
+#include <vector>
+
+#include "Kernels.h"
+#include "Matrix.h"
+#include "Trace.h"
+
+struct QuantParams
+{
+    float scale = 1.f;
+    int32_t zeroPoint = 0;
+};
+
+enum class Granularity { PerTensor, PerRow };
+
+template<typename Q>
+struct QuantizedMatrix
+{
+    static_assert(std::is_same<Q, int8_t>::value || std::is_same<Q, uint8_t>::value, "8-bit elements only");
+
+    Matrix<Q> values;
+    std::vector<QuantParams> params;    // one per row, or a single one for the whole matrix
+
+    const QuantParams& rowParams(int i) const { return params.size() == 1 ? params[0] : params[i]; }
+    size_t bytes() const { return values.numElements()*sizeof(Q) + params.size()*sizeof(QuantParams); }
+};
+
+namespace quantized_detail
+{
+    template<typename Q>
+    QuantParams chooseParams(const float* first, const float* last)
+    {
+        constexpr int qmin = std::numeric_limits<Q>::min(), qmax = std::numeric_limits<Q>::max();
+        float lo = 0.f, hi = 0.f;
+        for(const float* p = first; p != last; ++p)
+        {
+            lo = std::min(lo, *p);
+            hi = std::max(hi, *p);
+        }
+        if constexpr(std::is_signed<Q>::value)
+        {
+            const float range = std::max(-lo, hi);
+            return {range > 0 ? range/qmax : 1.f, 0};
+        }
+        else
+        {
+            if(hi == lo) return {1.f, 0};
+            const float scale = (hi - lo)/(qmax - qmin);
+            const long zero = std::lround(qmin - lo/scale);
+            return {scale, static_cast<int32_t>(std::clamp<long>(zero, qmin, qmax))};
+        }
+    }
+
+    template<typename Q>
+    Q quantizeOne(float x, float invScale, int32_t zeroPoint)
+    {
+        const long q = std::lround(x*invScale) + zeroPoint;
+        return static_cast<Q>(std::clamp<long>(q, std::numeric_limits<Q>::min(), std::numeric_limits<Q>::max()));
+    }
+
+    template<typename Q>
+    std::vector<int32_t> rowSums(const Matrix<Q>& m)
+    {
+        std::vector<int32_t> sums(m.nRows);
+        for(int i = 0; i < m.nRows; ++i)
+        {
+            int32_t s = 0;
+            for(Q q : m.row(i)) s += q;
+            sums[i] = s;
+        }
+        return sums;
+    }
+
+    // acc(i, j) with both zero points taken out, times the two scales: the real-valued product
+    template<typename FUNC>
+    void forEachProduct(const QuantizedMatrix<uint8_t>& a, const QuantizedMatrix<int8_t>& wt, const Matrix<int32_t>& acc,
+                        FUNC&& func)
+    {
+        const std::vector<int32_t> aSums = rowSums(a.values), wSums = rowSums(wt.values);
+        const int64_t k = a.values.nCols;
+        for(int i = 0; i < acc.nRows; ++i)
+        {
+            const QuantParams& pa = a.rowParams(i);
+            for(int j = 0; j < acc.nCols; ++j)
+            {
+                const QuantParams& pw = wt.rowParams(j);
+                const int64_t centred = acc.unchecked(i, j) - int64_t(pa.zeroPoint)*wSums[j] -
+                                        int64_t(pw.zeroPoint)*aSums[i] + k*pa.zeroPoint*pw.zeroPoint;
+                func(i, j, pa.scale*pw.scale*static_cast<float>(centred));
+            }
+        }
+    }
+
+    inline void accumulate(const QuantizedMatrix<uint8_t>& a, const QuantizedMatrix<int8_t>& wt, Matrix<int32_t>& acc)
+    {
+        if(a.values.nCols != wt.values.nCols)
+            throw std::invalid_argument("multiply: inner dimensions differ");
+        // |acc| <= k*255*128 has to fit in int32
+        if(a.values.nCols > std::numeric_limits<int32_t>::max()/(255*128))
+            throw std::invalid_argument("multiply: inner dimension too large for int32 accumulation");
+        reshape(acc, a.values.nRows, wt.values.nRows);
+        kernels().matmulU8S8(a.values.mem, wt.values.mem, acc.mem, a.values.nRows, a.values.nCols, wt.values.nRows);
+    }
+}
+
+template<typename Q>
+QuantizedMatrix<Q> quantize(const Matrix<float>& src, Granularity granularity)
+{
+    TRACE_SPAN("quantize");
+    QuantizedMatrix<Q> out;
+    out.values.init(src.nRows, src.nCols);
+    if(granularity == Granularity::PerTensor)
+        out.params.push_back(quantized_detail::chooseParams<Q>(src.begin(), src.end()));
+    else
+        for(int i = 0; i < src.nRows; ++i)
+            out.params.push_back(quantized_detail::chooseParams<Q>(src.row(i).begin(), src.row(i).end()));
+
+    for(int i = 0; i < src.nRows; ++i)
+    {
+        const QuantParams& p = out.rowParams(i);
+        const float inv = 1.f/p.scale;
+        for(int j = 0; j < src.nCols; ++j)
+            out.values.unchecked(i, j) = quantized_detail::quantizeOne<Q>(src.unchecked(i, j), inv, p.zeroPoint);
+    }
+    return out;
+}
+
+template<typename Q>
+void dequantize(const QuantizedMatrix<Q>& src, Matrix<float>& dst)
+{
+    TRACE_SPAN("dequantize");
+    reshape(dst, src.values.nRows, src.values.nCols);
+    for(int i = 0; i < dst.nRows; ++i)
+    {
+        const QuantParams& p = src.rowParams(i);
+        for(int j = 0; j < dst.nCols; ++j)
+            dst.unchecked(i, j) = p.scale*(src.values.unchecked(i, j) - p.zeroPoint);
+    }
+}
+
+// c = a * wt^T with a (n x k) uint8 activations and wt (m x k) int8 weights, one row per output
+inline void multiply(const QuantizedMatrix<uint8_t>& a, const QuantizedMatrix<int8_t>& wt, Matrix<float>& c)
+{
+    TRACE_SPAN("multiply u8 x s8");
+    Matrix<int32_t> acc;
+    quantized_detail::accumulate(a, wt, acc);
+    reshape(c, acc.nRows, acc.nCols);
+    quantized_detail::forEachProduct(a, wt, acc, [&c](int i, int j, float v) { c.unchecked(i, j) = v; });
+}
+
+// the same, requantized to uint8 with the given output parameters
+inline void multiply(const QuantizedMatrix<uint8_t>& a, const QuantizedMatrix<int8_t>& wt, QuantParams out,
+                     QuantizedMatrix<uint8_t>& c)
+{
+    TRACE_SPAN("multiply u8 x s8 -> u8");
+    Matrix<int32_t> acc;
+    quantized_detail::accumulate(a, wt, acc);
+    reshape(c.values, acc.nRows, acc.nCols);
+    c.params.assign(1, out);
+    const float inv = 1.f/out.scale;
+    quantized_detail::forEachProduct(a, wt, acc, [&](int i, int j, float v) {
+        c.values.unchecked(i, j) = quantized_detail::quantizeOne<uint8_t>(v, inv, out.zeroPoint);
+    });
+}
+
+#endif
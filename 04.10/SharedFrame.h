@@ -0,0 +1,157 @@
+#ifndef __SharedFrame_h
+#define __SharedFrame_h
+
+// One writer updating a live frame (Image or any Matrix<T>) while many
+// reader threads render from it. Readers never lock and never see a frame
+// that is half written. (03.20 shares one Image between shared_ptr holders
+// that all write through operator() at the same time, which can tear.)
+//
+//     FramePublisher<Image> live(720, 1280);
+//
+//     // writer thread
+//     live.update([](Image& next) { next(5, 6) = Color(255); });  // next starts as a copy of the latest frame
+//
+//     // any reader thread
+//     auto snap = live.snapshot();        // stays valid and unchanged while `snap` lives
+//     render(*snap);
+//
+// Every frame lives in one of a few slots (triple buffering by default).
+// The writer fills a slot nobody is reading and then swaps the "current"
+// index, RCU style; a reader pins the current slot with a per-slot reader
+// count. The writer alone may wait: when every spare slot is still pinned
+// by slow readers it yields until one is released.
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include "Matrix.h"
+
+template<typename T>
+class FramePublisher
+{
+    struct alignas(64) Slot            // own cache line: readers of different slots do not contend
+    {
+        T frame;
+        unsigned long version = 0;     // written by the writer before the slot is published
+        std::atomic<int> readers{0};
+    };
+
+    int nSlots;
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<int> current{0};
+    unsigned long published = 0;        // writer only
+
+public:
+    // read-only view of one published frame; releases its slot on destruction
+    class Snapshot
+    {
+        Slot* slot = nullptr;
+        unsigned long ver = 0;
+
+        friend class FramePublisher;
+        explicit Snapshot(Slot* slot) : slot(slot), ver(slot->version) { }
+
+    public:
+        Snapshot() = default;
+        Snapshot(Snapshot&& other) : slot(other.slot), ver(other.ver) { other.slot = nullptr; }
+        void operator=(Snapshot&& other)
+        {
+            release();
+            slot = other.slot;
+            ver = other.ver;
+            other.slot = nullptr;
+        }
+        Snapshot(const Snapshot&) = delete;
+        void operator=(const Snapshot&) = delete;
+        ~Snapshot() { release(); }
+
+        const T& operator*() const { return slot->frame; }
+        const T* operator->() const { return &slot->frame; }
+        // how many frames had been published when this one was: tells readers whether anything changed
+        unsigned long version() const { return ver; }
+        explicit operator bool() const { return slot != nullptr; }
+
+        void release()
+        {
+            if(slot) slot->readers.fetch_sub(1, std::memory_order_release);
+            slot = nullptr;
+        }
+    };
+
+    // every slot gets a frame of the given shape, slot 0 is published as version 0
+    FramePublisher(int nRows, int nCols, int nSlots = 3) : nSlots(nSlots), slots(new Slot[nSlots])
+    {
+        if(nSlots < 2) throw std::invalid_argument("FramePublisher needs at least 2 slots");
+        for(int i = 0; i < nSlots; ++i) slots[i].frame.init(nRows, nCols);
+    }
+
+    FramePublisher(const FramePublisher&) = delete;
+    void operator=(const FramePublisher&) = delete;
+
+    // Lock-free for readers. Pin the slot, then check it is still the current one:
+    // if the writer moved on in between, the slot may be about to be rewritten,
+    // so let go and try again with the new current slot.
+    Snapshot snapshot() const
+    {
+        for(;;)
+        {
+            int i = current.load();
+            Slot& slot = slots[i];
+            slot.readers.fetch_add(1);      // seq_cst: ordered against the writer's publish below
+            if(current.load() == i)
+                return Snapshot(&slot);
+            slot.readers.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    // Writer only (one writer thread at a time). `edit` gets a private frame that
+    // starts as a copy of the latest one; it becomes visible atomically afterwards.
+    template<typename FUNC>
+    void update(FUNC&& edit)
+    {
+        Slot& next = acquireFreeSlot();
+        const T& latest = slots[current.load(std::memory_order_relaxed)].frame;
+        if(next.frame.nRows == latest.nRows && next.frame.nCols == latest.nCols)
+            std::copy(latest.mem, latest.mem + latest.numElements(), next.frame.mem);
+        else
+            next.frame = latest;        // shape changed through publish(): reallocate once
+        edit(next.frame);
+        publish(next);
+    }
+
+    // Writer only: publishes `frame` without copying. `frame` is swapped with the
+    // recycled slot's buffer, so the caller gets an old frame back to refill.
+    void publish(T& frame)
+    {
+        Slot& next = acquireFreeSlot();
+        std::swap(next.frame, frame);
+        publish(next);
+    }
+
+private:
+    Slot& acquireFreeSlot()
+    {
+        for(;;)
+        {
+            int cur = current.load(std::memory_order_relaxed);
+            for(int k = 1; k < nSlots; ++k)
+            {
+                Slot& slot = slots[(cur + k) % nSlots];
+                // seq_cst: a reader that pins this slot from now on will see that it is not current
+                if(slot.readers.load() == 0) return slot;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    void publish(Slot& slot)
+    {
+        slot.version = ++published;
+        current.store(static_cast<int>(&slot - slots.get()));     // seq_cst, releases the frame's contents
+    }
+};
+
+#endif
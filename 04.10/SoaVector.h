@@ -0,0 +1,235 @@
+#ifndef __SoaVector_h
+#define __SoaVector_h
+
+// Structure-of-arrays storage for plain aggregates such as Vec2d, Vec3d or
+// Coordinate (02.20, 03.13): one contiguous column per member, found by
+// structured-binding introspection, so no registration or macros are needed.
+//
+//     struct Vec3d { float x, y, z; };
+//     SoaVector<Vec3d> points;
+//     points.push_back({1, 2, 3});
+//
+//     Vec3d p = points[0];                    // proxy converts back to the aggregate
+//     points[0] = Vec3d{4, 5, 6};             // ... and scatters on assignment
+//     points[0].get<1>() += 1;                // one member, in place
+//     auto [x, y, z] = points[0];             // references into the three columns
+//
+//     Span<float> xs = points.column<0>();    // a bare float array: vectorizes like one
+//     for(float& x : xs) x *= 2;
+//
+// A pass that touches one member of an N-member struct streams 1/N of the
+// bytes it would stream over a std::vector<Vec3d>.
+//
+// T must be an aggregate with up to 8 public non-static members, no base
+// classes and no nested aggregates or arrays as members (brace elision
+// would make the member count ambiguous). bool members do not work either:
+// their column would be a std::vector<bool>, which has no data().
+
+#include <cstddef>
+#include <iterator>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Matrix.h"
+
+namespace soa_detail
+{
+    // converts to anything: T{AnyField{}, AnyField{}} compiles iff T has at least two members
+    struct AnyField
+    {
+        template<typename U>
+        operator U() const;
+    };
+
+    template<typename T, typename Seq, typename = void>
+    struct BraceConstructible : std::false_type { };
+
+    template<typename T, size_t... I>
+    struct BraceConstructible<T, std::index_sequence<I...>, std::void_t<decltype(T{(void(I), AnyField{})...})>>
+        : std::true_type { };
+
+    template<typename T, size_t N = 0>
+    constexpr size_t fieldCount()
+    {
+        if constexpr(N < 9 && BraceConstructible<T, std::make_index_sequence<N + 1>>::value)
+            return fieldCount<T, N + 1>();
+        else
+            return N;
+    }
+
+    // a tuple of references to every member of `t`
+    template<typename T>
+    constexpr auto tieFields(T& t)
+    {
+        constexpr size_t N = fieldCount<std::remove_const_t<T>>();
+        static_assert(N >= 1 && N <= 8, "SoaVector supports aggregates with 1 to 8 members");
+        if constexpr(N == 1) { auto& [a] = t; return std::tie(a); }
+        else if constexpr(N == 2) { auto& [a, b] = t; return std::tie(a, b); }
+        else if constexpr(N == 3) { auto& [a, b, c] = t; return std::tie(a, b, c); }
+        else if constexpr(N == 4) { auto& [a, b, c, d] = t; return std::tie(a, b, c, d); }
+        else if constexpr(N == 5) { auto& [a, b, c, d, e] = t; return std::tie(a, b, c, d, e); }
+        else if constexpr(N == 6) { auto& [a, b, c, d, e, f] = t; return std::tie(a, b, c, d, e, f); }
+        else if constexpr(N == 7) { auto& [a, b, c, d, e, f, g] = t; return std::tie(a, b, c, d, e, f, g); }
+        else { auto& [a, b, c, d, e, f, g, h] = t; return std::tie(a, b, c, d, e, f, g, h); }
+    }
+
+    template<typename Refs> struct Decay;
+    template<typename... Rs> struct Decay<std::tuple<Rs...>> { using type = std::tuple<std::remove_reference_t<Rs>...>; };
+
+    // std::tuple<member types...>
+    template<typename T>
+    using Fields = typename Decay<decltype(tieFields(std::declval<T&>()))>::type;
+
+    template<typename Tuple> struct Columns;
+    template<typename... Fs> struct Columns<std::tuple<Fs...>> { using type = std::tuple<std::vector<Fs>...>; };
+}
+
+// Element i of a SoaVector seen through its columns; Vec is SoaVector<T> or
+// const SoaVector<T>. Behaves like a reference: assigning writes through.
+template<typename Vec>
+class SoaProxy
+{
+    using T = typename std::remove_const_t<Vec>::value_type;
+
+    Vec* vec;
+    size_t i;
+
+public:
+    SoaProxy(Vec* vec, size_t i) : vec(vec), i(i) { }
+    SoaProxy(const SoaProxy&) = default;
+
+    template<size_t I>
+    decltype(auto) get() const { return vec->template column<I>()[i]; }
+
+    operator T() const { return vec->get(i); }
+
+    const SoaProxy& operator=(const T& value) const
+    {
+        vec->set(i, value);
+        return *this;
+    }
+    const SoaProxy& operator=(const SoaProxy& other) const { return *this = static_cast<T>(other); }
+};
+
+// Hands out SoaProxy by value, which a forward iterator may not do, so it is
+// an input iterator (like Matrix's row iterator): range-for and single-pass
+// algorithms only.
+template<typename Vec>
+class SoaIterator
+{
+    Vec* vec;
+    size_t i;
+
+public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = typename std::remove_const_t<Vec>::value_type;
+    using difference_type = std::ptrdiff_t;
+    using reference = SoaProxy<Vec>;
+    using pointer = void;
+
+    SoaIterator(Vec* vec, size_t i) : vec(vec), i(i) { }
+    SoaProxy<Vec> operator*() const { return SoaProxy<Vec>(vec, i); }
+    SoaIterator& operator++() { ++i; return *this; }
+    SoaIterator operator++(int) { SoaIterator old = *this; ++i; return old; }
+    friend bool operator==(const SoaIterator& a, const SoaIterator& b) { return a.i == b.i; }
+    friend bool operator!=(const SoaIterator& a, const SoaIterator& b) { return a.i != b.i; }
+};
+
+template<typename T>
+class SoaVector
+{
+    static_assert(std::is_aggregate<T>::value, "SoaVector<T> needs an aggregate T");
+
+public:
+    using Fields = soa_detail::Fields<T>;
+    static constexpr size_t numFields = std::tuple_size<Fields>::value;
+    template<size_t I> using Field = std::tuple_element_t<I, Fields>;
+
+    using value_type = T;
+    using Reference = SoaProxy<SoaVector>;
+    using ConstReference = SoaProxy<const SoaVector>;
+
+    SoaVector() = default;
+    explicit SoaVector(size_t n) { resize(n); }
+
+    size_t size() const { return std::get<0>(columns).size(); }
+    bool empty() const { return size() == 0; }
+
+    void resize(size_t n) { forEachColumn([n](auto& col) { col.resize(n); }); }
+    void reserve(size_t n) { forEachColumn([n](auto& col) { col.reserve(n); }); }
+    void clear() { forEachColumn([](auto& col) { col.clear(); }); }
+    void pop_back() { forEachColumn([](auto& col) { col.pop_back(); }); }
+
+    void push_back(const T& value)
+    {
+        pushFields(soa_detail::tieFields(value), std::make_index_sequence<numFields>());
+    }
+
+    // gathers element i back into a T
+    T get(size_t i) const { return gather(i, std::make_index_sequence<numFields>()); }
+    void set(size_t i, const T& value) { scatter(i, soa_detail::tieFields(value), std::make_index_sequence<numFields>()); }
+
+    Reference operator[](size_t i) { return Reference(this, i); }
+    ConstReference operator[](size_t i) const { return ConstReference(this, i); }
+
+    // one member of every element, contiguous
+    template<size_t I>
+    Span<Field<I>> column()
+    {
+        auto& col = std::get<I>(columns);
+        return {col.data(), col.size()};
+    }
+
+    template<size_t I>
+    Span<const Field<I>> column() const
+    {
+        auto& col = std::get<I>(columns);
+        return {col.data(), col.size()};
+    }
+
+    SoaIterator<SoaVector> begin() { return {this, 0}; }
+    SoaIterator<SoaVector> end() { return {this, size()}; }
+    SoaIterator<const SoaVector> begin() const { return {this, 0}; }
+    SoaIterator<const SoaVector> end() const { return {this, size()}; }
+
+private:
+    typename soa_detail::Columns<Fields>::type columns;
+
+    template<typename FUNC>
+    void forEachColumn(FUNC&& func)
+    {
+        std::apply([&](auto&... col) { (func(col), ...); }, columns);
+    }
+
+    template<typename Refs, size_t... I>
+    void pushFields(const Refs& fields, std::index_sequence<I...>)
+    {
+        (std::get<I>(columns).push_back(std::get<I>(fields)), ...);
+    }
+
+    template<size_t... I>
+    T gather(size_t i, std::index_sequence<I...>) const
+    {
+        return T{std::get<I>(columns)[i]...};
+    }
+
+    template<typename Refs, size_t... I>
+    void scatter(size_t i, const Refs& fields, std::index_sequence<I...>)
+    {
+        ((std::get<I>(columns)[i] = std::get<I>(fields)), ...);
+    }
+};
+
+// structured bindings on a proxy bind references into the columns
+namespace std
+{
+    template<typename Vec>
+    struct tuple_size<SoaProxy<Vec>> : std::integral_constant<size_t, std::remove_const_t<Vec>::numFields> { };
+
+    template<size_t I, typename Vec>
+    struct tuple_element<I, SoaProxy<Vec>> { using type = decltype(std::declval<SoaProxy<Vec>>().template get<I>()); };
+}
+
+#endif
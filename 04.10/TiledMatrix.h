@@ -0,0 +1,297 @@
+#ifndef __TiledMatrix_h
+#define __TiledMatrix_h
+
+// Out-of-core matrix: same logical (row, col) access as Matrix<T>, but the
+// elements live in a file as fixed-size tiles and only a bounded number of
+// tiles are resident at once (LRU, dirty tiles are written back on eviction).
+//
+//     TiledMatrix<float> big("big.bin", 100000, 100000, 256, 512 << 20); // 512 MB budget
+//     big(5, 6) = 1.f;
+//     big.visitTiles([](auto& tile) { ... });    // stream tiles in file order
+//
+// A reference returned by operator() is only valid until another tile is
+// brought in, so do not hold on to it across accesses of other tiles.
+//
+// By default the file is scratch space: it is truncated and the matrix
+// starts out zero. Mode::Open picks up the tiles a TiledMatrix of the same
+// shape and tile size left in it instead. Dirty tiles are written back by
+// close(), which throws when that fails; the destructor closes too, but can
+// only report a failure on std::cerr.
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "Matrix.h"
+
+template<typename T>
+class TiledMatrix : public MatrixCore
+{
+    static_assert(std::is_trivially_copyable<T>::value, "tiles are stored as raw bytes");
+
+public:
+    int nRows, nCols;
+
+    // one resident tile, handed to visitTiles(); element (r, c) of the tile is data[r*tileSize + c]
+    struct Tile
+    {
+        int row0, col0;         // top-left element in matrix coordinates
+        int rows, cols;         // valid extent, smaller than tileSize on the right/bottom edges
+        int stride;             // == tileSize
+        T* data;
+
+        T& operator()(int r, int c) const { return data[r*stride + c]; }
+    };
+
+    enum class Mode
+    {
+        Create,     // a new matrix of zeros; an existing file is truncated
+        Open        // the existing file's tiles, tiles beyond its end are zero
+    };
+
+    TiledMatrix(const std::string& path, int nRows, int nCols, int tileSize = 256, size_t memoryBudget = 64 << 20,
+                Mode mode = Mode::Create)
+        : nRows(nRows), nCols(nCols), tileSize(checkedTileSize(tileSize)),
+          tilesPerRow((nCols + this->tileSize - 1)/this->tileSize), tilesPerCol((nRows + this->tileSize - 1)/this->tileSize),
+          file(path, std::ios::binary | std::ios::in | std::ios::out |
+                     (mode == Mode::Create ? std::ios::trunc : std::ios::openmode())),
+          onDisk(static_cast<size_t>(tilesPerRow)*tilesPerCol, false)
+    {
+        if(nRows < 0 || nCols < 0) throw std::invalid_argument("TiledMatrix: negative dimensions");
+        if(!file) throw std::runtime_error("TiledMatrix: cannot open " + path);
+        if(mode == Mode::Open)
+        {
+            // tiles are only ever written whole, so every tile that ends within the file has been
+            file.seekg(0, std::ios::end);
+            const auto size = static_cast<size_t>(file.tellg());
+            for(size_t index = 0; index < onDisk.size(); ++index) onDisk[index] = (index + 1)*tileBytes() <= size;
+        }
+        setMemoryBudget(memoryBudget);
+    }
+
+    TiledMatrix(const TiledMatrix&) = delete;
+    void operator=(const TiledMatrix&) = delete;
+
+    ~TiledMatrix()
+    {
+        try
+        {
+            close();
+        }
+        catch(const std::exception& e)
+        {
+            std::cerr << e.what() << " (closing TiledMatrix, changes lost)" << std::endl;
+        }
+    }
+
+    size_t numElements() const { return static_cast<size_t>(nRows)*nCols; }
+    int tileDim() const { return tileSize; }
+    size_t tileBytes() const { return static_cast<size_t>(tileSize)*tileSize*sizeof(T); }
+
+    // read-write access, marks the tile dirty
+    T& operator()(int row, int col)
+    {
+        Resident& t = fetch(tileIndex(row, col));
+        t.dirty = true;
+        return t.data[(row % tileSize)*tileSize + col % tileSize];
+    }
+
+    T get(int row, int col)
+    {
+        return fetch(tileIndex(row, col)).data[(row % tileSize)*tileSize + col % tileSize];
+    }
+
+    void set(int row, int col, T value)
+    {
+        (*this)(row, col) = value;
+    }
+
+    // Visits every tile once in file order (row-major over tiles), so each tile is read
+    // sequentially and at most once. Tiles are marked dirty.
+    template<typename FUNC>
+    void visitTiles(FUNC&& func)
+    {
+        visit(func, true);
+    }
+
+    // same, but tiles are not written back unless something else dirtied them
+    template<typename FUNC>
+    void visitTilesReadOnly(FUNC&& func)
+    {
+        visit(func, false);
+    }
+
+    // The budget is rounded down to whole tiles, at least one tile is always resident.
+    void setMemoryBudget(size_t bytes)
+    {
+        maxResident = std::max<size_t>(1, bytes/tileBytes());
+        while(cache.size() > maxResident) evict();
+    }
+
+    size_t memoryBudget() const { return maxResident*tileBytes(); }
+    size_t residentTiles() const { return cache.size(); }
+
+    // write every dirty tile back, tiles stay resident
+    void flush()
+    {
+        for(auto& entry : cache)
+            writeBack(entry.first, entry.second);
+        if(!file.flush()) throw std::runtime_error("TiledMatrix: flush failed");
+    }
+
+    // Writes every dirty tile back and closes the file, throwing if either
+    // fails. The matrix cannot be used afterwards; closing again does nothing.
+    void close()
+    {
+        if(!file.is_open()) return;
+        flush();
+        cache.clear();
+        lru.clear();
+        lastIndex = -1;
+        last = nullptr;
+        file.close();
+        if(!file) throw std::runtime_error("TiledMatrix: close failed");
+    }
+
+    size_t hits() const { return nHits; }
+    size_t misses() const { return nMisses; }
+    size_t evictions() const { return nEvictions; }
+    size_t writeBacks() const { return nWriteBacks; }
+    double hitRate() const { return nHits + nMisses == 0 ? 0.0 : double(nHits)/(nHits + nMisses); }
+    void resetCounters() { nHits = nMisses = nEvictions = nWriteBacks = 0; }
+
+    void load() override
+    {
+        std::cout << "TiledMatrix loaded! (" << tilesPerCol << "x" << tilesPerRow << " tiles, "
+                  << maxResident << " resident max)" << std::endl;
+    }
+
+private:
+    struct Resident
+    {
+        std::vector<T> data;
+        bool dirty = false;
+        typename std::list<int>::iterator lruPos;
+    };
+
+    int tileSize;
+    int tilesPerRow, tilesPerCol;
+    std::fstream file;
+    std::vector<bool> onDisk;           // tiles never written are implicitly zero
+    size_t maxResident = 1;
+
+    std::unordered_map<int, Resident> cache;
+    std::list<int> lru;                 // front = most recently used
+    int lastIndex = -1;                 // skip the map lookup for repeated hits on one tile
+    Resident* last = nullptr;
+
+    size_t nHits = 0, nMisses = 0, nEvictions = 0, nWriteBacks = 0;
+
+    static int checkedTileSize(int tileSize)
+    {
+        if(tileSize <= 0) throw std::invalid_argument("TiledMatrix: tile size must be positive");
+        return tileSize;
+    }
+
+    int tileIndex(int row, int col) const { return (row/tileSize)*tilesPerRow + col/tileSize; }
+
+    Resident& fetch(int index)
+    {
+        if(index == lastIndex)
+        {
+            ++nHits;
+            return *last;
+        }
+        auto it = cache.find(index);
+        if(it != cache.end())
+        {
+            ++nHits;
+            lru.splice(lru.begin(), lru, it->second.lruPos);
+            return remember(index, it->second);
+        }
+
+        ++nMisses;
+        TRACE_SPAN("TiledMatrix tile load");
+        if(cache.size() >= maxResident) evict();
+        // read first: a tile only goes into the cache and the LRU list once it is there
+        std::vector<T> data(static_cast<size_t>(tileSize)*tileSize, T{});
+        if(onDisk[index])
+        {
+            file.seekg(static_cast<std::streamoff>(index)*tileBytes());
+            file.read(reinterpret_cast<char*>(data.data()), tileBytes());
+            if(!file)
+            {
+                file.clear();
+                throw std::runtime_error("TiledMatrix: tile read failed");
+            }
+        }
+        Resident& t = cache[index];
+        t.data = std::move(data);
+        lru.push_front(index);
+        t.lruPos = lru.begin();
+        return remember(index, t);
+    }
+
+    Resident& remember(int index, Resident& t)
+    {
+        lastIndex = index;
+        last = &t;
+        return t;
+    }
+
+    void evict()
+    {
+        const int victim = lru.back();
+        auto it = cache.find(victim);
+        // if this throws, the tile stays resident and dirty
+        writeBack(victim, it->second);
+        lru.pop_back();
+        cache.erase(it);
+        if(victim == lastIndex)
+        {
+            lastIndex = -1;
+            last = nullptr;
+        }
+        ++nEvictions;
+    }
+
+    void writeBack(int index, Resident& t)
+    {
+        if(!t.dirty) return;
+        TRACE_SPAN("TiledMatrix tile write-back");
+        file.seekp(static_cast<std::streamoff>(index)*tileBytes());
+        file.write(reinterpret_cast<const char*>(t.data.data()), tileBytes());
+        if(!file)
+        {
+            file.clear();
+            throw std::runtime_error("TiledMatrix: tile write failed");
+        }
+        onDisk[index] = true;
+        t.dirty = false;
+        ++nWriteBacks;
+    }
+
+    template<typename FUNC>
+    void visit(FUNC& func, bool markDirty)
+    {
+        for(int tr = 0; tr < tilesPerCol; ++tr)
+            for(int tc = 0; tc < tilesPerRow; ++tc)
+            {
+                int index = tr*tilesPerRow + tc;
+                Resident& t = fetch(index);
+                t.dirty = t.dirty || markDirty;
+                Tile tile{tr*tileSize, tc*tileSize,
+                          std::min(tileSize, nRows - tr*tileSize), std::min(tileSize, nCols - tc*tileSize),
+                          tileSize, t.data.data()};
+                func(tile);
+            }
+    }
+};
+
+#endif
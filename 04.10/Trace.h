@@ -0,0 +1,193 @@
+#ifndef __Trace_h
+#define __Trace_h
+
+// Low-overhead trace spans, exported as Chrome trace-event JSON
+// (open in https://ui.perfetto.dev or chrome://tracing).
+//
+//     void blur(Image& img) {
+//         TRACE_SPAN("blur");             // one complete event from here to the end of scope
+//         ...
+//     }
+//     trace::writeChromeTrace("trace.json");
+//
+// Compiled out unless MATRIX_TRACE is 1: the macros expand to nothing and
+// Matrix/Image pay nothing. When enabled, a span costs two timestamp reads
+// and one append to a buffer owned by the calling thread, no locks.
+//
+// Timestamps are raw TSC ticks on x86 (steady_clock elsewhere), converted
+// to microseconds at export time with a rate measured against steady_clock
+// over the whole traced interval.
+//
+// Span names must be string literals (or otherwise outlive the export):
+// only the pointer is stored.
+
+#ifndef MATRIX_TRACE
+#define MATRIX_TRACE 0
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace trace
+{
+    inline uint64_t now()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    struct Event
+    {
+        const char* name;
+        uint64_t begin, end;
+    };
+
+    // Written only by its own thread. `size` is published with release so the
+    // exporter can read every completed event while the thread keeps going.
+    struct ThreadBuffer
+    {
+        static constexpr size_t CAPACITY = 1 << 16;
+
+        int tid;
+        std::unique_ptr<Event[]> events{new Event[CAPACITY]};
+        std::atomic<size_t> size{0};
+        std::atomic<size_t> dropped{0};
+
+        explicit ThreadBuffer(int tid) : tid(tid) { }
+
+        void append(const char* name, uint64_t begin, uint64_t end)
+        {
+            size_t n = size.load(std::memory_order_relaxed);
+            if(n == CAPACITY)
+            {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            events[n] = Event{name, begin, end};
+            size.store(n + 1, std::memory_order_release);
+        }
+    };
+
+    // Owns every thread's buffer, so events survive their thread.
+    class Registry
+    {
+        std::mutex lock;
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+        uint64_t tick0;
+        std::chrono::steady_clock::time_point time0;
+
+        Registry() : tick0(now()), time0(std::chrono::steady_clock::now()) { }
+
+    public:
+        static Registry& instance()
+        {
+            static Registry registry;
+            return registry;
+        }
+
+        ThreadBuffer& add()
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            buffers.emplace_back(new ThreadBuffer(static_cast<int>(buffers.size()) + 1));
+            return *buffers.back();
+        }
+
+        // Exports every completed event. Spans still open are not included.
+        bool writeChromeTrace(const std::string& path)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            std::ofstream out(path);
+            if(!out) return false;
+
+            // ticks -> microseconds, measured over everything traced so far
+            uint64_t tick1 = now();
+            std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - time0;
+            double usPerTick = tick1 > tick0 ? elapsed.count()/double(tick1 - tick0) : 0.0;
+            // clamped, in case a tick comes from before the registry after all
+            auto since0 = [&](uint64_t tick) { return tick > tick0 ? (tick - tick0)*usPerTick : 0.0; };
+
+            out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n";
+            bool first = true;
+            for(auto& buffer : buffers)
+            {
+                out << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": "
+                    << buffer->tid << ", \"args\": {\"name\": \"thread " << buffer->tid << "\"}}";
+                first = false;
+                size_t n = buffer->size.load(std::memory_order_acquire);
+                for(size_t i = 0; i < n; ++i)
+                {
+                    const Event& e = buffer->events[i];
+                    out << ",\n{\"name\": \"" << e.name << "\", \"cat\": \"matrix\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+                        << buffer->tid << ", \"ts\": " << since0(e.begin)
+                        << ", \"dur\": " << (e.end - e.begin)*usPerTick << "}";
+                }
+                if(size_t dropped = buffer->dropped.load())
+                    out << ",\n{\"name\": \"" << dropped << " spans dropped (buffer full)\", \"ph\": \"i\", \"s\": \"t\", \"pid\": 1, \"tid\": "
+                        << buffer->tid << ", \"ts\": " << since0(tick1) << "}";
+            }
+            out << "\n]}\n";
+            return static_cast<bool>(out);
+        }
+
+        // Forget all recorded events (buffers stay registered to their threads).
+        // Only call this while no other thread is recording spans.
+        void clear()
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            for(auto& buffer : buffers)
+            {
+                buffer->size.store(0, std::memory_order_release);
+                buffer->dropped.store(0);
+            }
+        }
+    };
+
+    inline ThreadBuffer& threadBuffer()
+    {
+        thread_local ThreadBuffer& buffer = Registry::instance().add();
+        return buffer;
+    }
+
+    class Span
+    {
+        const char* name;
+        uint64_t begin;
+
+    public:
+        // The buffer (and with the first span, the registry and its tick0) is
+        // set up before the clock is read, so no span starts before tick0 and
+        // the setup is not part of the first span on a thread.
+        explicit Span(const char* name) : name(name), begin((static_cast<void>(threadBuffer()), now())) { }
+        Span(const Span&) = delete;
+        void operator=(const Span&) = delete;
+        ~Span() { threadBuffer().append(name, begin, now()); }
+    };
+
+    inline bool writeChromeTrace(const std::string& path) { return Registry::instance().writeChromeTrace(path); }
+    inline void clear() { Registry::instance().clear(); }
+}
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#if MATRIX_TRACE
+#define TRACE_SPAN(name) ::trace::Span TRACE_CONCAT(traceSpan_, __LINE__)(name)
+#else
+#define TRACE_SPAN(name) do { } while(0)
+#endif
+
+#endif
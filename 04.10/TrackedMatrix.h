@@ -0,0 +1,397 @@
+#ifndef __TrackedMatrix_h
+#define __TrackedMatrix_h
+
+// Change tracking at tile granularity, for images that are edited a little
+// at a time (a brush stroke, a pasted patch) and have derived results that
+// would otherwise be recomputed from scratch after every edit:
+//
+//     TrackedImage img(std::move(loaded));           // 64x64 tiles by default
+//     IncrementalBoxFilter<Color> blurred(img, 3);    // same result as boxFilter(img, 3, ...)
+//     IncrementalDownsample<Color> preview(img, 8);
+//     IncrementalStats<Color> stats(img);
+//
+//     img.set(r, c, Color(255, 0, 0));                // marks the tile
+//     blurred.update();                               // redoes the tiles within reach of the edit
+//     show(blurred.output(), preview.output(), stats.mean(0));
+//
+// Writes through set()/operator() stamp their tile with the current version.
+// Each consumer remembers the version it last caught up with and recomputes
+// only the output that depends on tiles stamped since, grown by the reach of
+// its operator (the filter radius, the downsampling block). The first
+// update() computes everything, and an incremental result is bit for bit the
+// one a full recomputation gives.
+//
+// Reading needs no tracking, so the const accessors are plain Matrix reads;
+// code that writes in bulk through untracked() calls markDirty() itself.
+// Not thread-safe: edits and updates happen on one thread, or under the
+// caller's lock.
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <stdint.h>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "IntegralImage.h"
+#include "Matrix.h"
+
+template<typename T>
+class TrackedMatrix : public MatrixCore
+{
+public:
+    int nRows, nCols;
+
+    TrackedMatrix(int nRows, int nCols, int tileSize = 64) : TrackedMatrix(Matrix<T>(nRows, nCols), tileSize) { }
+
+    explicit TrackedMatrix(Matrix<T> src, int tileSize = 64)
+        : nRows(src.nRows), nCols(src.nCols), data(std::move(src))
+    {
+        if(tileSize < 1 || (tileSize & (tileSize - 1)) != 0)
+            throw std::invalid_argument("TrackedMatrix: the tile size must be a power of two");
+        while((1 << shift) < tileSize) ++shift;
+        tilesPerRow = (nCols + tileSize - 1) >> shift;
+        tilesPerCol = (nRows + tileSize - 1) >> shift;
+        stamps.assign(static_cast<size_t>(tilesPerRow)*tilesPerCol, 0);
+    }
+
+    const T& operator()(int row, int col) const { return data(row, col); }
+    const T& get(int row, int col) const { return data(row, col); }
+
+    // a non-const reference is taken as a write: the tile is marked whether or not it is written
+    T& operator()(int row, int col)
+    {
+        T& ref = data(row, col);
+        stamps[tileIndex(row, col)] = clock;
+        return ref;
+    }
+
+    void set(int row, int col, const T& value) { (*this)(row, col) = value; }
+
+    // rows [row0, row0 + rows) x cols [col0, col0 + cols), clipped to the matrix
+    void fill(int row0, int col0, int rows, int cols, const T& value)
+    {
+        const int r0 = std::max(row0, 0), r1 = std::min(row0 + rows, nRows);
+        const int c0 = std::max(col0, 0), c1 = std::min(col0 + cols, nCols);
+        if(c1 <= c0) return;
+        for(int i = r0; i < r1; ++i)
+        {
+            T* rowStart = data.mem + static_cast<size_t>(i)*nCols;
+            std::fill(rowStart + c0, rowStart + c1, value);
+        }
+        markDirty(row0, col0, rows, cols);
+    }
+
+    void markDirty(int row0, int col0, int rows, int cols)
+    {
+        const int r0 = std::max(row0, 0), r1 = std::min(row0 + rows, nRows);
+        const int c0 = std::max(col0, 0), c1 = std::min(col0 + cols, nCols);
+        if(r1 <= r0 || c1 <= c0) return;
+        for(int tr = r0 >> shift; tr <= (r1 - 1) >> shift; ++tr)
+            for(int tc = c0 >> shift; tc <= (c1 - 1) >> shift; ++tc)
+                stamps[static_cast<size_t>(tr)*tilesPerRow + tc] = clock;
+    }
+
+    void markAllDirty() { std::fill(stamps.begin(), stamps.end(), clock); }
+
+    const Matrix<T>& matrix() const { return data; }
+    // for bulk writers; whatever is written here has to be reported with markDirty()
+    Matrix<T>& untracked() { return data; }
+
+    int tileSize() const { return 1 << shift; }
+    int numTileRows() const { return tilesPerCol; }
+    int numTileCols() const { return tilesPerRow; }
+
+    // Starts a new version and returns it: writes from now on are stamped with
+    // it, everything written before is older. Consumers call this when they
+    // catch up, and later ask for the tiles changed since the value it returned.
+    uint64_t checkpoint() const { return ++clock; }
+
+    bool tileChangedSince(int tileRow, int tileCol, uint64_t since) const
+    {
+        return stamps[static_cast<size_t>(tileRow)*tilesPerRow + tileCol] >= since;
+    }
+
+    // Indices (tileRow*numTileCols() + tileCol) of the tiles changed since
+    // `since`, plus every tile within `halo` elements of one: the tiles of a
+    // same-sized output to redo when each output element reads the source up
+    // to `halo` away. In row-major tile order.
+    std::vector<int> tilesChangedSince(uint64_t since, int halo = 0) const
+    {
+        const int reach = halo <= 0 ? 0 : ((halo - 1) >> shift) + 1;
+        std::vector<uint8_t> hit(stamps.size(), 0);
+        for(int tr = 0; tr < tilesPerCol; ++tr)
+            for(int tc = 0; tc < tilesPerRow; ++tc)
+            {
+                if(stamps[static_cast<size_t>(tr)*tilesPerRow + tc] < since) continue;
+                for(int r = std::max(tr - reach, 0); r <= std::min(tr + reach, tilesPerCol - 1); ++r)
+                    for(int c = std::max(tc - reach, 0); c <= std::min(tc + reach, tilesPerRow - 1); ++c)
+                        hit[static_cast<size_t>(r)*tilesPerRow + c] = 1;
+            }
+        std::vector<int> tiles;
+        for(size_t i = 0; i < hit.size(); ++i)
+            if(hit[i]) tiles.push_back(static_cast<int>(i));
+        return tiles;
+    }
+
+    void load() override
+    {
+        std::cout << "TrackedMatrix loaded! (" << tilesPerCol << "x" << tilesPerRow << " tiles of " << tileSize() << "x"
+                  << tileSize() << ")" << std::endl;
+    }
+
+private:
+    Matrix<T> data;
+    int shift = 0;
+    int tilesPerRow = 0, tilesPerCol = 0;
+    std::vector<uint64_t> stamps;       // per tile, the version it was last written in
+    mutable uint64_t clock = 1;
+
+    size_t tileIndex(int row, int col) const
+    {
+        return static_cast<size_t>(row >> shift)*tilesPerRow + (col >> shift);
+    }
+};
+
+using TrackedImage = TrackedMatrix<Color>;
+
+namespace tracked_detail
+{
+    inline uint8_t meanPixel(uint32_t sum, double invCount)
+    {
+        return integral_detail::roundedMean(sum, invCount);
+    }
+
+    inline Color meanPixel(const ColorSum& sum, double invCount)
+    {
+        return Color(integral_detail::roundedMean(sum.r, invCount), integral_detail::roundedMean(sum.g, invCount),
+                     integral_detail::roundedMean(sum.b, invCount));
+    }
+
+    // channel k of a pixel, for the statistics
+    template<typename T>
+    constexpr int channels() { return std::is_same<T, Color>::value ? 3 : 1; }
+
+    template<typename T>
+    double channel(const T& v, int) { return static_cast<double>(v); }
+
+    inline double channel(const Color& c, int k) { return k == 0 ? c.r : k == 1 ? c.g : c.b; }
+}
+
+// The mean over the (2*radius+1)^2 window around every pixel, shrinking at
+// the borders: boxFilter() from IntegralImage.h, kept up to date tile by
+// tile. For uint8_t and Color, like boxFilter.
+template<typename T>
+class IncrementalBoxFilter
+{
+    using Acc = typename SatTraits<T>::Sum;
+
+public:
+    IncrementalBoxFilter(const TrackedMatrix<T>& src, int radius)
+        : src(src), radius(radius), out(src.nRows, src.nCols),
+          invWidth(integral_detail::inverseWidths(src.nCols, radius))
+    {
+        if(radius < 0) throw std::invalid_argument("window radius must not be negative");
+    }
+
+    // brings output() up to date with the source; returns the number of tiles recomputed
+    int update()
+    {
+        TRACE_SPAN("IncrementalBoxFilter::update");
+        const std::vector<int> tiles = src.tilesChangedSince(synced, radius);
+        synced = src.checkpoint();
+        for(int t : tiles) filterTile(t/src.numTileCols(), t%src.numTileCols());
+        return static_cast<int>(tiles.size());
+    }
+
+    const Matrix<T>& output() const { return out; }
+
+private:
+    const TrackedMatrix<T>& src;
+    int radius;
+    Matrix<T> out;
+    std::vector<double> invWidth;
+    std::vector<Acc> rowSums;           // horizontal window sums of the tile's columns, one row per source row read
+    std::vector<Acc> window;            // the full window sums of the output row being written
+    uint64_t synced = 0;
+
+    void filterTile(int tileRow, int tileCol)
+    {
+        const Matrix<T>& in = src.matrix();
+        const int rows = in.nRows, cols = in.nCols, ts = src.tileSize();
+        const int r0 = tileRow*ts, r1 = std::min(r0 + ts, rows);
+        const int c0 = tileCol*ts, c1 = std::min(c0 + ts, cols), w = c1 - c0;
+        const int y0 = std::max(r0 - radius, 0), y1 = std::min(r1 + radius, rows);
+        rowSums.resize(static_cast<size_t>(y1 - y0)*w);
+
+        // sliding sums along each source row, over [j - radius, j + radius] clipped
+        for(int y = y0; y < y1; ++y)
+        {
+            const T* px = in.mem + static_cast<size_t>(y)*cols;
+            Acc* sums = rowSums.data() + static_cast<size_t>(y - y0)*w;
+            Acc s = Acc();
+            for(int x = std::max(c0 - radius, 0); x < std::min(c0 + radius + 1, cols); ++x) s = s + Acc(px[x]);
+            sums[0] = s;
+            for(int j = c0 + 1; j < c1; ++j)
+            {
+                if(j + radius < cols) s = s + Acc(px[j + radius]);
+                if(j - radius - 1 >= 0) s = s - Acc(px[j - radius - 1]);
+                sums[j - c0] = s;
+            }
+        }
+
+        // and down the columns
+        window.assign(rowSums.begin(), rowSums.begin() + w);
+        for(int y = y0 + 1; y < std::min(r0 + radius + 1, rows); ++y)
+            for(int j = 0; j < w; ++j) window[j] = window[j] + rowSums[static_cast<size_t>(y - y0)*w + j];
+        for(int i = r0; i < r1; ++i)
+        {
+            if(i > r0)
+            {
+                if(i + radius < rows)
+                    for(int j = 0; j < w; ++j) window[j] = window[j] + rowSums[static_cast<size_t>(i + radius - y0)*w + j];
+                if(i - radius - 1 >= 0)
+                    for(int j = 0; j < w; ++j) window[j] = window[j] - rowSums[static_cast<size_t>(i - radius - 1 - y0)*w + j];
+            }
+            const double invRows = 1.0/(std::min(i + radius + 1, rows) - std::max(i - radius, 0));
+            T* o = out.mem + static_cast<size_t>(i)*cols + c0;
+            for(int j = 0; j < w; ++j) o[j] = tracked_detail::meanPixel(window[j], invRows*invWidth[c0 + j]);
+        }
+    }
+};
+
+// Every factor x factor block averaged into one pixel (rounded); a partial
+// block at the right or bottom edge is dropped. For uint8_t and Color.
+template<typename T>
+class IncrementalDownsample
+{
+    using Acc = typename SatTraits<T>::Sum;
+
+public:
+    IncrementalDownsample(const TrackedMatrix<T>& src, int factor)
+        : src(src), factor(factor), out(factor > 0 ? src.nRows/factor : 0, factor > 0 ? src.nCols/factor : 0)
+    {
+        if(factor < 1) throw std::invalid_argument("downsampling factor must be at least 1");
+    }
+
+    // returns the number of source tiles whose blocks were recomputed
+    int update()
+    {
+        TRACE_SPAN("IncrementalDownsample::update");
+        const std::vector<int> tiles = src.tilesChangedSince(synced);
+        synced = src.checkpoint();
+        for(int t : tiles) downsampleTile(t/src.numTileCols(), t%src.numTileCols());
+        return static_cast<int>(tiles.size());
+    }
+
+    const Matrix<T>& output() const { return out; }
+
+private:
+    const TrackedMatrix<T>& src;
+    int factor;
+    Matrix<T> out;
+    uint64_t synced = 0;
+
+    // the output pixels whose blocks overlap the tile (blocks need not line up with tiles)
+    void downsampleTile(int tileRow, int tileCol)
+    {
+        const Matrix<T>& in = src.matrix();
+        const int ts = src.tileSize();
+        const int i0 = tileRow*ts/factor, i1 = std::min((tileRow*ts + ts + factor - 1)/factor, out.nRows);
+        const int j0 = tileCol*ts/factor, j1 = std::min((tileCol*ts + ts + factor - 1)/factor, out.nCols);
+        const double inv = 1.0/(factor*factor);
+        for(int i = i0; i < i1; ++i)
+            for(int j = j0; j < j1; ++j)
+            {
+                Acc s = Acc();
+                for(int y = i*factor; y < (i + 1)*factor; ++y)
+                {
+                    const T* px = in.mem + static_cast<size_t>(y)*in.nCols + j*factor;
+                    for(int x = 0; x < factor; ++x) s = s + Acc(px[x]);
+                }
+                out.unchecked(i, j) = tracked_detail::meanPixel(s, inv);
+            }
+    }
+};
+
+// Mean, minimum and maximum of every channel (one for scalars, three for
+// Color). The partial results of each tile are kept, so an update re-reads
+// the changed tiles only and then combines the partials.
+template<typename T>
+class IncrementalStats
+{
+    static constexpr int C = tracked_detail::channels<T>();
+
+public:
+    explicit IncrementalStats(const TrackedMatrix<T>& src)
+        : src(src), partials(static_cast<size_t>(src.numTileRows())*src.numTileCols())
+    {
+    }
+
+    // returns the number of tiles re-read
+    int update()
+    {
+        TRACE_SPAN("IncrementalStats::update");
+        const std::vector<int> tiles = src.tilesChangedSince(synced);
+        synced = src.checkpoint();
+        for(int t : tiles) partials[t] = tileStats(t/src.numTileCols(), t%src.numTileCols());
+        // in tile order whatever changed, so the floating-point sums come out the same every time
+        total = Partial();
+        for(const Partial& p : partials)
+            for(int k = 0; k < C; ++k)
+            {
+                total.sum[k] += p.sum[k];
+                total.lo[k] = std::min(total.lo[k], p.lo[k]);
+                total.hi[k] = std::max(total.hi[k], p.hi[k]);
+            }
+        return static_cast<int>(tiles.size());
+    }
+
+    double sum(int channel = 0) const { return total.sum[channel]; }
+    double mean(int channel = 0) const { return src.nRows*src.nCols == 0 ? 0.0 : total.sum[channel]/(double(src.nRows)*src.nCols); }
+    double min(int channel = 0) const { return total.lo[channel]; }
+    double max(int channel = 0) const { return total.hi[channel]; }
+
+private:
+    struct Partial
+    {
+        double sum[C], lo[C], hi[C];
+
+        Partial()
+        {
+            std::fill(sum, sum + C, 0.0);
+            std::fill(lo, lo + C, std::numeric_limits<double>::infinity());
+            std::fill(hi, hi + C, -std::numeric_limits<double>::infinity());
+        }
+    };
+
+    const TrackedMatrix<T>& src;
+    std::vector<Partial> partials;
+    Partial total;
+    uint64_t synced = 0;
+
+    Partial tileStats(int tileRow, int tileCol) const
+    {
+        const Matrix<T>& in = src.matrix();
+        const int ts = src.tileSize();
+        const int r0 = tileRow*ts, r1 = std::min(r0 + ts, in.nRows);
+        const int c0 = tileCol*ts, c1 = std::min(c0 + ts, in.nCols);
+        Partial p;
+        for(int i = r0; i < r1; ++i)
+        {
+            const T* px = in.mem + static_cast<size_t>(i)*in.nCols;
+            for(int j = c0; j < c1; ++j)
+                for(int k = 0; k < C; ++k)
+                {
+                    const double v = tracked_detail::channel(px[j], k);
+                    p.sum[k] += v;
+                    p.lo[k] = std::min(p.lo[k], v);
+                    p.hi[k] = std::max(p.hi[k], v);
+                }
+        }
+        return p;
+    }
+};
+
+#endif
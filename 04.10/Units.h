@@ -0,0 +1,154 @@
+#ifndef __Units_h
+#define __Units_h
+
+// Compile-time physical units: a Quantity is one number (in SI base units)
+// tagged with the exponents of length, mass and time. The tag only exists
+// for the type checker, so a Quantity<...> is laid out, passed and
+// vectorized exactly like the bare double inside it.
+//
+//     using namespace units::literals;
+//     auto g = 9.81_ms2;                      // Acceleration, as in 03.06 but with arithmetic
+//     auto t = 1.5_s;
+//     auto v = g*t;                           // Velocity
+//     Length d = v*t/2.0;                     // Length = Velocity*Time, checked at compile time
+//     // Length bad = v;                      // error: dimensions differ
+//     double km = d.in(1.0_km);               // value in another unit
+//
+// Literals convert to SI when they are constructed, and they are constexpr,
+// so 90.0_kmh or 3.0_min is folded to a constant: there is nothing left to
+// convert at run time.
+
+#include <ratio>
+#include <type_traits>
+
+namespace units
+{
+    // exponents of length (m), mass (kg) and time (s)
+    template<int L, int M, int T>
+    struct Dim
+    {
+        static constexpr int length = L, mass = M, time = T;
+    };
+
+    template<typename A, typename B>
+    using DimProduct = Dim<A::length + B::length, A::mass + B::mass, A::time + B::time>;
+
+    template<typename A, typename B>
+    using DimQuotient = Dim<A::length - B::length, A::mass - B::mass, A::time - B::time>;
+
+    using Scalar = Dim<0, 0, 0>;
+
+    template<typename D, typename Rep = double>
+    class Quantity
+    {
+        Rep v;
+
+    public:
+        using dim = D;
+        using rep = Rep;
+
+        constexpr Quantity() : v(0) { }
+        // the value in SI base units
+        constexpr explicit Quantity(Rep si) : v(si) { }
+
+        constexpr Rep value() const { return v; }
+
+        // value expressed in `unit`, e.g. d.in(1.0_km)
+        constexpr Rep in(Quantity unit) const { return v/unit.v; }
+
+        constexpr Quantity operator-() const { return Quantity(-v); }
+        constexpr Quantity& operator+=(Quantity o) { v += o.v; return *this; }
+        constexpr Quantity& operator-=(Quantity o) { v -= o.v; return *this; }
+        constexpr Quantity& operator*=(Rep s) { v *= s; return *this; }
+        constexpr Quantity& operator/=(Rep s) { v /= s; return *this; }
+
+        friend constexpr Quantity operator+(Quantity a, Quantity b) { return Quantity(a.v + b.v); }
+        friend constexpr Quantity operator-(Quantity a, Quantity b) { return Quantity(a.v - b.v); }
+        friend constexpr Quantity operator*(Quantity a, Rep s) { return Quantity(a.v*s); }
+        friend constexpr Quantity operator*(Rep s, Quantity a) { return Quantity(s*a.v); }
+        friend constexpr Quantity operator/(Quantity a, Rep s) { return Quantity(a.v/s); }
+
+        friend constexpr bool operator==(Quantity a, Quantity b) { return a.v == b.v; }
+        friend constexpr bool operator!=(Quantity a, Quantity b) { return a.v != b.v; }
+        friend constexpr bool operator<(Quantity a, Quantity b) { return a.v < b.v; }
+        friend constexpr bool operator<=(Quantity a, Quantity b) { return a.v <= b.v; }
+        friend constexpr bool operator>(Quantity a, Quantity b) { return a.v > b.v; }
+        friend constexpr bool operator>=(Quantity a, Quantity b) { return a.v >= b.v; }
+    };
+
+    // when the dimensions cancel out (1.0_km/1.0_m) the result is a plain number
+    template<typename D, typename Rep>
+    using QuantityOrRep = std::conditional_t<std::is_same<D, Scalar>::value, Rep, Quantity<D, Rep>>;
+
+    template<typename A, typename B, typename Rep>
+    constexpr QuantityOrRep<DimProduct<A, B>, Rep> operator*(Quantity<A, Rep> a, Quantity<B, Rep> b)
+    {
+        return QuantityOrRep<DimProduct<A, B>, Rep>(a.value()*b.value());
+    }
+
+    template<typename A, typename B, typename Rep>
+    constexpr QuantityOrRep<DimQuotient<A, B>, Rep> operator/(Quantity<A, Rep> a, Quantity<B, Rep> b)
+    {
+        return QuantityOrRep<DimQuotient<A, B>, Rep>(a.value()/b.value());
+    }
+
+    template<typename D, typename Rep>
+    constexpr Quantity<DimQuotient<Scalar, D>, Rep> operator/(Rep s, Quantity<D, Rep> a)
+    {
+        return Quantity<DimQuotient<Scalar, D>, Rep>(s/a.value());
+    }
+
+    // zero cost only holds if the wrapper really is just the double
+    static_assert(sizeof(Quantity<Dim<1, 0, 0>>) == sizeof(double), "Quantity must not add storage");
+    static_assert(std::is_trivially_copyable<Quantity<Dim<1, 0, 0>>>::value, "Quantity must copy like a double");
+    static_assert(std::is_standard_layout<Quantity<Dim<1, 0, 0>>>::value, "Quantity must be laid out like a double");
+
+    using Length       = Quantity<Dim<1, 0, 0>>;
+    using Mass         = Quantity<Dim<0, 1, 0>>;
+    using Time         = Quantity<Dim<0, 0, 1>>;
+    using Frequency    = Quantity<Dim<0, 0, -1>>;
+    using Area         = Quantity<Dim<2, 0, 0>>;
+    using Velocity     = Quantity<Dim<1, 0, -1>>;
+    using Acceleration = Quantity<Dim<1, 0, -2>>;
+    using Force        = Quantity<Dim<1, 1, -2>>;
+    using Energy       = Quantity<Dim<2, 1, -2>>;
+    using Power        = Quantity<Dim<2, 1, -3>>;
+
+    // Q from a literal in a unit that is Ratio times the SI unit, folded at compile time
+    template<typename Q, typename Ratio = std::ratio<1>>
+    constexpr Q fromUnit(long double value)
+    {
+        return Q(static_cast<typename Q::rep>(value*Ratio::num/Ratio::den));
+    }
+
+    namespace literals
+    {
+        using KilometrePerHour = std::ratio<1000, 3600>;
+
+#define UNITS_LITERAL(suffix, Q, Ratio)                                                                     \
+        constexpr Q operator"" suffix(long double v) { return fromUnit<Q, Ratio>(v); }                      \
+        constexpr Q operator"" suffix(unsigned long long v) { return fromUnit<Q, Ratio>(static_cast<long double>(v)); }
+
+        UNITS_LITERAL(_m,   Length, std::ratio<1>)
+        UNITS_LITERAL(_km,  Length, std::kilo)
+        UNITS_LITERAL(_cm,  Length, std::centi)
+        UNITS_LITERAL(_mm,  Length, std::milli)
+        UNITS_LITERAL(_kg,  Mass, std::ratio<1>)
+        UNITS_LITERAL(_g,   Mass, std::milli)
+        UNITS_LITERAL(_s,   Time, std::ratio<1>)
+        UNITS_LITERAL(_ms,  Time, std::milli)
+        UNITS_LITERAL(_min, Time, std::ratio<60>)
+        UNITS_LITERAL(_h,   Time, std::ratio<3600>)
+        UNITS_LITERAL(_Hz,  Frequency, std::ratio<1>)
+        UNITS_LITERAL(_mps, Velocity, std::ratio<1>)
+        UNITS_LITERAL(_kmh, Velocity, KilometrePerHour)
+        UNITS_LITERAL(_ms2, Acceleration, std::ratio<1>)
+        UNITS_LITERAL(_N,   Force, std::ratio<1>)
+        UNITS_LITERAL(_J,   Energy, std::ratio<1>)
+        UNITS_LITERAL(_W,   Power, std::ratio<1>)
+
+#undef UNITS_LITERAL
+    }
+}
+
+#endif
@@ -0,0 +1,206 @@
+#ifndef __Bench_h
+#define __Bench_h
+
+// Dependency-free microbenchmark harness.
+//
+//     int main(int argc, char* argv[]) {
+//         bench::Runner run(argc, argv);
+//         run("matrix/copy", [&] { Matrix<float> c(m); bench::doNotOptimize(c.mem); });
+//         return run.finish();
+//     }
+//
+// Each benchmark is calibrated so one sample takes at least --min-sample-ms,
+// then runs --warmup samples that are thrown away and --reps samples that are
+// kept. Reported per operation: median, p99 (nearest rank), min and mean.
+//
+// Command line:
+//     --filter=<substring>   only run benchmarks whose name contains it
+//     --reps=N --warmup=N --min-sample-ms=X
+//     --json=<path>          also write all results as JSON
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace bench
+{
+    // keep the compiler from optimizing a result (or the work producing it) away
+    template<typename T>
+    inline void doNotOptimize(const T& value)
+    {
+#if defined(__GNUC__)
+        asm volatile("" : : "r,m"(value) : "memory");
+#else
+        static volatile const T* sink;
+        sink = &value;
+#endif
+    }
+
+    // pretend all memory was read and written
+    inline void clobberMemory()
+    {
+#if defined(__GNUC__)
+        asm volatile("" : : : "memory");
+#endif
+    }
+
+    struct Result
+    {
+        std::string name;
+        size_t itemsPerOp = 1;          // e.g. elements touched per call, for the per-item column
+        size_t opsPerSample = 1;
+        std::vector<double> nsPerOp;    // one entry per kept sample, sorted
+        double median = 0, p99 = 0, min = 0, mean = 0;
+    };
+
+    class Runner
+    {
+        using clock = std::chrono::steady_clock;
+
+        std::string filter, jsonPath;
+        int reps = 30, warmup = 3;
+        double minSampleMs = 2.0;
+        std::deque<Result> results;     // deque: pointers handed out stay valid
+
+        static bool flag(const char* arg, const char* name, const char*& value)
+        {
+            size_t n = std::strlen(name);
+            if(std::strncmp(arg, name, n) != 0 || arg[n] != '=') return false;
+            value = arg + n + 1;
+            return true;
+        }
+
+        template<typename FUNC>
+        static double timeOps(FUNC& func, size_t ops)
+        {
+            auto start = clock::now();
+            for(size_t i = 0; i < ops; ++i) func();
+            std::chrono::duration<double, std::nano> took = clock::now() - start;
+            return took.count();
+        }
+
+        const Result* keep(Result r)
+        {
+            std::sort(r.nsPerOp.begin(), r.nsPerOp.end());
+            size_t n = r.nsPerOp.size();
+            r.median = n % 2 ? r.nsPerOp[n/2] : 0.5*(r.nsPerOp[n/2 - 1] + r.nsPerOp[n/2]);
+            r.p99 = r.nsPerOp[std::min(n - 1, static_cast<size_t>(0.99*n + 0.999999) - 1)];
+            r.min = r.nsPerOp.front();
+            for(double v : r.nsPerOp) r.mean += v/n;
+
+            print(r);
+            results.push_back(std::move(r));
+            return &results.back();
+        }
+
+    public:
+        Runner(int argc, char* argv[])
+        {
+            for(int i = 1; i < argc; ++i)
+            {
+                const char* v = nullptr;
+                if(flag(argv[i], "--filter", v)) filter = v;
+                else if(flag(argv[i], "--json", v)) jsonPath = v;
+                else if(flag(argv[i], "--reps", v)) reps = std::max(1, std::atoi(v));
+                else if(flag(argv[i], "--warmup", v)) warmup = std::max(0, std::atoi(v));
+                else if(flag(argv[i], "--min-sample-ms", v)) minSampleMs = std::atof(v);
+                else std::cout << "ignoring unknown argument " << argv[i] << std::endl;
+            }
+        }
+
+        bool enabled(const std::string& name) const
+        {
+            return filter.empty() || name.find(filter) != std::string::npos;
+        }
+
+        // Runs `func` repeatedly; returns the result (or nullptr when filtered out).
+        template<typename FUNC>
+        const Result* operator()(const std::string& name, FUNC&& func, size_t itemsPerOp = 1)
+        {
+            if(!enabled(name)) return nullptr;
+
+            // calibrate: double the batch until one sample is long enough to time reliably
+            size_t ops = 1;
+            while(ops < (size_t(1) << 30) && timeOps(func, ops) < minSampleMs*1e6) ops *= 2;
+
+            for(int i = 0; i < warmup; ++i) timeOps(func, ops);
+
+            Result r;
+            r.name = name;
+            r.itemsPerOp = itemsPerOp;
+            r.opsPerSample = ops;
+            for(int i = 0; i < reps; ++i) r.nsPerOp.push_back(timeOps(func, ops)/ops);
+
+            return keep(std::move(r));
+        }
+
+        // Same, but `setup` runs before every call and is not timed, for operations that
+        // consume their input (moves, sorts in place). Only one call per sample then.
+        template<typename SETUP, typename FUNC>
+        const Result* withSetup(const std::string& name, SETUP&& setup, FUNC&& func, size_t itemsPerOp = 1)
+        {
+            if(!enabled(name)) return nullptr;
+            Result r;
+            r.name = name;
+            r.itemsPerOp = itemsPerOp;
+            for(int i = 0; i < warmup + reps; ++i)
+            {
+                setup();
+                auto start = clock::now();
+                func();
+                std::chrono::duration<double, std::nano> took = clock::now() - start;
+                if(i >= warmup) r.nsPerOp.push_back(took.count());
+            }
+            return keep(std::move(r));
+        }
+
+        static void print(const Result& r)
+        {
+            char line[256];
+            std::snprintf(line, sizeof(line), "%-44s median %12.1f ns   p99 %12.1f ns   min %12.1f ns",
+                          r.name.c_str(), r.median, r.p99, r.min);
+            std::cout << line;
+            if(r.itemsPerOp > 1)
+            {
+                std::snprintf(line, sizeof(line), "   %8.3f ns/item", r.median/r.itemsPerOp);
+                std::cout << line;
+            }
+            std::cout << std::endl;
+        }
+
+        const std::deque<Result>& all() const { return results; }
+
+        // writes the JSON file if one was asked for; returns an exit code for main()
+        int finish() const
+        {
+            if(jsonPath.empty()) return 0;
+            std::ofstream out(jsonPath);
+            if(!out)
+            {
+                std::cout << "cannot write " << jsonPath << std::endl;
+                return 1;
+            }
+            out << "{\n  \"benchmarks\": [\n";
+            for(size_t i = 0; i < results.size(); ++i)
+            {
+                const Result& r = results[i];
+                out << "    {\"name\": \"" << r.name << "\", \"items_per_op\": " << r.itemsPerOp
+                    << ", \"ops_per_sample\": " << r.opsPerSample << ", \"samples\": " << r.nsPerOp.size()
+                    << ", \"median_ns\": " << r.median << ", \"p99_ns\": " << r.p99
+                    << ", \"min_ns\": " << r.min << ", \"mean_ns\": " << r.mean << "}"
+                    << (i + 1 < results.size() ? "," : "") << "\n";
+            }
+            out << "  ]\n}\n";
+            return 0;
+        }
+    };
+}
+
+#endif
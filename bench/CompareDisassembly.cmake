@@ -0,0 +1,36 @@
+# Fails unless two functions of an executable disassemble to the same
+# instructions (addresses and branch targets aside).
+#
+#   cmake -DOBJDUMP=objdump -DBINARY=bench_units -DFIRST=units_step_raw -DSECOND=units_step_quantity
+#         -P CompareDisassembly.cmake
+
+function(disassemble symbol out)
+    execute_process(COMMAND ${OBJDUMP} -d --no-show-raw-insn --no-addresses --disassemble=${symbol} ${BINARY}
+                    OUTPUT_VARIABLE text RESULT_VARIABLE failed)
+    if(failed)
+        message(FATAL_ERROR "${OBJDUMP} failed on ${BINARY}")
+    endif()
+    # keep only the instructions, with branch targets (<symbol+0x..>) and hex addresses dropped
+    string(REGEX MATCHALL "\n[ \t]+[a-z][^\n]*" lines "${text}")
+    set(result)
+    foreach(line IN LISTS lines)
+        string(REGEX REPLACE "[ \t]*<[^>]*>" "" line "${line}")
+        string(REGEX REPLACE "^[\n \t]+[0-9a-f]+ " "" line "${line}")
+        string(STRIP "${line}" line)
+        list(APPEND result "${line}")
+    endforeach()
+    set(${out} "${result}" PARENT_SCOPE)
+endfunction()
+
+disassemble(${FIRST} first)
+disassemble(${SECOND} second)
+list(LENGTH first count)
+if(count EQUAL 0)
+    message(FATAL_ERROR "${FIRST} not found in ${BINARY}")
+endif()
+if(NOT first STREQUAL second)
+    string(REPLACE ";" "\n" a "${first}")
+    string(REPLACE ";" "\n" b "${second}")
+    message(FATAL_ERROR "${FIRST} and ${SECOND} differ\n--- ${FIRST}\n${a}\n--- ${SECOND}\n${b}")
+endif()
+message(STATUS "${FIRST} and ${SECOND}: identical ${count} instructions")
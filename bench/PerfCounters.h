@@ -0,0 +1,213 @@
+#ifndef __PerfCounters_h
+#define __PerfCounters_h
+
+// Scoped hardware performance counters (Linux perf_event_open).
+//
+//     perf::Profiler prof;
+//     {
+//         perf::Scope scope(prof, "matmul avx2", n*n);   // elements processed
+//         multiply(a, b, c);
+//     }
+//     prof.report();   // cycles, instructions, IPC, cache/branch misses per element
+//
+// Counts cycles, instructions, cache, branch and dTLB load misses of the calling
+// thread in user space, aggregated per region name. When the counters cannot
+// be opened (not Linux, no PMU in the VM, perf_event_paranoid too strict)
+// everything still works and the report only has wall time.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <stdint.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace perf
+{
+    enum Counter { CYCLES, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES, DTLB_MISSES, NUM_COUNTERS };
+
+    inline const char* counterName(int c)
+    {
+        static const char* names[NUM_COUNTERS] = {"cycles", "instructions", "cache-misses", "branch-misses", "dTLB-load-misses"};
+        return names[c];
+    }
+
+    // one file descriptor per counter, each enabled for the life of the object
+    class Counters
+    {
+        int fds[NUM_COUNTERS];
+
+#if defined(__linux__)
+        static int open(uint32_t type, uint64_t config)
+        {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = type;
+            attr.config = config;
+            attr.exclude_kernel = 1;        // allowed at the default perf_event_paranoid level
+            attr.exclude_hv = 1;
+            // time enabled/running let us scale when the kernel multiplexes counters
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+        }
+#endif
+
+    public:
+        Counters()
+        {
+            for(int& fd : fds) fd = -1;
+#if defined(__linux__)
+            const uint64_t configs[NUM_COUNTERS - 1] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+            for(int c = 0; c < NUM_COUNTERS - 1; ++c)
+                fds[c] = open(PERF_TYPE_HARDWARE, configs[c]);
+            fds[DTLB_MISSES] = open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                                                        PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+#endif
+        }
+
+        Counters(const Counters&) = delete;
+        void operator=(const Counters&) = delete;
+
+        ~Counters()
+        {
+#if defined(__linux__)
+            for(int fd : fds)
+                if(fd >= 0) close(fd);
+#endif
+        }
+
+        bool available(int c) const { return fds[c] >= 0; }
+
+        bool anyAvailable() const
+        {
+            for(int c = 0; c < NUM_COUNTERS; ++c)
+                if(available(c)) return true;
+            return false;
+        }
+
+        // current (multiplexing-scaled) value of every counter, 0 for unavailable ones
+        void read(uint64_t values[NUM_COUNTERS]) const
+        {
+            for(int c = 0; c < NUM_COUNTERS; ++c)
+            {
+                values[c] = 0;
+#if defined(__linux__)
+                uint64_t buf[3];    // value, time enabled, time running
+                if(fds[c] < 0 || ::read(fds[c], buf, sizeof(buf)) != sizeof(buf)) continue;
+                values[c] = buf[2] == 0 || buf[2] == buf[1] ? buf[0]
+                          : static_cast<uint64_t>(double(buf[0])*buf[1]/buf[2]);
+#endif
+            }
+        }
+
+        // the counters of the calling thread, opened on first use
+        static const Counters& forThisThread()
+        {
+            thread_local Counters counters;
+            return counters;
+        }
+    };
+
+    struct Region
+    {
+        uint64_t calls = 0;
+        uint64_t elements = 0;
+        double ns = 0;
+        uint64_t counts[NUM_COUNTERS] = {};
+    };
+
+    class Profiler
+    {
+        std::map<std::string, Region> regions;     // sorted by name in the report
+
+    public:
+        void add(const std::string& name, uint64_t elements, double ns, const uint64_t counts[NUM_COUNTERS])
+        {
+            Region& r = regions[name];
+            ++r.calls;
+            r.elements += elements;
+            r.ns += ns;
+            for(int c = 0; c < NUM_COUNTERS; ++c) r.counts[c] += counts[c];
+        }
+
+        const std::map<std::string, Region>& all() const { return regions; }
+        void reset() { regions.clear(); }
+
+        void report(std::ostream& out = std::cout) const
+        {
+            const Counters& counters = Counters::forThisThread();
+            if(!counters.anyAvailable())
+                out << "(hardware counters unavailable, wall time only)" << std::endl;
+
+            char line[256];
+            std::snprintf(line, sizeof(line), "%-40s %8s %10s %9s %6s %11s %11s %11s %11s",
+                          "region", "calls", "ns/elem", "cyc/elem", "IPC", "cmiss/elem", "bmiss/elem", "dtlb/elem",
+                          "instr/elem");
+            out << line << std::endl;
+            for(auto& [name, r] : regions)
+            {
+                double elems = r.elements ? double(r.elements) : 1.0;
+                auto per = [&](int c) { return counters.available(c) ? r.counts[c]/elems : -1.0; };
+                double ipc = counters.available(CYCLES) && counters.available(INSTRUCTIONS) && r.counts[CYCLES]
+                           ? double(r.counts[INSTRUCTIONS])/r.counts[CYCLES] : -1.0;
+                std::snprintf(line, sizeof(line), "%-40s %8llu %10.3f %9.3f %6.2f %11.5f %11.5f %11.5f %11.3f",
+                              name.c_str(), static_cast<unsigned long long>(r.calls), r.ns/elems,
+                              per(CYCLES), ipc, per(CACHE_MISSES), per(BRANCH_MISSES), per(DTLB_MISSES),
+                              per(INSTRUCTIONS));
+                out << line << std::endl;
+            }
+            out << "(-1 = counter not available)" << std::endl;
+        }
+    };
+
+    // RAII region: counts from construction to destruction into `profiler`
+    class Scope
+    {
+        Profiler& profiler;
+        std::string name;
+        uint64_t elements;
+        uint64_t start[NUM_COUNTERS];
+        std::chrono::steady_clock::time_point startTime;
+
+    public:
+        Scope(Profiler& profiler, std::string name, uint64_t elements = 1)
+            : profiler(profiler), name(std::move(name)), elements(elements)
+        {
+            Counters::forThisThread().read(start);
+            startTime = std::chrono::steady_clock::now();
+        }
+
+        Scope(const Scope&) = delete;
+        void operator=(const Scope&) = delete;
+
+        ~Scope()
+        {
+            auto endTime = std::chrono::steady_clock::now();
+            uint64_t end[NUM_COUNTERS];
+            Counters::forThisThread().read(end);
+            for(int c = 0; c < NUM_COUNTERS; ++c) end[c] -= start[c];
+            std::chrono::duration<double, std::nano> took = endTime - startTime;
+            profiler.add(name, elements, took.count(), end);
+        }
+    };
+
+    // runs func() `calls` times inside one region, counting `elementsPerCall` each time
+    template<typename FUNC>
+    void profile(Profiler& profiler, const std::string& name, uint64_t elementsPerCall, int calls, FUNC&& func)
+    {
+        Scope scope(profiler, name, elementsPerCall*calls);
+        for(int i = 0; i < calls; ++i) func();
+    }
+}
+
+#endif
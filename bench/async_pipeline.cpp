@@ -0,0 +1,120 @@
+// End-to-end frames/s of load PPM -> gray -> 5x5 blur -> write PGM:
+//
+//   sequential    one thread, one frame at a time
+//   pipeline      coroutine pipeline (Async.h): loads and writes awaited on a
+//                 2-thread I/O pool, conversion and blur on the compute pool,
+//                 at most 4 frames queued between stages
+//
+// Every output is read back and compared with the sequential result.
+// Needs C++20 (the target is built with it, the rest of the tree is C++17).
+//
+//   bench_async_pipeline [frames, default 48]
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "Async.h"
+#include "ImageIO.h"
+#include "Kernels.h"
+
+using namespace std;
+
+const int ROWS = 720, COLS = 1280;
+
+string inputPath(int i) { return "async_pipeline_in" + to_string(i) + ".ppm"; }
+string outputPath(int i) { return "async_pipeline_out" + to_string(i) + ".pgm"; }
+
+Matrix<float> boxKernel()
+{
+    Matrix<float> k(5, 5);
+    for(auto& w : k) w = 1.f/25;
+    return k;
+}
+
+Matrix<uint8_t> process(const Image& img, const Matrix<float>& kernel)
+{
+    Matrix<uint8_t> gray;
+    toGray(img, gray);
+    Matrix<float> in(gray.nRows, gray.nCols), blurred;
+    std::copy(gray.begin(), gray.end(), in.begin());
+    convolve(in, kernel, blurred);
+    for(size_t i = 0; i < gray.numElements(); ++i) gray.mem[i] = static_cast<uint8_t>(blurred.mem[i] + 0.5f);
+    return gray;
+}
+
+struct Frame
+{
+    int index;
+    Image img;
+};
+
+struct GrayFrame
+{
+    int index;
+    Matrix<uint8_t> gray;
+};
+
+void report(const char* name, int frames, chrono::steady_clock::time_point start)
+{
+    chrono::duration<double> took = chrono::steady_clock::now() - start;
+    printf("%-12s %8.1f frames/s  (%.3f s)\n", name, frames/took.count(), took.count());
+}
+
+int
+main(int argc, char* argv[]) {
+    int frames = argc > 1 ? atoi(argv[1]) : 48;
+    const Matrix<float> kernel = boxKernel();
+
+    for(int i = 0; i < frames; ++i)
+    {
+        Image img(ROWS, COLS);
+        for(int r = 0; r < ROWS; ++r)
+            for(int c = 0; c < COLS; ++c)
+                img(r, c) = Color(uint8_t(r*3 + i), uint8_t(c + i), uint8_t((r ^ c) + i));
+        writePNM(inputPath(i), img);
+    }
+
+    vector<Matrix<uint8_t>> expected(frames);
+    auto start = chrono::steady_clock::now();
+    for(int i = 0; i < frames; ++i)
+    {
+        expected[i] = process(readPPM(inputPath(i)), kernel);
+        writePNM(outputPath(i), expected[i]);
+    }
+    report("sequential", frames, start);
+
+    ThreadPool compute, io(2);
+    vector<int> indices(frames);
+    for(int i = 0; i < frames; ++i) indices[i] = i;
+    atomic<int> written{0};
+
+    start = chrono::steady_clock::now();
+    pipeline<int>(compute, 4)
+        .source(indices)
+        .stage([&](int i) -> Task<Frame> {
+            Image img = co_await loadPPMAsync(io, inputPath(i));
+            co_return Frame{i, std::move(img)};
+        }, 2)
+        .stage([&](Frame f) { return GrayFrame{f.index, process(f.img, kernel)}; }, compute.size())
+        .sink([&](GrayFrame g) -> Task<void> {
+            co_await savePNMAsync(io, outputPath(g.index), std::move(g.gray));
+            ++written;
+        }, 2)
+        .run();
+    report("pipeline", frames, start);
+
+    int bad = frames - written.load();
+    for(int i = 0; i < frames; ++i)
+    {
+        auto got = readPNM<uint8_t>(outputPath(i));
+        bad += !std::equal(got.begin(), got.end(), expected[i].begin(), expected[i].end());
+        std::remove(inputPath(i).c_str());
+        std::remove(outputPath(i).c_str());
+    }
+    printf("%d threads compute, 2 I/O, %d bad frames\n", compute.size(), bad);
+    return bad ? 1 : 0;
+}
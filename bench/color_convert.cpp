@@ -0,0 +1,117 @@
+// Color-space conversions of Kernels.h: RGB <-> Gray, YUV 4:2:0, HSV.
+//
+// Each one is timed per ISA variant, next to a per-pixel float
+// implementation (what callers wrote before these kernels existed), and
+// reported in megapixels/s. tests/color_convert.cpp checks them against a
+// double-precision reference, which is where the error bounds documented
+// in Kernels.h come from.
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+
+#include "Bench.h"
+#include "Kernels.h"
+
+using namespace std;
+
+namespace reference
+{
+    int round8(double x) { return static_cast<int>(std::floor(std::min(std::max(x, 0.0), 255.0) + 0.5)); }
+
+    double luma(double r, double g, double b) { return 0.299*r + 0.587*g + 0.114*b; }
+    double cb(double r, double g, double b) { return -0.168736*r - 0.331264*g + 0.5*b + 128; }
+    double cr(double r, double g, double b) { return 0.5*r - 0.418688*g - 0.081312*b + 128; }
+
+    // hue in 1/256 turns, saturation and value 0..255, unrounded
+    void hsv(int r, int g, int b, double& h, double& s, double& v)
+    {
+        const int mx = max(r, max(g, b)), mn = min(r, min(g, b));
+        const double d = mx - mn;
+        v = mx;
+        s = mx ? 255.0*d/mx : 0.0;
+        if(d == 0) { h = 0; return; }
+        double sixths = mx == r ? (g - b)/d : mx == g ? 2 + (b - r)/d : 4 + (r - g)/d;
+        h = std::fmod(sixths*256/6 + 256, 256);
+    }
+}
+
+// the scalar per-pixel float code the kernels replace
+namespace perPixel
+{
+    void toYuv420(const Image& img, Yuv420& yuv)
+    {
+        for(int i = 0; i < img.nRows; ++i)
+            for(int j = 0; j < img.nCols; ++j)
+            {
+                const Color c = img.unchecked(i, j);
+                yuv.y.unchecked(i, j) = static_cast<uint8_t>(reference::round8(reference::luma(c.r, c.g, c.b)));
+            }
+        for(int i = 0; i < yuv.u.nRows; ++i)
+            for(int j = 0; j < yuv.u.nCols; ++j)
+            {
+                float r = 0, g = 0, b = 0;
+                for(int k = 0; k < 4; ++k)
+                {
+                    const Color c = img.unchecked(min(2*i + k/2, img.nRows - 1), min(2*j + k%2, img.nCols - 1));
+                    r += c.r/4.f, g += c.g/4.f, b += c.b/4.f;
+                }
+                yuv.u.unchecked(i, j) = static_cast<uint8_t>(reference::round8(reference::cb(r, g, b)));
+                yuv.v.unchecked(i, j) = static_cast<uint8_t>(reference::round8(reference::cr(r, g, b)));
+            }
+    }
+
+    void toHsv(const Image& img, Matrix<Hsv>& hsv)
+    {
+        for(size_t i = 0; i < img.numElements(); ++i)
+        {
+            double h, s, v;
+            reference::hsv(img.mem[i].r, img.mem[i].g, img.mem[i].b, h, s, v);
+            hsv.mem[i] = Hsv(static_cast<uint8_t>(reference::round8(h) & 255), static_cast<uint8_t>(reference::round8(s)),
+                             static_cast<uint8_t>(v));
+        }
+    }
+}
+
+void printRate(const bench::Result* r)
+{
+    if(r) printf("    %.1f megapixels/s\n", 1e3*r->itemsPerOp/r->median);
+}
+
+int
+main(int argc, char* argv[]) {
+    bench::Runner run(argc, argv);
+
+    const int ROWS = 1080, COLS = 1920;
+    const size_t pixels = size_t(ROWS)*COLS;
+    mt19937 gen(7);
+    Image img(ROWS, COLS), back(ROWS, COLS);
+    for(auto& px : img) px = Color(gen() & 0xff, gen() & 0xff, gen() & 0xff);
+    Matrix<uint8_t> gray(ROWS, COLS);
+    Matrix<Hsv> hsv(ROWS, COLS);
+    Yuv420 yuv;
+    toYuv420(img, yuv);
+
+    printRate(run("color/per-pixel float toYuv420 1080p", [&] { perPixel::toYuv420(img, yuv); bench::clobberMemory(); }, pixels));
+    printRate(run("color/per-pixel float toHsv 1080p", [&] { perPixel::toHsv(img, hsv); bench::clobberMemory(); }, pixels));
+
+    for(cpu::Isa isa : cpu::allIsas)
+    {
+        if(isa > cpu::detectIsa()) break;
+        const KernelTable& k = kernelsFor(isa);
+        const string tag = string(" ") + cpu::isaName(isa);
+        printRate(run("color/toGray" + tag, [&] { k.rgbToGray(img.mem, gray.mem, pixels); bench::clobberMemory(); }, pixels));
+        printRate(run("color/toYuv420" + tag, [&] {
+            k.rgbToYuv420(img.mem, ROWS, COLS, yuv.y.mem, yuv.u.mem, yuv.v.mem);
+            bench::clobberMemory();
+        }, pixels));
+        printRate(run("color/fromYuv420" + tag, [&] {
+            k.yuv420ToRgb(yuv.y.mem, yuv.u.mem, yuv.v.mem, ROWS, COLS, back.mem);
+            bench::clobberMemory();
+        }, pixels));
+        printRate(run("color/toHsv" + tag, [&] { k.rgbToHsv(img.mem, hsv.mem, pixels); bench::clobberMemory(); }, pixels));
+        printRate(run("color/fromHsv" + tag, [&] { k.hsvToRgb(hsv.mem, back.mem, pixels); bench::clobberMemory(); }, pixels));
+    }
+    return run.finish();
+}
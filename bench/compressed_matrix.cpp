@@ -0,0 +1,104 @@
+// CompressedMatrix (04.10/CompressedMatrix.h) on synthetic sensor data:
+//
+//   depth     640x480 Matrix<uint16_t> in mm: a floor, a wall, a box and a
+//             sphere, +-1 mm noise and zero (invalid) shadows next to the objects
+//   mask      the matching Matrix<uint8_t> segmentation mask
+//
+// For each: compression ratio, then decode throughput in GB/s of raw output
+// for a full decompress(), a row-by-row scan through the band cache, and
+// random tile access. tests/compressed_matrix.cpp checks that every path
+// gives back the original.
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Bench.h"
+#include "CompressedMatrix.h"
+
+using namespace std;
+
+const int ROWS = 480, COLS = 640;
+
+Matrix<uint16_t> makeDepth(Matrix<uint8_t>& mask, unsigned seed)
+{
+    mt19937 gen(seed);
+    uniform_int_distribution<int> noise(-1, 1);
+    Matrix<uint16_t> depth(ROWS, COLS);
+    mask.init(ROWS, COLS);
+    for(int i = 0; i < ROWS; ++i)
+        for(int j = 0; j < COLS; ++j)
+        {
+            double d = i > 300 ? 1200 + 9000.0/(i - 290) : 3500;      // floor below the horizon, then a wall
+            uint8_t label = 0;
+            if(i > 180 && i < 340 && j > 80 && j < 260)                // box
+            {
+                d = 1800 + 0.4*(j - 80);
+                label = 1;
+            }
+            const double dx = j - 460, dy = i - 240, r = 90;           // sphere
+            if(dx*dx + dy*dy < r*r)
+            {
+                d = 2200 - std::sqrt(r*r - dx*dx - dy*dy)*3;
+                label = 2;
+            }
+            // the projector's shadow: a band of invalid pixels right of each object
+            const bool shadow = (i > 180 && i < 340 && j >= 260 && j < 272) ||
+                                (dx*dx + dy*dy >= r*r && dx > 0 && dx*dx + dy*dy < (r + 10)*(r + 10));
+            depth.unchecked(i, j) = shadow ? 0 : static_cast<uint16_t>(d + noise(gen));
+            mask.unchecked(i, j) = static_cast<uint8_t>(label*120);
+        }
+    return depth;
+}
+
+void printRate(const bench::Result* r)
+{
+    if(r) printf("    %.2f GB/s decoded\n", r->itemsPerOp/r->median);
+}
+
+template<typename T>
+void measure(bench::Runner& run, const char* name, const Matrix<T>& original)
+{
+    for(int tileSize : {16, 64, 256})
+    {
+        CompressedMatrix<T> packed(original, tileSize);
+        printf("%-6s tile %3d: %zu -> %zu bytes, ratio %.2f\n", name, tileSize, packed.rawBytes(),
+               packed.compressedBytes(), packed.ratio());
+    }
+
+    CompressedMatrix<T> packed(original);
+    const string prefix = string("compressed/") + name;
+    const size_t bytes = packed.rawBytes();
+    printRate(run(prefix + " decompress", [&] { bench::doNotOptimize(packed.decompress().mem); }, bytes));
+    printRate(run(prefix + " row scan", [&] {
+        uint64_t s = 0;
+        for(int i = 0; i < packed.nRows; ++i) s += packed.row(i)[i % packed.nCols];
+        bench::doNotOptimize(s);
+    }, bytes));
+
+    mt19937 gen(3);
+    vector<pair<int, int>> order;
+    for(int k = 0; k < 64; ++k)
+        order.emplace_back(gen() % packed.numTileRows(), gen() % packed.numTileCols());
+    vector<T> tile(static_cast<size_t>(packed.tileDim())*packed.tileDim());
+    const size_t tileBytes = order.size()*tile.size()*sizeof(T);
+    printRate(run(prefix + " random tiles", [&] {
+        for(auto [tr, tc] : order) packed.decodeTile(tr, tc, tile.data(), packed.tileDim());
+        bench::clobberMemory();
+    }, tileBytes));
+    printRate(run(prefix + " uncompressed copy", [&] { Matrix<T> copy(original); bench::doNotOptimize(copy.mem); }, bytes));
+}
+
+int
+main(int argc, char* argv[]) {
+    bench::Runner run(argc, argv);
+
+    Matrix<uint8_t> mask;
+    const Matrix<uint16_t> depth = makeDepth(mask, 1);
+
+    measure(run, "depth", depth);
+    measure(run, "mask", mask);
+
+    return run.finish();
+}
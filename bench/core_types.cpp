@@ -0,0 +1,220 @@
+// Measures the performance claims the lessons make in their comments:
+//
+//   matrix/*  how Matrix constructs, copies and moves (04.10/Matrix.h)
+//   image/*   Image element access through operator(), row() and begin()/end()
+//   vec/*     dot products: plain Vec3d (03.13 Better) vs the templated Vec<3>
+//             with a VecBase vtable (03.13 EvenBetter), std::array vs C array
+//   huge/*    Huge (03.06) in std::vector reallocation, with the lesson's move
+//             ctor (not noexcept, so vector copies) and with a noexcept one
+//
+// The lesson types are copied here as they are in the lessons, minus the
+// printing: the lesson files are programs with their own main().
+
+#include <array>
+#include <numeric>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+#include "Bench.h"
+#include "Matrix.h"
+
+using namespace std;
+
+namespace lesson_03_13 {
+    struct Vec3d {
+        int x, y, z;
+        int dot_product(const Vec3d b) const { return x * b.x + y * b.y + z * b.z; }
+    };
+
+    struct VecBase {
+        virtual void print() const { }
+        virtual int dot(const VecBase& b) const = 0;
+    };
+
+    template<int nDims, typename T = int>
+    struct __attribute__((packed, aligned(1))) Vec : public VecBase {
+        array<T, nDims> values;
+
+        template<typename... Ts>
+        Vec(Ts... values) : values{values...} { }
+
+        T dot_product(const Vec<nDims, T> b) const {
+            auto sum = T{};
+            for (int i = 0; i < nDims; ++i) sum += values[i] * b.values[i];
+            return sum;
+        }
+
+        // the same product, reached through the vtable
+        int dot(const VecBase& b) const override { return dot_product(static_cast<const Vec&>(b)); }
+    };
+}
+
+namespace lesson_03_06 {
+    struct Int {
+        int value;
+        Int() : value{0} { }
+        Int(int value) : value{value} { }
+        Int(const Int& other) : value{other.value} { }
+        Int& operator=(const Int& other) = default;
+    };
+
+    // as in the lesson: the move ctor is not noexcept
+    struct Huge {
+        Int x, y;
+        std::vector<int> v;
+
+        Huge() : x{10}, y{20}, v(100) { }
+        Huge(const Huge& other) : x{other.x}, y{other.y}, v(other.v) { }
+        Huge(Huge&& other) : x{std::move(other.x)}, y{std::move(other.y)}, v(std::move(other.v)) { }
+    };
+
+    struct HugeNoexcept {
+        Int x, y;
+        std::vector<int> v;
+
+        HugeNoexcept() : x{10}, y{20}, v(100) { }
+        HugeNoexcept(const HugeNoexcept& other) : x{other.x}, y{other.y}, v(other.v) { }
+        HugeNoexcept(HugeNoexcept&& other) noexcept : x{other.x}, y{other.y}, v(std::move(other.v)) { }
+    };
+}
+
+void matrixBenchmarks(bench::Runner& run)
+{
+    const int N = 512;
+    Matrix<float> src(N, N);
+    iota(src.begin(), src.end(), 0.f);
+
+    run("matrix/construct 512x512", [&] {
+        Matrix<float> m(N, N);
+        bench::doNotOptimize(m.mem);
+    });
+    run("matrix/copy ctor 512x512", [&] {
+        Matrix<float> m(src);
+        bench::doNotOptimize(m.mem);
+    });
+    Matrix<float> dst(N, N);
+    run("matrix/copy assign 512x512", [&] {
+        dst = src;
+        bench::doNotOptimize(dst.mem);
+    });
+    run("matrix/move ctor 512x512", [&] {
+        Matrix<float> m(std::move(src));
+        src = std::move(m);             // hand the memory back for the next call
+        bench::doNotOptimize(src.mem);
+    });
+}
+
+void imageBenchmarks(bench::Runner& run)
+{
+    const int N = 1024;
+    const size_t items = size_t(N)*N;
+    Image img(N, N);
+    for(int i = 0; i < N; ++i)
+        for(int j = 0; j < N; ++j)
+            img(i, j) = Color(i & 0xff, j & 0xff, (i + j) & 0xff);
+
+    run("image/operator() sum green 1024^2", [&] {
+        uint32_t sum = 0;
+        for(int i = 0; i < img.nRows; ++i)
+            for(int j = 0; j < img.nCols; ++j)
+                sum += img(i, j).g;
+        bench::doNotOptimize(sum);
+    }, items);
+    run("image/row() sum green 1024^2", [&] {
+        uint32_t sum = 0;
+        for(int i = 0; i < img.nRows; ++i)
+            for(const Color& c : img.row(i))
+                sum += c.g;
+        bench::doNotOptimize(sum);
+    }, items);
+    run("image/begin-end sum green 1024^2", [&] {
+        uint32_t sum = 0;
+        for(const Color& c : img)
+            sum += c.g;
+        bench::doNotOptimize(sum);
+    }, items);
+    run("image/operator() column walk 1024^2", [&] {
+        uint32_t sum = 0;
+        for(int j = 0; j < img.nCols; ++j)
+            for(int i = 0; i < img.nRows; ++i)
+                sum += img(i, j).g;
+        bench::doNotOptimize(sum);
+    }, items);
+}
+
+void vecBenchmarks(bench::Runner& run)
+{
+    using namespace lesson_03_13;
+    const int COUNT = 1 << 16;
+
+    vector<Vec3d> plain;
+    vector<Vec<3>> templated;
+    for(int i = 0; i < COUNT; ++i)
+    {
+        plain.push_back({i, i + 1, i + 2});
+        templated.emplace_back(i, i + 1, i + 2);
+    }
+    vector<const VecBase*> viaBase;
+    for(auto& v : templated) viaBase.push_back(&v);
+
+    run("vec/Vec3d dot (12 B)", [&] {
+        int sum = 0;
+        for(size_t i = 1; i < plain.size(); ++i) sum += plain[i].dot_product(plain[i - 1]);
+        bench::doNotOptimize(sum);
+    }, COUNT);
+    run("vec/Vec<3> dot, vptr inline (20 B)", [&] {
+        int sum = 0;
+        for(size_t i = 1; i < templated.size(); ++i) sum += templated[i].dot_product(templated[i - 1]);
+        bench::doNotOptimize(sum);
+    }, COUNT);
+    run("vec/Vec<3> dot via VecBase* virtual", [&] {
+        int sum = 0;
+        for(size_t i = 1; i < viaBase.size(); ++i) sum += viaBase[i]->dot(*viaBase[i - 1]);
+        bench::doNotOptimize(sum);
+    }, COUNT);
+
+    constexpr int LEN = 4096;
+    int cArray[LEN];
+    array<int, LEN> stdArray;
+    for(int i = 0; i < LEN; ++i) cArray[i] = stdArray[i] = i;
+    run("vec/C array sum 4096", [&] {
+        bench::clobberMemory();
+        int sum = 0;
+        for(int i = 0; i < LEN; ++i) sum += cArray[i];
+        bench::doNotOptimize(sum);
+    }, LEN);
+    run("vec/std::array sum 4096", [&] {
+        bench::clobberMemory();
+        int sum = 0;
+        for(int v : stdArray) sum += v;
+        bench::doNotOptimize(sum);
+    }, LEN);
+}
+
+// push_back without reserve: every reallocation moves the elements if the move
+// ctor is noexcept and copies them (100 ints each) otherwise
+template<typename H>
+void growVector(int count)
+{
+    vector<H> v;
+    for(int i = 0; i < count; ++i) v.push_back(H{});
+    bench::doNotOptimize(v.data());
+}
+
+void hugeBenchmarks(bench::Runner& run)
+{
+    const int COUNT = 1000;
+    run("huge/push_back x1000, lesson move ctor", [&] { growVector<lesson_03_06::Huge>(COUNT); }, COUNT);
+    run("huge/push_back x1000, noexcept move", [&] { growVector<lesson_03_06::HugeNoexcept>(COUNT); }, COUNT);
+}
+
+int
+main(int argc, char* argv[]) {
+    bench::Runner run(argc, argv);
+    matrixBenchmarks(run);
+    imageBenchmarks(run);
+    vecBenchmarks(run);
+    hugeBenchmarks(run);
+    return run.finish();
+}
@@ -0,0 +1,95 @@
+// Incremental recomputation after small edits (04.10/TrackedMatrix.h), on a
+// 50 MP (8192x6144) Image with three derived results: a 7x7 box filter, an
+// 8x8 downsampled preview and per-channel statistics.
+//
+//   full/*         recomputing a result over the whole image: boxFilter()
+//                  from IntegralImage.h, and the incremental operators with
+//                  every tile dirty
+//   edit/*         a 16 pixel brush dab (or a stroke of 20) painted through
+//                  set(), then update(); the painting is not timed
+//   write/*        the cost of tracking itself: 1M random set()s, tracked
+//                  and on a plain Matrix
+//
+// tests/dirty_tracking.cpp checks that incremental results equal
+// boxFilter() and plain full-image loops after every edit.
+
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Bench.h"
+#include "TrackedMatrix.h"
+
+using namespace std;
+
+const int ROWS = 6144, COLS = 8192, RADIUS = 3, FACTOR = 8;
+
+int
+main(int argc, char* argv[]) {
+    bench::Runner run(argc, argv);
+
+    auto randomColor = [](mt19937& g) { return Color(g() & 0xff, g() & 0xff, g() & 0xff); };
+
+    mt19937 gen(12);
+    Image start(ROWS, COLS);
+    for(int i = 0; i < ROWS; ++i)
+        for(int j = 0; j < COLS; ++j)
+            start.unchecked(i, j) = Color(uint8_t(i + j), uint8_t(i ^ j), uint8_t(gen() & 0x3f));
+    TrackedImage img(move(start));
+    IncrementalBoxFilter<Color> blur(img, RADIUS);
+    IncrementalDownsample<Color> preview(img, FACTOR);
+    IncrementalStats<Color> stats(img);
+    blur.update();
+    preview.update();
+    stats.update();
+
+    const size_t pixels = size_t(ROWS)*COLS;
+    auto ms = [](const bench::Result* r) { if(r) printf("    %.2f ms\n", r->median*1e-6); };
+
+    // ---- full passes
+    Image full;
+    ms(run("full/boxFilter (IntegralImage.h)", [&] { boxFilter(img.matrix(), RADIUS, full); bench::clobberMemory(); }, pixels));
+    ms(run.withSetup("full/IncrementalBoxFilter, all tiles dirty", [&] { img.markAllDirty(); }, [&] { blur.update(); }, pixels));
+    ms(run.withSetup("full/IncrementalDownsample, all tiles dirty", [&] { img.markAllDirty(); }, [&] { preview.update(); }, pixels));
+    ms(run.withSetup("full/IncrementalStats, all tiles dirty", [&] { img.markAllDirty(); }, [&] { stats.update(); }, pixels));
+    // let everything catch up before the edits are timed
+    blur.update();
+    preview.update();
+    stats.update();
+
+    // ---- small edits
+    auto dab = [&](int r, int c, const Color& color) {
+        for(int y = -8; y < 8; ++y)
+            for(int x = -8; x < 8; ++x)
+                if(x*x + y*y < 64 && r + y >= 0 && r + y < ROWS && c + x >= 0 && c + x < COLS) img.set(r + y, c + x, color);
+    };
+    auto randomDab = [&] { dab(gen() % ROWS, gen() % COLS, randomColor(gen)); };
+    auto stroke = [&] {
+        const int r = gen() % ROWS, c = gen() % COLS;
+        for(int k = 0; k < 20; ++k) dab(r + 4*k, c + 12*k, Color(255, 0, 0));
+    };
+    int tiles = 0;
+    auto updateAll = [&] { tiles = blur.update() + preview.update() + stats.update(); };
+    ms(run.withSetup("edit/dab + IncrementalBoxFilter", randomDab, [&] { blur.update(); }));
+    ms(run.withSetup("edit/dab + IncrementalDownsample", randomDab, [&] { preview.update(); }));
+    ms(run.withSetup("edit/dab + IncrementalStats", randomDab, [&] { stats.update(); }));
+    ms(run.withSetup("edit/dab + all three", randomDab, updateAll));
+    printf("    %d tiles recomputed over the three\n", tiles);
+    ms(run.withSetup("edit/20 dab stroke + all three", stroke, updateAll));
+    printf("    %d tiles recomputed over the three\n", tiles);
+
+    // ---- what tracking costs a write
+    vector<pair<int, int>> where(1 << 20);
+    for(auto& w : where) w = {int(gen() % ROWS), int(gen() % COLS)};
+    Image plain(ROWS, COLS);
+    run("write/1M random set(), plain Image", [&] {
+        for(const auto& w : where) plain.unchecked(w.first, w.second) = Color(7);
+        bench::clobberMemory();
+    }, where.size());
+    run("write/1M random set(), TrackedImage", [&] {
+        for(const auto& w : where) img.set(w.first, w.second, Color(7));
+        bench::clobberMemory();
+    }, where.size());
+    return run.finish();
+}
@@ -0,0 +1,125 @@
+// Cost of the dispatch styles from the 04.24 lessons, with hardware counters:
+//
+//   crtp.cpp           virtual call through Base* (OldSchool) vs CRTP (Better)
+//   union_variant.cpp  tagged union with a type switch (Foo) vs std::visit on a std::variant
+//
+// The lessons print from every call; here the calls compute something small
+// instead so that the dispatch itself is what gets counted. Objects are
+// shuffled so the branch predictor cannot learn the pattern.
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <variant>
+#include <vector>
+
+#include "Bench.h"
+#include "PerfCounters.h"
+
+using namespace std;
+
+namespace OldSchool {
+    struct Base {
+        virtual ~Base() = default;
+        virtual int value(int x) const = 0;
+    };
+    struct Foo : public Base { int value(int x) const override { return x + 1; } };
+    struct Bar : public Base { int value(int x) const override { return x*3; } };
+}
+
+namespace Better {
+    template<typename Derived>
+    struct Base {
+        int value(int x) const { return static_cast<const Derived*>(this)->VALUE(x); }
+    };
+    struct Foo : public Base<Foo> { int VALUE(int x) const { return x + 1; } };
+    struct Bar : public Base<Bar> { int VALUE(int x) const { return x*3; } };
+}
+
+namespace Tagged {
+    union Value { int i; float f; double d; };
+    enum ValueType { INT, FLOAT, DOUBLE };
+
+    struct Foo {
+        Value value;
+        ValueType type;
+
+        explicit Foo(int v) : type{INT} { value.i = v; }
+        explicit Foo(float v) : type{FLOAT} { value.f = v; }
+        explicit Foo(double v) : type{DOUBLE} { value.d = v; }
+
+        double asDouble() const {
+            if (type == INT) return value.i;
+            else if (type == FLOAT) return value.f;
+            else return value.d;
+        }
+    };
+}
+
+int
+main(int argc, char* argv[]) {
+    bench::Runner run(argc, argv);
+    perf::Profiler prof;
+    const int COUNT = 1 << 16;
+    const int CALLS = 50;
+    mt19937 gen(7);
+
+    // crtp.cpp: with CRTP there is no common base, so the set has to be homogeneous per
+    // container; that restriction is exactly what buys the static dispatch
+    vector<unique_ptr<OldSchool::Base>> dynamic;
+    for(int i = 0; i < COUNT; ++i)
+        dynamic.push_back(i % 2 ? unique_ptr<OldSchool::Base>(new OldSchool::Foo) : unique_ptr<OldSchool::Base>(new OldSchool::Bar));
+    shuffle(dynamic.begin(), dynamic.end(), gen);
+    vector<Better::Foo> foos(COUNT/2);
+    vector<Better::Bar> bars(COUNT/2);
+
+    auto virtualCalls = [&] {
+        int acc = 0;
+        for(auto& p : dynamic) acc = p->value(acc) & 0xffff;
+        bench::doNotOptimize(acc);
+    };
+    auto crtpCalls = [&] {
+        int acc = 0;
+        for(auto& f : foos) acc = f.value(acc) & 0xffff;
+        for(auto& b : bars) acc = b.value(acc) & 0xffff;
+        bench::doNotOptimize(acc);
+    };
+
+    // union_variant.cpp
+    vector<Tagged::Foo> tagged;
+    vector<variant<int, float, double>> variants;
+    for(int i = 0; i < COUNT; ++i)
+    {
+        switch(gen() % 3)
+        {
+            case 0: tagged.emplace_back(i); variants.emplace_back(i); break;
+            case 1: tagged.emplace_back(float(i)); variants.emplace_back(float(i)); break;
+            default: tagged.emplace_back(double(i)); variants.emplace_back(double(i)); break;
+        }
+    }
+    auto taggedCalls = [&] {
+        double acc = 0;
+        for(auto& v : tagged) acc += v.asDouble();
+        bench::doNotOptimize(acc);
+    };
+    auto variantCalls = [&] {
+        double acc = 0;
+        for(auto& v : variants) acc += std::visit([](auto value) { return double(value); }, v);
+        bench::doNotOptimize(acc);
+    };
+
+    run("dispatch/virtual (crtp.cpp OldSchool)", virtualCalls, COUNT);
+    run("dispatch/crtp (crtp.cpp Better)", crtpCalls, COUNT);
+    run("dispatch/tagged union switch", taggedCalls, COUNT);
+    run("dispatch/std::visit variant", variantCalls, COUNT);
+
+    if(run.enabled("dispatch/"))
+    {
+        perf::profile(prof, "virtual (crtp.cpp OldSchool)", COUNT, CALLS, virtualCalls);
+        perf::profile(prof, "crtp (crtp.cpp Better)", COUNT, CALLS, crtpCalls);
+        perf::profile(prof, "tagged union switch", COUNT, CALLS, taggedCalls);
+        perf::profile(prof, "std::visit variant", COUNT, CALLS, variantCalls);
+        prof.report();
+    }
+    return run.finish();
+}
@@ -0,0 +1,120 @@
+// Frames per second handing 720p Images from producer to consumer threads:
+//
+//   mutex+alloc   std::queue under a std::mutex, a freshly allocated Image per frame
+//   spsc          FrameChannel<Image> (SpscQueue), buffers recycled to the producer
+//   mpmc 2x2      FrameChannel<Image, MpmcQueue>, two producers and two consumers
+//
+// Producers stamp each frame, consumers read it back, so the pixels are
+// touched on both sides as in a real pipeline.
+//
+//   bench_frame_queue [frames, default 20000]
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "FrameQueue.h"
+
+using namespace std;
+
+const int ROWS = 720, COLS = 1280;
+
+void stamp(Image& img, int n)
+{
+    img(0, 0) = Color(uint8_t(n));
+    img(ROWS - 1, COLS - 1) = Color(uint8_t(n));
+}
+
+bool check(const Image& img)
+{
+    return img(0, 0).r == img(ROWS - 1, COLS - 1).r;
+}
+
+void report(const char* name, int frames, chrono::steady_clock::time_point start, size_t allocations, long bad)
+{
+    chrono::duration<double> took = chrono::steady_clock::now() - start;
+    cout << name << ": " << frames/took.count() << " frames/s, " << allocations << " allocations, "
+         << bad << " bad frames" << endl;
+}
+
+void mutexQueue(int frames)
+{
+    mutex lock;
+    queue<Image> q;
+    atomic<long> bad{0};
+    auto start = chrono::steady_clock::now();
+    thread producer([&] {
+        for(int i = 0; i < frames; ++i)
+        {
+            Image img(ROWS, COLS);
+            stamp(img, i);
+            for(;;)
+            {
+                lock_guard<mutex> guard(lock);
+                if(q.size() < 8) { q.push(std::move(img)); break; }
+            }
+        }
+    });
+    thread consumer([&] {
+        for(int got = 0; got < frames;)
+        {
+            Image img;
+            {
+                lock_guard<mutex> guard(lock);
+                if(q.empty()) continue;
+                img = std::move(q.front());
+                q.pop();
+            }
+            bad += !check(img);
+            ++got;
+        }
+    });
+    producer.join();
+    consumer.join();
+    report("mutex+alloc", frames, start, frames, bad);
+}
+
+template<template<typename> class Queue>
+void channel(const char* name, int frames, int nProducers, int nConsumers)
+{
+    FrameChannel<Image, Queue> chan(8);
+    atomic<int> consumed{0};
+    atomic<long> bad{0};
+    auto start = chrono::steady_clock::now();
+    vector<thread> threads;
+    for(int p = 0; p < nProducers; ++p)
+        threads.emplace_back([&, p] {
+            for(int i = p; i < frames; i += nProducers)
+            {
+                Image img = chan.acquire(ROWS, COLS);
+                stamp(img, i);
+                while(!chan.send(img)) this_thread::yield();
+            }
+        });
+    for(int c = 0; c < nConsumers; ++c)
+        threads.emplace_back([&] {
+            Image img;
+            while(consumed.load() < frames)
+            {
+                if(!chan.receive(img)) { this_thread::yield(); continue; }
+                bad += !check(img);
+                ++consumed;
+                chan.recycle(img);
+            }
+        });
+    for(auto& t : threads) t.join();
+    report(name, frames, start, chan.allocations(), bad);
+}
+
+int
+main(int argc, char* argv[]) {
+    int frames = argc > 1 ? atoi(argv[1]) : 20000;
+    mutexQueue(frames);
+    channel<SpscQueue>("spsc       ", frames, 1, 1);
+    channel<MpmcQueue>("mpmc 2x2   ", frames, 2, 2);
+    return 0;
+}
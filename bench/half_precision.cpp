@@ -0,0 +1,74 @@
+// float16 / bfloat16 matrices (04.10/Half.h, Kernels.h) against float, on
+// 16M elements (64 MB as float, 32 MB at 16 bits):
+//
+//   convert/*      bulk conversion to and from float per ISA variant, in
+//                  elements per ns
+//   sum/*          reduction straight from each storage type
+//   transform/*    y = 0.5x + 1 in place, read and written in the storage type
+//
+// tests/half_precision.cpp checks every conversion kernel exhaustively (all
+// 65536 float16 patterns) and on random floats against a reference rounding.
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Bench.h"
+#include "Kernels.h"
+
+using namespace std;
+
+const int ROWS = 4096, COLS = 4096;
+
+int
+main(int argc, char* argv[]) {
+    bench::Runner run(argc, argv);
+
+    mt19937 gen(5);
+    Matrix<float> f(ROWS, COLS);
+    normal_distribution<float> normal(0.f, 100.f);
+    for(auto& v : f) v = normal(gen);
+    Matrix<float16> h;
+    Matrix<bfloat16> b;
+    convert(f, h);
+    convert(f, b);
+
+    // what 16 bits of storage cost in precision
+    {
+        double errH = 0, errB = 0;
+        for(size_t i = 0; i < f.numElements(); ++i)
+        {
+            errH = max(errH, fabs(double(h.mem[i]) - f.mem[i])/fabs(f.mem[i]));
+            errB = max(errB, fabs(double(b.mem[i]) - f.mem[i])/fabs(f.mem[i]));
+        }
+        printf("max relative storage error: float16 %.2e, bfloat16 %.2e\n", errH, errB);
+    }
+
+    const size_t n = f.numElements();
+    Matrix<float> g(ROWS, COLS);
+    auto rate = [](const bench::Result* r) { if(r) printf("    %.2f elements/ns\n", r->itemsPerOp/r->median); };
+    for(cpu::Isa isa : cpu::allIsas)
+    {
+        if(isa > cpu::detectIsa()) break;
+        const KernelTable& k = kernelsFor(isa);
+        const string tag = string(" ") + cpu::isaName(isa);
+        rate(run("convert/f16 -> float" + tag, [&] { k.halfToFloat(h.mem, g.mem, n); bench::clobberMemory(); }, n));
+        rate(run("convert/float -> f16" + tag, [&] { k.floatToHalf(f.mem, h.mem, n); bench::clobberMemory(); }, n));
+        rate(run("convert/bf16 -> float" + tag, [&] { k.bfloatToFloat(b.mem, g.mem, n); bench::clobberMemory(); }, n));
+        rate(run("convert/float -> bf16" + tag, [&] { k.floatToBfloat(f.mem, b.mem, n); bench::clobberMemory(); }, n));
+    }
+
+    rate(run("sum/float", [&] { bench::doNotOptimize(sum(f)); }, n));
+    rate(run("sum/float16", [&] { bench::doNotOptimize(sum(h)); }, n));
+    rate(run("sum/bfloat16", [&] { bench::doNotOptimize(sum(b)); }, n));
+
+    // in place, so each rep reads and writes the whole matrix once; x -> 0.5x + 1 converges, values stay finite
+    auto step = [](float x) { return 0.5f*x + 1; };
+    rate(run("transform/float", [&] { transformInFloat(g, g, step); bench::clobberMemory(); }, n));
+    rate(run("transform/float16", [&] { transformInFloat(h, h, step); bench::clobberMemory(); }, n));
+    rate(run("transform/bfloat16", [&] { transformInFloat(b, b, step); bench::clobberMemory(); }, n));
+
+    return run.finish();
+}
@@ -0,0 +1,136 @@
+// Huge page backing (04.10/HugePages.h) for a 1 GB Matrix<float>, against
+// new T[] with whatever pages the system gives it:
+//
+//   init/*         allocating and zeroing it (fewer, larger page faults)
+//   gather/*       summing 4M elements at random positions, from 8
+//                  independent index streams (throughput, many misses in flight)
+//   chase/*        the same, each position depending on the value read
+//                  before it (latency: one TLB and cache miss at a time)
+//
+// Each backing reports how much of the buffer really is on huge pages, and
+// the perf counters (bench/PerfCounters.h) report dTLB load misses per
+// access where the PMU is readable. Before timing: the buffers are 2 MB
+// aligned and zeroed, small matrices stay on ordinary memory, and every
+// backing gives the same sums.
+
+#include <cstdio>
+#include <string>
+
+#include "Bench.h"
+#include "HugePages.h"
+#include "PerfCounters.h"
+
+using namespace std;
+
+const int ROWS = 16384, COLS = 16384;
+const size_t ACCESSES = size_t(4) << 20, CHASE = size_t(1) << 20;
+
+// xorshift64*, scaled into [0, n) with a multiply-high
+struct Positions
+{
+    uint64_t state;
+
+    size_t next(size_t n)
+    {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return static_cast<size_t>((unsigned __int128)(state*0x2545f4914f6cdd1dull)*n >> 64);
+    }
+};
+
+float gather(const float* data, size_t n)
+{
+    Positions streams[8];
+    for(int s = 0; s < 8; ++s) streams[s].state = 0x9e3779b97f4a7c15ull*(s + 1);
+    float sums[8] = {};
+    for(size_t i = 0; i < ACCESSES; i += 8)
+        for(int s = 0; s < 8; ++s) sums[s] += data[streams[s].next(n)];
+    float total = 0;
+    for(float s : sums) total += s;
+    return total;
+}
+
+float chase(const float* data, size_t n)
+{
+    Positions pos{0x243f6a8885a308d3ull};
+    float sum = 0;
+    for(size_t i = 0; i < CHASE; ++i)
+    {
+        const float v = data[pos.next(n)];
+        pos.state += static_cast<uint64_t>(v);      // the next position waits for this load
+        sum += v;
+    }
+    return sum;
+}
+
+int
+main(int argc, char* argv[]) {
+    bench::Runner run(argc, argv);
+
+    const size_t n = size_t(ROWS)*COLS, bytes = n*sizeof(float);
+    const hugepages::Allocator* transparent = &hugepages::transparent();
+    const hugepages::Allocator* hugeTlb = &hugepages::hugeTlb();
+    struct Backing
+    {
+        const char* name;
+        const hugepages::Allocator* allocator;      // null: new T[]
+    };
+    const Backing backings[] = {{"new T[]", nullptr}, {"transparent", transparent}, {"hugetlb", hugeTlb}};
+
+    {
+        Matrix<float> small(100, 100, *transparent);
+        if(small.allocator != transparent || hugepages::backedBytes(small.mem, 100*100*sizeof(float)) > 0)
+        {
+            fprintf(stderr, "a matrix below the threshold should get ordinary memory\n");
+            return 1;
+        }
+    }
+
+    perf::Profiler prof;
+    float expectGather = 0, expectChase = 0;
+    for(const Backing& b : backings)
+    {
+        Matrix<float> m = b.allocator ? Matrix<float>(ROWS, COLS, *b.allocator) : Matrix<float>(ROWS, COLS);
+        for(float v : m.row(ROWS - 1))
+            if(v != 0.f)
+            {
+                fprintf(stderr, "%s: not zeroed\n", b.name);
+                return 1;
+            }
+        if(b.allocator && reinterpret_cast<uintptr_t>(m.mem) % hugepages::HUGE_PAGE != 0)
+        {
+            fprintf(stderr, "%s: not 2 MB aligned\n", b.name);
+            return 1;
+        }
+        for(size_t i = 0; i < n; ++i) m.mem[i] = float(i & 7);
+        printf("%s: %zu of %zu MB on huge pages\n", b.name, hugepages::backedBytes(m.mem, bytes) >> 20, bytes >> 20);
+
+        const float g = gather(m.mem, n), c = chase(m.mem, n);
+        if(b.allocator == nullptr)
+        {
+            expectGather = g;
+            expectChase = c;
+        }
+        else if(g != expectGather || c != expectChase)
+        {
+            fprintf(stderr, "%s: different sums than new T[]\n", b.name);
+            return 1;
+        }
+
+        const string tag = string(" ") + b.name;
+        run("gather/8 streams" + tag, [&] { bench::doNotOptimize(gather(m.mem, n)); }, ACCESSES);
+        run("chase/dependent" + tag, [&] { bench::doNotOptimize(chase(m.mem, n)); }, CHASE);
+        perf::profile(prof, "gather" + tag, ACCESSES, 3, [&] { bench::doNotOptimize(gather(m.mem, n)); });
+        perf::profile(prof, "chase" + tag, CHASE, 3, [&] { bench::doNotOptimize(chase(m.mem, n)); });
+    }
+
+    for(const Backing& b : backings)
+        run(string("init/1 GB ") + b.name, [&] {
+            Matrix<float> m = b.allocator ? Matrix<float>(ROWS, COLS, *b.allocator) : Matrix<float>(ROWS, COLS);
+            bench::doNotOptimize(m.mem);
+        }, bytes);
+
+    prof.report();
+    return run.finish();
+}
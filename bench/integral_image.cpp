@@ -0,0 +1,66 @@
+// Box filters and local statistics from summed-area tables (04.10/IntegralImage.h)
+// against rescanning every window, on a 1280x720 gray frame and Image:
+//
+//   sat/build              building the table (uint32_t accumulator)
+//   box/naive r=N          direct (2N+1)^2 window sums, cost grows with N^2
+//   box/sat r=N            table-driven, the same cost for every N
+//   box/sat Image r=N      per channel
+//   meanvar/sat r=N        mean and variance, two tables
+//
+// tests/integral_image.cpp checks the table-driven results against the naive ones.
+
+#include <cstdio>
+#include <string>
+
+#include "Bench.h"
+#include "IntegralImage.h"
+
+using namespace std;
+
+void naiveBox(const Matrix<uint8_t>& src, int radius, Matrix<uint8_t>& dst)
+{
+    dst.init(src.nRows, src.nCols);
+    for(int i = 0; i < src.nRows; ++i)
+        for(int j = 0; j < src.nCols; ++j)
+        {
+            const int r0 = max(i - radius, 0), r1 = min(i + radius + 1, src.nRows);
+            const int c0 = max(j - radius, 0), c1 = min(j + radius + 1, src.nCols);
+            uint32_t s = 0;
+            for(int r = r0; r < r1; ++r)
+                for(int c = c0; c < c1; ++c) s += src.unchecked(r, c);
+            const uint32_t count = (r1 - r0)*(c1 - c0);
+            dst.unchecked(i, j) = static_cast<uint8_t>((s + count/2)/count);
+        }
+}
+
+int
+main(int argc, char* argv[]) {
+    bench::Runner run(argc, argv);
+    const int ROWS = 720, COLS = 1280;
+
+    Matrix<uint8_t> gray(ROWS, COLS);
+    Image img(ROWS, COLS);
+    for(int i = 0; i < ROWS; ++i)
+        for(int j = 0; j < COLS; ++j)
+        {
+            gray.unchecked(i, j) = static_cast<uint8_t>((i*7) ^ (j*13));
+            img.unchecked(i, j) = Color(uint8_t(i + j), uint8_t(i*3), uint8_t(j*5));
+        }
+
+    const size_t pixels = size_t(ROWS)*COLS;
+    SummedAreaTable<uint32_t> sat;
+    run("sat/build", [&] { sat.build(gray); bench::clobberMemory(); }, pixels);
+
+    Matrix<uint8_t> out;
+    Image outImg;
+    Matrix<float> mean, var;
+    for(int radius : {1, 4, 16})
+    {
+        const string r = " r=" + to_string(radius);
+        if(radius <= 4) run("box/naive" + r, [&] { naiveBox(gray, radius, out); bench::clobberMemory(); }, pixels);
+        run("box/sat" + r, [&] { boxFilter(gray, radius, out); bench::clobberMemory(); }, pixels);
+        run("box/sat Image" + r, [&] { boxFilter(img, radius, outImg); bench::clobberMemory(); }, pixels);
+        run("meanvar/sat" + r, [&] { meanVariance(gray, radius, mean, var); bench::clobberMemory(); }, pixels);
+    }
+    return run.finish();
+}
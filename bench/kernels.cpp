@@ -0,0 +1,62 @@
+// The dispatched Matrix/Image kernels (04.10/Kernels.h), every ISA variant the
+// CPU supports side by side, with hardware counters per variant.
+
+#include <random>
+#include <string>
+
+#include "Bench.h"
+#include "Kernels.h"
+#include "PerfCounters.h"
+
+using namespace std;
+
+int
+main(int argc, char* argv[]) {
+    bench::Runner run(argc, argv);
+    perf::Profiler prof;
+    mt19937 gen(11);
+    uniform_real_distribution<float> dist(-1.f, 1.f);
+
+    const int N = 256;
+    Matrix<float> a(N, N), b(N, N), c(N, N);
+    for(auto& v : a) v = dist(gen);
+    for(auto& v : b) v = dist(gen);
+
+    const int ROWS = 1024, COLS = 1024;
+    Matrix<float> src(ROWS, COLS), dst(ROWS, COLS), kernel(5, 5);
+    for(auto& v : src) v = dist(gen);
+    for(auto& v : kernel) v = 1.f/25;
+
+    Image img(ROWS, COLS);
+    Matrix<uint8_t> gray(ROWS, COLS);
+    for(auto& px : img) px = Color(gen() & 0xff, gen() & 0xff, gen() & 0xff);
+
+    cout << "active path: " << cpu::isaName(kernels().isa) << endl;
+    for(cpu::Isa isa : cpu::allIsas)
+    {
+        if(isa > cpu::detectIsa()) break;
+        const KernelTable& k = kernelsFor(isa);
+        const string tag = string(" ") + cpu::isaName(isa);
+
+        auto matmul = [&] { k.matmul(a.mem, b.mem, c.mem, N, N, N); bench::doNotOptimize(c.mem); };
+        auto convolve = [&] { k.convolve(src.mem, dst.mem, ROWS, COLS, kernel.mem, 5, 5); bench::doNotOptimize(dst.mem); };
+        auto reduce = [&] { bench::doNotOptimize(k.sum(src.mem, src.numElements())); };
+        auto toGray = [&] { k.rgbToGray(img.mem, gray.mem, img.numElements()); bench::doNotOptimize(gray.mem); };
+
+        const uint64_t matmulOps = uint64_t(N)*N*N;     // multiply-adds
+        run("kernels/matmul 256^3" + tag, matmul, matmulOps);
+        run("kernels/convolve 1024^2 5x5" + tag, convolve, src.numElements());
+        run("kernels/sum 1024^2" + tag, reduce, src.numElements());
+        run("kernels/rgbToGray 1024^2" + tag, toGray, img.numElements());
+
+        if(run.enabled("kernels/"))
+        {
+            perf::profile(prof, "matmul" + tag, matmulOps, 5, matmul);
+            perf::profile(prof, "convolve" + tag, src.numElements(), 5, convolve);
+            perf::profile(prof, "sum" + tag, src.numElements(), 20, reduce);
+            perf::profile(prof, "rgbToGray" + tag, img.numElements(), 20, toGray);
+        }
+    }
+    prof.report();
+    return run.finish();
+}
@@ -0,0 +1,77 @@
+// Per-pixel curves through compile-time lookup tables (04.10/Lut.h), on a
+// 3 MP (2048x1536) Image and a 16 bit matrix of the same size:
+//
+//   curve/pow per pixel        std::pow on every channel of every pixel
+//   curve/runtime table loop   the table built at startup with std::pow,
+//                              applied with a plain loop
+//   curve/constexpr table *    luts::gamma22 through each ISA's lookup8
+//   u16/*                      luts::srgbEncode16<> (65536 entries) through
+//                              each ISA's lookup16, and a plain loop
+//
+// tests/lut_transform.cpp checks the tables against the curves evaluated
+// with <cmath> and every ISA's lookup kernels against a plain loop.
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+
+#include "Bench.h"
+#include "Lut.h"
+
+using namespace std;
+
+const int ROWS = 1536, COLS = 2048;
+
+int
+main(int argc, char* argv[]) {
+    bench::Runner run(argc, argv);
+
+    mt19937 gen(50);
+    Image img(ROWS, COLS), out(ROWS, COLS);
+    for(int i = 0; i < ROWS; ++i)
+        for(int j = 0; j < COLS; ++j) img.unchecked(i, j) = Color(uint8_t(i + j), uint8_t(i ^ j), uint8_t(gen()));
+    const size_t bytes = size_t(3)*ROWS*COLS;
+    const uint8_t* in8 = reinterpret_cast<const uint8_t*>(img.mem);
+    uint8_t* out8 = reinterpret_cast<uint8_t*>(out.mem);
+
+    run("curve/pow per pixel", [&] {
+        for(size_t i = 0; i < bytes; ++i) out8[i] = uint8_t(pow(in8[i]/255.0, 1/2.2)*255 + 0.5);
+        bench::clobberMemory();
+    }, bytes);
+    uint8_t startupTable[256];
+    for(int v = 0; v < 256; ++v) startupTable[v] = uint8_t(pow(v/255.0, 1/2.2)*255 + 0.5);
+    run("curve/runtime table loop", [&] {
+        for(size_t i = 0; i < bytes; ++i) out8[i] = startupTable[in8[i]];
+        bench::clobberMemory();
+    }, bytes);
+    for(cpu::Isa isa : cpu::allIsas)
+    {
+        if(isa > cpu::detectIsa()) break;
+        const KernelTable& k = kernelsFor(isa);
+        run(string("curve/constexpr table ") + cpu::isaName(isa), [&] {
+            k.lookup8(in8, out8, bytes, luts::gamma22.data());
+            bench::clobberMemory();
+        }, bytes);
+    }
+    run("curve/applyLut(Image)", [&] { applyLut(img, out, luts::gamma22); bench::clobberMemory(); }, bytes);
+
+    Matrix<uint16_t> raw(ROWS, COLS), encoded(ROWS, COLS);
+    for(auto& v : raw) v = uint16_t(gen());
+    const size_t pixels = size_t(ROWS)*COLS;
+    run("u16/plain loop", [&] {
+        for(size_t i = 0; i < pixels; ++i) encoded.mem[i] = luts::srgbEncode16<>[raw.mem[i]];
+        bench::clobberMemory();
+    }, pixels);
+    for(cpu::Isa isa : cpu::allIsas)
+    {
+        if(isa > cpu::detectIsa()) break;
+        const KernelTable& k = kernelsFor(isa);
+        run(string("u16/lookup16 ") + cpu::isaName(isa), [&] {
+            k.lookup16(raw.mem, encoded.mem, pixels, luts::srgbEncode16<>.data());
+            bench::clobberMemory();
+        }, pixels);
+    }
+
+    return run.finish();
+}
@@ -0,0 +1,69 @@
+// Tight-loop cost of Matrix element access, before and after the
+// checked/unchecked access policy.
+//
+// "legacy" reproduces the old operator(): a null check with a static
+// dummy fallback in front of every access. The matrix is 1 MB so it stays
+// in cache and the loop body is what gets measured.
+
+#include <stdint.h>
+
+#include "Bench.h"
+#include "Matrix.h"
+
+using namespace std;
+
+template<typename T>
+T& legacyAccess(const Matrix<T>& m, int row, int col)
+{
+    static T dummy;
+    if(!m.mem)
+    {
+        cout << "OOOPS!" << endl;
+        return dummy;
+    }
+    return m.mem[row*m.nCols+col];
+}
+
+int
+main(int argc, char* argv[]) {
+    bench::Runner run(argc, argv);
+
+    const int N = 512;
+    Matrix<int32_t> mat(N, N);
+    for(int i = 0; i < N; ++i)
+        for(int j = 0; j < N; ++j)
+            mat.unchecked(i, j) = (i ^ j) & 0xff;
+
+    cout << "sum of " << N << "x" << N << " int32, MATRIX_CHECKED_ACCESS=" << MATRIX_CHECKED_ACCESS << endl;
+
+    run("access/legacy operator()", [&] {
+        int32_t sum = 0;
+        for(int i = 0; i < N; ++i)
+            for(int j = 0; j < N; ++j)
+                sum += legacyAccess(mat, i, j);
+        bench::doNotOptimize(sum);
+    }, mat.numElements());
+    run("access/operator()", [&] {
+        int32_t sum = 0;
+        for(int i = 0; i < N; ++i)
+            for(int j = 0; j < N; ++j)
+                sum += mat(i, j);
+        bench::doNotOptimize(sum);
+    }, mat.numElements());
+    run("access/at() (always checked)", [&] {
+        int32_t sum = 0;
+        for(int i = 0; i < N; ++i)
+            for(int j = 0; j < N; ++j)
+                sum += mat.at(i, j);
+        bench::doNotOptimize(sum);
+    }, mat.numElements());
+    run("access/row() span", [&] {
+        int32_t sum = 0;
+        for(int i = 0; i < N; ++i)
+            for(auto v : mat.row(i))
+                sum += v;
+        bench::doNotOptimize(sum);
+    }, mat.numElements());
+
+    return run.finish();
+}
@@ -0,0 +1,150 @@
+// Content hashing (contentHash in Kernels.h) and the memoization cache
+// (04.10/MemoCache.h), on a simulated thumbnail service:
+//
+//   hash/*         hashing throughput per ISA variant, a 4000x3000 Image
+//                  (out of cache) and a 256 KB buffer (in L2), GB/s
+//   service/*      600 requests for thumbnails and histograms of 40 source
+//                  images, popularity Zipf-distributed; every request
+//                  arrives as a fresh copy of its source, so recognising it
+//                  means hashing it. Without the cache, and with a cache
+//                  holding about a third of the distinct results.
+//
+// tests/memo_cache.cpp checks the hash (identical on every ISA, sensitive
+// to bit flips, swaps and reshapes) and the cache's bookkeeping.
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Bench.h"
+#include "MemoCache.h"
+
+using namespace std;
+
+const int SRC_ROWS = 768, SRC_COLS = 1024, SOURCES = 40, REQUESTS = 600;
+
+// 4x4 box downsample
+Image thumbnail(const Image& src)
+{
+    Image out(src.nRows/4, src.nCols/4);
+    for(int i = 0; i < out.nRows; ++i)
+        for(int j = 0; j < out.nCols; ++j)
+        {
+            int r = 0, g = 0, b = 0;
+            for(int y = 0; y < 4; ++y)
+                for(int x = 0; x < 4; ++x)
+                {
+                    const Color& c = src.unchecked(4*i + y, 4*j + x);
+                    r += c.r;
+                    g += c.g;
+                    b += c.b;
+                }
+            out.unchecked(i, j) = Color(uint8_t((r + 8)/16), uint8_t((g + 8)/16), uint8_t((b + 8)/16));
+        }
+    return out;
+}
+
+vector<uint32_t> histogram(const Image& src)
+{
+    Matrix<uint8_t> gray;
+    toGray(src, gray);
+    vector<uint32_t> bins(256);
+    for(uint8_t v : gray) ++bins[v];
+    return bins;
+}
+
+struct Request
+{
+    int source;
+    bool wantThumbnail;
+};
+
+int
+main(int argc, char* argv[]) {
+    bench::Runner run(argc, argv);
+
+    mt19937 gen(4);
+    vector<Image> sources;
+    for(int s = 0; s < SOURCES; ++s)
+    {
+        Image img(SRC_ROWS, SRC_COLS);
+        for(int i = 0; i < SRC_ROWS; ++i)
+            for(int j = 0; j < SRC_COLS; ++j)
+                img.unchecked(i, j) = Color(uint8_t(i*s + j), uint8_t(j - i), uint8_t(gen() & 0x3f));
+        sources.push_back(move(img));
+    }
+
+    // Zipf(1) popularity over the sources
+    vector<double> weights;
+    for(int s = 0; s < SOURCES; ++s) weights.push_back(1.0/(s + 1));
+    discrete_distribution<int> pick(weights.begin(), weights.end());
+    vector<Request> requests;
+    for(int r = 0; r < REQUESTS; ++r) requests.push_back({pick(gen), gen() % 4 != 0});
+
+    // the request's image arrives in a buffer of its own
+    Image incoming(SRC_ROWS, SRC_COLS);
+    auto receive = [&](const Request& r) {
+        memcpy(incoming.mem, sources[r.source].mem, incoming.numElements()*sizeof(Color));
+    };
+
+    const size_t thumbBytes = memoBytes(thumbnail(sources[0])), histBytes = memoBytes(histogram(sources[0]));
+    MemoCache cache((thumbBytes + histBytes)*SOURCES/3);
+    uint64_t checksum = 0;
+    auto serve = [&](const Request& r) {
+        receive(r);
+        const uint64_t content = contentHash(incoming);
+        if(r.wantThumbnail)
+            checksum += cache.get<Image>({content, "thumbnail", hashParams(4)}, [&] { return thumbnail(incoming); })->mem[7].g;
+        else
+            checksum += (*cache.get<vector<uint32_t>>({content, "histogram", 0}, [&] { return histogram(incoming); }))[100];
+    };
+
+    // ---- hashing
+    Image big(3000, 4000);
+    for(auto& px : big) px = Color(gen() & 0xff, gen() & 0xff, gen() & 0xff);
+    vector<uint8_t> small(256 << 10);
+    for(auto& b : small) b = static_cast<uint8_t>(gen());
+    const size_t bigBytes = big.numElements()*sizeof(Color);
+    auto gbs = [](const bench::Result* r) { if(r) printf("    %.2f GB/s\n", r->itemsPerOp/r->median); };
+    for(cpu::Isa isa : cpu::allIsas)
+    {
+        if(isa > cpu::detectIsa()) break;
+        const KernelTable& k = kernelsFor(isa);
+        const string tag = string(" ") + cpu::isaName(isa);
+        gbs(run("hash/12 MP Image" + tag, [&] {
+            bench::doNotOptimize(k.hashBytes(reinterpret_cast<const uint8_t*>(big.mem), bigBytes, 0));
+        }, bigBytes));
+        gbs(run("hash/256 KB" + tag, [&] { bench::doNotOptimize(k.hashBytes(small.data(), small.size(), 0)); }, small.size()));
+    }
+
+    // ---- the service
+    run("service/recompute every request", [&] {
+        for(const Request& r : requests)
+        {
+            receive(r);
+            if(r.wantThumbnail) checksum += thumbnail(incoming).mem[7].g;
+            else checksum += histogram(incoming)[100];
+        }
+    }, REQUESTS);
+    run("service/memoized, cold cache each pass", [&] {
+        cache.clear();
+        cache.resetStats();
+        for(const Request& r : requests) serve(r);
+    }, REQUESTS);
+    const MemoCache::Stats st = cache.stats();
+    printf("cache: hit rate %.1f%%, %llu evictions, %zu entries, %zu of %zu budget bytes\n", 100*st.hitRate(),
+           static_cast<unsigned long long>(st.evictions), st.entries, st.bytes, (thumbBytes + histBytes)*SOURCES/3);
+    run("service/receive + hash only", [&] {
+        for(const Request& r : requests)
+        {
+            receive(r);
+            checksum += contentHash(incoming);
+        }
+    }, REQUESTS);
+    bench::doNotOptimize(checksum);
+
+    return run.finish();
+}
@@ -0,0 +1,340 @@
+// Z-order tiled storage (04.10/MortonMatrix.h) against row-major Matrix for
+// neighbourhood work on 4000x4000 images:
+//
+//   codec/*        Morton encode/decode: shift-and-mask, the dispatched
+//                  morton::encode, and BMI2 pdep/pext inlined
+//   convert/*      row-major <-> Z-order, GB/s
+//   column/*       a vertical running box (radius 3) walked column by column,
+//                  the access pattern of separable filters' vertical pass
+//   erode/*        3x3 minimum, visiting pixels in each layout's storage order, and
+//                  on Z order a tile at a time through a row-major scratch tile
+//   rotate/*       nearest-neighbour rotation by 30 degrees (a warp)
+//   floodfill/*    4-connected breadth-first fill from the centre
+//
+// tests/morton_layout.cpp checks the codec and the MortonMatrix operations
+// these are built from (index(), the addX/addY steps, tiles, conversions).
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Bench.h"
+#include "MortonMatrix.h"
+
+using namespace std;
+
+const int ROWS = 4000, COLS = 4000;
+
+using Gray = MortonMatrix<uint8_t>;
+constexpr int GL = 6;       // log2 of Gray's tile side
+static_assert(Gray::TILE == 1 << GL, "uint8_t tiles are 64x64, one page");
+
+// ---- column walk: out(r, c) = sum of in(r-3 .. r+3, c), clamped to the image
+
+void columnBox(const Matrix<uint8_t>& in, Matrix<uint16_t>& out)
+{
+    for(int c = 0; c < COLS; ++c)
+    {
+        unsigned s = 0;
+        for(int r = 0; r < 3; ++r) s += in.unchecked(r, c);
+        for(int r = 0; r < ROWS; ++r)
+        {
+            if(r + 3 < ROWS) s += in.unchecked(r + 3, c);
+            out.unchecked(r, c) = static_cast<uint16_t>(s);
+            if(r - 3 >= 0) s -= in.unchecked(r - 3, c);
+        }
+    }
+}
+
+void columnBox(const Gray& in, MortonMatrix<uint16_t, GL>& out)
+{
+    for(int c = 0; c < COLS; ++c)
+    {
+        unsigned s = 0;
+        for(int r = 0; r < 3; ++r) s += in(r, c);
+        // three cursors (r+3, r, r-3), each stepped down a row without re-encoding
+        size_t ahead = in.index(3, c), here = out.index(0, c), behind = in.index(0, c);
+        for(int r = 0; r < ROWS; ++r)
+        {
+            if(r + 3 < ROWS) s += in.mem()[ahead];
+            out.mem()[here] = static_cast<uint16_t>(s);
+            if(r - 3 >= 0) s -= in.mem()[behind];
+
+            ahead = ((r + 4) & (Gray::TILE - 1)) ? morton::addY<GL>(ahead, 1) : in.index(min(r + 4, ROWS - 1), c);
+            here = ((r + 1) & (Gray::TILE - 1)) ? morton::addY<GL>(here, 1) : out.index(min(r + 1, ROWS - 1), c);
+            if(r - 3 >= 0)
+                behind = ((r - 2) & (Gray::TILE - 1)) ? morton::addY<GL>(behind, 1) : in.index(r - 2, c);
+        }
+    }
+}
+
+// ---- 3x3 erosion
+
+uint8_t min3x3(const Matrix<uint8_t>& in, int r, int c)
+{
+    uint8_t m = 255;
+    for(int dr = -1; dr <= 1; ++dr)
+        for(int dc = -1; dc <= 1; ++dc)
+            m = min(m, in.unchecked(clamp(r + dr, 0, ROWS - 1), clamp(c + dc, 0, COLS - 1)));
+    return m;
+}
+
+void erode(const Matrix<uint8_t>& in, Matrix<uint8_t>& out)
+{
+    for(int r = 0; r < ROWS; ++r)
+    {
+        if(r == 0 || r == ROWS - 1)
+        {
+            for(int c = 0; c < COLS; ++c) out.unchecked(r, c) = min3x3(in, r, c);
+            continue;
+        }
+        const uint8_t* up = &in.unchecked(r - 1, 0);
+        const uint8_t* mid = &in.unchecked(r, 0);
+        const uint8_t* down = &in.unchecked(r + 1, 0);
+        out.unchecked(r, 0) = min3x3(in, r, 0);
+        for(int c = 1; c < COLS - 1; ++c)
+            out.unchecked(r, c) = min({up[c - 1], up[c], up[c + 1], mid[c - 1], mid[c], mid[c + 1],
+                                       down[c - 1], down[c], down[c + 1]});
+        out.unchecked(r, COLS - 1) = min3x3(in, r, COLS - 1);
+    }
+}
+
+template<bool Bmi2>
+void erode(const Gray& in, Gray& out)
+{
+    for(int tr = 0; tr < in.numTileRows(); ++tr)
+        for(int tc = 0; tc < in.numTileCols(); ++tc)
+        {
+            const size_t base = in.tile(tr, tc) - in.mem();
+            for(uint32_t m = 0; m < Gray::TILE_ELEMS; ++m)
+            {
+                uint32_t x, y;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+                if constexpr(Bmi2) morton::decodeBmi2(m, x, y); else
+#endif
+                morton::decode(m, x, y);
+                const int r = tr*Gray::TILE + int(y), c = tc*Gray::TILE + int(x);
+                if(r >= ROWS || c >= COLS) continue;
+                uint8_t v = 255;
+                // inside the tile and the image: all nine are in this tile, no padding
+                if(x > 0 && y > 0 && x < Gray::TILE - 1 && y < Gray::TILE - 1 && r < ROWS - 1 && c < COLS - 1)
+                {
+                    const size_t up = morton::addY<GL>(m, -1), down = morton::addY<GL>(m, 1);
+                    const uint8_t* t = in.mem() + base;
+                    v = min({t[morton::addX<GL>(up, -1)], t[up], t[morton::addX<GL>(up, 1)],
+                             t[morton::addX<GL>(m, -1)], t[m], t[morton::addX<GL>(m, 1)],
+                             t[morton::addX<GL>(down, -1)], t[down], t[morton::addX<GL>(down, 1)]});
+                }
+                else
+                {
+                    for(int dr = -1; dr <= 1; ++dr)
+                        for(int dc = -1; dc <= 1; ++dc)
+                            v = min(v, in(clamp(r + dr, 0, ROWS - 1), clamp(c + dc, 0, COLS - 1)));
+                }
+                out.mem()[base + m] = v;
+            }
+        }
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+// compiled for BMI2 with everything inlined, so decodeBmi2 is a pext in the loop
+__attribute__((target("bmi2"), flatten)) void erodePext(const Gray& in, Gray& out) { erode<true>(in, out); }
+
+__attribute__((target("bmi2"))) void encodePdep(uint32_t* codes, uint32_t n)
+{
+    for(uint32_t i = 0; i < n; ++i) codes[i] = morton::encodeBmi2(i & 0x7ff, i >> 11);
+}
+
+__attribute__((target("bmi2"))) uint32_t decodePext(const uint32_t* codes, uint32_t n)
+{
+    uint32_t s = 0;
+    for(uint32_t i = 0; i < n; ++i)
+    {
+        uint32_t x, y;
+        morton::decodeBmi2(codes[i], x, y);
+        s += x ^ y;
+    }
+    return s;
+}
+#endif
+
+// the same a tile at a time: tile plus a 1-pixel apron copied out row-major, the
+// row-major inner loop on that, and the result written back in Z order
+void erodeTiled(const Gray& in, Gray& out)
+{
+    constexpr int T = Gray::TILE, S = T + 2;
+    uint8_t src[S*S], dst[T*T];
+    for(int tr = 0; tr < in.numTileRows(); ++tr)
+        for(int tc = 0; tc < in.numTileCols(); ++tc)
+        {
+            in.readTile(tr, tc, 1, src);
+            for(int y = 0; y < T; ++y)
+            {
+                const uint8_t *up = src + y*S, *mid = up + S, *down = mid + S;
+                for(int x = 0; x < T; ++x)
+                    dst[y*T + x] = min({up[x], up[x + 1], up[x + 2], mid[x], mid[x + 1], mid[x + 2],
+                                        down[x], down[x + 1], down[x + 2]});
+            }
+            out.writeTile(tr, tc, dst);
+        }
+}
+
+// ---- rotation by 30 degrees about the centre, nearest neighbour, black outside
+
+struct Rotation
+{
+    double cs = cos(M_PI/6), sn = sin(M_PI/6), cr = ROWS/2.0, cc = COLS/2.0;
+
+    bool source(int r, int c, int& sr, int& sc) const
+    {
+        const double y = r - cr, x = c - cc;
+        sr = static_cast<int>(lround(cr + cs*y - sn*x));
+        sc = static_cast<int>(lround(cc + sn*y + cs*x));
+        return sr >= 0 && sr < ROWS && sc >= 0 && sc < COLS;
+    }
+};
+
+void rotate(const Image& in, Image& out)
+{
+    Rotation rot;
+    for(int r = 0; r < ROWS; ++r)
+        for(int c = 0; c < COLS; ++c)
+        {
+            int sr, sc;
+            out.unchecked(r, c) = rot.source(r, c, sr, sc) ? in.unchecked(sr, sc) : Color(0);
+        }
+}
+
+void rotate(const MortonImage& in, MortonImage& out)
+{
+    Rotation rot;
+    for(int tr = 0; tr < out.numTileRows(); ++tr)
+        for(int tc = 0; tc < out.numTileCols(); ++tc)
+        {
+            Color* t = out.tile(tr, tc);
+            for(uint32_t m = 0; m < MortonImage::TILE_ELEMS; ++m)
+            {
+                uint32_t x, y;
+                morton::decode(m, x, y);
+                int sr, sc;
+                t[m] = rot.source(tr*MortonImage::TILE + int(y), tc*MortonImage::TILE + int(x), sr, sc) ? in(sr, sc)
+                                                                                                       : Color(0);
+            }
+        }
+}
+
+// ---- flood fill: label every pixel 4-connected to the centre through pixels below 200
+
+template<typename M>
+size_t floodFill(M& pixels, vector<pair<int, int>>& queue)
+{
+    queue.clear();
+    queue.emplace_back(ROWS/2, COLS/2);
+    pixels(ROWS/2, COLS/2) = 255;
+    for(size_t head = 0; head < queue.size(); ++head)
+    {
+        const auto [r, c] = queue[head];
+        const int nr[4] = {r - 1, r + 1, r, r}, nc[4] = {c, c, c - 1, c + 1};
+        for(int k = 0; k < 4; ++k)
+        {
+            if(nr[k] < 0 || nr[k] >= ROWS || nc[k] < 0 || nc[k] >= COLS) continue;
+            uint8_t& p = pixels(nr[k], nc[k]);
+            if(p >= 200) continue;
+            p = 255;
+            queue.emplace_back(nr[k], nc[k]);
+        }
+    }
+    return queue.size();
+}
+
+int
+main(int argc, char* argv[]) {
+    bench::Runner run(argc, argv);
+
+    mt19937 gen(2);
+    Matrix<uint8_t> gray(ROWS, COLS);
+    for(auto& v : gray) v = static_cast<uint8_t>(gen() % 160);
+    // walls for the flood fill to go around
+    for(int k = 0; k < 4000; ++k)
+    {
+        const int r = gen() % ROWS, c = gen() % COLS, len = 20 + gen() % 200;
+        for(int i = 0; i < len; ++i)
+            gray.unchecked(k % 2 ? r : min(r + i, ROWS - 1), k % 2 ? min(c + i, COLS - 1) : c) = 250;
+    }
+    Image img(ROWS, COLS);
+    for(auto& px : img) px = Color(gen() & 0xff, gen() & 0xff, gen() & 0xff);
+
+    const Gray zGray(gray);
+    const MortonImage zImg(img);
+    printf("padding: gray %.2f%%, image %.2f%%\n", 100.0*(zGray.storedElements() - gray.numElements())/gray.numElements(),
+           100.0*(zImg.storedElements() - img.numElements())/img.numElements());
+
+    Matrix<uint16_t> colOut(ROWS, COLS);
+    MortonMatrix<uint16_t, GL> zColOut(ROWS, COLS);
+    Matrix<uint8_t> eroded(ROWS, COLS);
+    Gray zEroded(ROWS, COLS);
+    Image rotated(ROWS, COLS);
+    MortonImage zRotated(ROWS, COLS);
+    vector<pair<int, int>> queue;
+    Matrix<uint8_t> filled = gray;
+    Gray zFilled(gray);
+    const size_t reached = floodFill(filled, queue);
+    printf("flood fill reaches %zu pixels\n", reached);
+
+    // ---- codec
+    const size_t CODES = 1 << 20;
+    vector<uint32_t> codes(CODES);
+    run("codec/encode shift-and-mask", [&] {
+        for(uint32_t i = 0; i < CODES; ++i) codes[i] = morton::spread(i & 0x7ff) | morton::spread(i >> 11) << 1;
+        bench::clobberMemory();
+    }, CODES);
+    run("codec/decode shift-and-mask", [&] {
+        uint32_t s = 0;
+        for(uint32_t i = 0; i < CODES; ++i) s += morton::compact(codes[i]) ^ morton::compact(codes[i] >> 1);
+        bench::doNotOptimize(s);
+    }, CODES);
+    // what MortonMatrix and other callers get: pdep where the CPU has it, behind a call
+    run("codec/encode dispatched", [&] {
+        for(uint32_t i = 0; i < CODES; ++i) codes[i] = morton::encode(i & 0x7ff, i >> 11);
+        bench::clobberMemory();
+    }, CODES);
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    if(morton::hasBmi2())
+    {
+        run("codec/encode pdep", [&] { encodePdep(codes.data(), CODES); bench::clobberMemory(); }, CODES);
+        run("codec/decode pext", [&] { bench::doNotOptimize(decodePext(codes.data(), CODES)); }, CODES);
+    }
+#endif
+
+    // ---- layout
+    MortonImage zTmp(ROWS, COLS);
+    Image tmp(ROWS, COLS);
+    const size_t imgBytes = img.numElements()*sizeof(Color);
+    for(auto r : {run("convert/row-major -> Z Image", [&] { zTmp.fromRowMajor(img); bench::clobberMemory(); }, imgBytes),
+                  run("convert/Z -> row-major Image", [&] { zImg.toRowMajor(tmp); bench::clobberMemory(); }, imgBytes)})
+        if(r) printf("    %.2f GB/s\n", r->itemsPerOp/r->median);
+
+    const size_t pixels = gray.numElements();
+    run("column/running box r=3 row-major", [&] { columnBox(gray, colOut); bench::clobberMemory(); }, pixels);
+    run("column/running box r=3 Z-order", [&] { columnBox(zGray, zColOut); bench::clobberMemory(); }, pixels);
+    run("erode/3x3 row-major", [&] { erode(gray, eroded); bench::clobberMemory(); }, pixels);
+    run("erode/3x3 Z-order", [&] { erode<false>(zGray, zEroded); bench::clobberMemory(); }, pixels);
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    if(morton::hasBmi2())
+        run("erode/3x3 Z-order pext", [&] { erodePext(zGray, zEroded); bench::clobberMemory(); }, pixels);
+#endif
+    run("erode/3x3 Z-order tile scratch", [&] { erodeTiled(zGray, zEroded); bench::clobberMemory(); }, pixels);
+    run("rotate/30deg Image row-major", [&] { rotate(img, rotated); bench::clobberMemory(); }, pixels);
+    run("rotate/30deg Image Z-order", [&] { rotate(zImg, zRotated); bench::clobberMemory(); }, pixels);
+    run("floodfill/row-major", [&] {
+        filled = gray;
+        bench::doNotOptimize(floodFill(filled, queue));
+    }, reached);
+    run("floodfill/Z-order", [&] {
+        zFilled.fromRowMajor(gray);
+        bench::doNotOptimize(floodFill(zFilled, queue));
+    }, reached);
+
+    return run.finish();
+}
@@ -0,0 +1,129 @@
+// NUMA placement of Matrix memory (04.10/NumaPlacement.h) on a 256 MB
+// Matrix<float>, against plain new T[] + fillWithZeros():
+//
+//   init/*         allocating and zeroing it: one thread for new T[], one
+//                  first-touch thread per band for the placements
+//   sum/*          summing it in parallel row bands (integral_detail::
+//                  parallelBands), each thread bound to its band's node, GB/s
+//
+// What this shows depends on the machine: with one node every policy puts
+// everything on node 0 and only the parallel zeroing can differ. Before
+// timing, every page is checked to be on the node its policy promises
+// (the band's node, the allocating thread's node, all nodes for
+// interleaving), and matrices from an allocator to be zeroed, copied and
+// re-initialized with it.
+
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Bench.h"
+#include "IntegralImage.h"
+#include "NumaPlacement.h"
+
+using namespace std;
+
+const int ROWS = 8192, COLS = 8192;
+
+bool checkPlacement(const numa::Placement& placement, int rows, int cols)
+{
+    Matrix<float> m(rows, cols, placement);
+    for(float v : m)
+        if(v != 0.f) return false;
+    const size_t rowBytes = size_t(cols)*sizeof(float);
+    const vector<int> nodes = numa::pageNodes(m.mem, m.numElements()*sizeof(float));
+    const int nBands = placement.bands(rows);
+    vector<bool> used(numa::nodeCount(), false);
+    for(size_t page = 0; page < nodes.size(); ++page)
+    {
+        if(nodes[page] < 0 || nodes[page] >= numa::nodeCount()) return false;      // untouched, or nonsense
+        used[nodes[page]] = true;
+        if(placement.policy() == numa::Policy::RowBands)
+        {
+            // a page goes with the band of its first row
+            const size_t row = (page*4096 + rowBytes - 1)/rowBytes;
+            const int band = static_cast<int>((nBands*(row + 1) - 1)/rows);
+            if(row < size_t(rows) && nodes[page] != placement.nodeOfBand(band, nBands)) return false;
+        }
+        if(placement.policy() == numa::Policy::Local && nodes[page] != numa::currentNode()) return false;
+    }
+    if(placement.policy() == numa::Policy::Interleaved)
+        for(bool u : used)
+            if(!u) return false;
+
+    // copies live where the original does, init() keeps the allocator
+    m(rows - 1, 4) = 5.f;
+    Matrix<float> copy = m;
+    if(copy.allocator != &placement || copy(rows - 1, 4) != 5.f) return false;
+    copy.init(rows + 1, cols);
+    if(copy.allocator != &placement || copy(rows, 1) != 0.f) return false;
+    Matrix<float> moved = move(copy);
+    return moved.allocator == &placement;
+}
+
+int
+main(int argc, char* argv[]) {
+    bench::Runner run(argc, argv);
+
+    const int threads = static_cast<int>(thread::hardware_concurrency());
+    printf("libnuma %s, %d node(s), %d hardware thread(s)\n", numa::available() ? "available" : "not available",
+           numa::nodeCount(), threads);
+
+    // also with more bands than this machine may have threads, so the band split is exercised
+    const numa::Placement fourBands(numa::Policy::RowBands, 4);
+    for(const numa::Placement* p : {&numa::interleaved(), &numa::rowBands(), &numa::local(), &fourBands})
+        for(int rows : {1, 64, 300, 1000})
+            if(!checkPlacement(*p, rows, 1000))
+            {
+                fprintf(stderr, "pages are not where policy %d put them (%d rows)\n", int(p->policy()), rows);
+                return 1;
+            }
+
+    struct Named
+    {
+        const char* name;
+        const numa::Placement* placement;
+    };
+    const Named placements[] = {{"interleaved", &numa::interleaved()}, {"row bands", &numa::rowBands()},
+                                {"local", &numa::local()}};
+    const size_t bytes = size_t(ROWS)*COLS*sizeof(float);
+    auto gbs = [](const bench::Result* r) { if(r) printf("    %.2f GB/s\n", r->itemsPerOp/r->median); };
+
+    gbs(run("init/new T[] + fillWithZeros", [&] {
+        Matrix<float> m(ROWS, COLS);
+        bench::doNotOptimize(m.mem);
+    }, bytes));
+    for(const Named& p : placements)
+        gbs(run(string("init/") + p.name + ", parallel first touch", [&] {
+            Matrix<float> m(ROWS, COLS, *p.placement);
+            bench::doNotOptimize(m.mem);
+        }, bytes));
+
+    auto bandSum = [&](const Matrix<float>& m, const numa::Placement* placement) {
+        vector<double> partial(threads, 0.0);
+        integral_detail::parallelBands(ROWS, threads, [&](int r0, int r1) {
+            if(placement) placement->bindThread(r0, ROWS);
+            float s = 0;
+            for(int i = r0; i < r1; ++i)
+                for(float v : m.row(i)) s += v;
+            partial[static_cast<size_t>(r0)*threads/ROWS] = s;
+        });
+        double total = 0;
+        for(double s : partial) total += s;
+        return total;
+    };
+    {
+        Matrix<float> m(ROWS, COLS);
+        for(auto& v : m) v = 1.f;
+        gbs(run("sum/new T[], parallel row bands", [&] { bench::doNotOptimize(bandSum(m, nullptr)); }, bytes));
+    }
+    for(const Named& p : placements)
+    {
+        Matrix<float> m(ROWS, COLS, *p.placement);
+        for(auto& v : m) v = 1.f;
+        gbs(run(string("sum/") + p.name + ", parallel row bands", [&] { bench::doNotOptimize(bandSum(m, p.placement)); }, bytes));
+    }
+
+    return run.finish();
+}
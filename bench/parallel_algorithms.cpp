@@ -0,0 +1,58 @@
+// Standard parallel algorithms on Matrix data through begin()/end(),
+// timed for seq / par / par_unseq at 256^2, 1024^2 and 4096^2 (pass
+// --reps=5 for a quicker run, the large sorts dominate). That they agree
+// with the sequential results is checked by tests/parallel_algorithms.cpp.
+//
+// libstdc++ runs std::execution::par on TBB, so the thread count is
+// whatever TBB picks (all cores unless restricted with taskset).
+
+#include <cstdlib>
+#include <execution>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <thread>
+
+#include "Bench.h"
+#include "Matrix.h"
+
+using namespace std;
+
+void fillRandom(Matrix<float>& mat, unsigned seed)
+{
+    mt19937 gen(seed);
+    uniform_real_distribution<float> dist(-1.f, 1.f);
+    for(auto& v : mat) v = dist(gen);
+}
+
+template<typename POLICY>
+void timeAll(bench::Runner& run, const string& name, POLICY&& policy, Matrix<float>& src, Matrix<float>& dst, Matrix<float>& scratch)
+{
+    auto items = src.numElements();
+    run(name + " transform", [&] {
+        transform(policy, src.begin(), src.end(), dst.begin(), [](float v) { return v*v + 0.5f*v; });
+        bench::doNotOptimize(dst.mem);
+    }, items);
+    run(name + " reduce", [&] {
+        bench::doNotOptimize(reduce(policy, src.begin(), src.end(), 0.f));
+    }, items);
+    run.withSetup(name + " sort",
+        [&] { copy(src.begin(), src.end(), scratch.begin()); },
+        [&] { sort(policy, scratch.begin(), scratch.end()); }, items);
+}
+
+int
+main(int argc, char* argv[]) {
+    bench::Runner run(argc, argv);
+    cout << "hardware threads: " << thread::hardware_concurrency() << endl;
+    for(int n : {256, 1024, 4096})
+    {
+        Matrix<float> src(n, n), dst(n, n), scratch(n, n);
+        fillRandom(src, 3);
+        auto size = to_string(n) + "^2";
+        timeAll(run, "par/seq " + size, execution::seq, src, dst, scratch);
+        timeAll(run, "par/par " + size, execution::par, src, dst, scratch);
+        timeAll(run, "par/par_unseq " + size, execution::par_unseq, src, dst, scratch);
+    }
+    return run.finish();
+}
@@ -0,0 +1,144 @@
+// 8-bit quantized multiply (04.10/Quantized.h) against the float kernel, for
+// a fully connected layer: 64 activation rows times a 1024x1024 weight matrix
+// whose rows differ in magnitude by up to 100x, as trained layers' do.
+//
+//   accuracy      error of the quantized product against the float one,
+//                 per-tensor and per-row weight scales
+//   footprint     weight bytes, float vs int8
+//   matmul/*      throughput per ISA variant in multiply-adds per ns
+//
+// The int32 kernel is also checked against a plain scalar loop, exactly.
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+
+#include "Bench.h"
+#include "Quantized.h"
+
+using namespace std;
+
+const int N = 64, K = 1024, M = 1024;
+
+Matrix<float> transpose(const Matrix<float>& m)
+{
+    Matrix<float> t(m.nCols, m.nRows);
+    for(int i = 0; i < m.nRows; ++i)
+        for(int j = 0; j < m.nCols; ++j) t.unchecked(j, i) = m.unchecked(i, j);
+    return t;
+}
+
+struct Error { double maxAbs, relRms; };
+
+Error compare(const Matrix<float>& got, const Matrix<float>& expected)
+{
+    double maxAbs = 0, err2 = 0, ref2 = 0;
+    for(size_t i = 0; i < got.numElements(); ++i)
+    {
+        const double d = got.mem[i] - expected.mem[i];
+        maxAbs = max(maxAbs, fabs(d));
+        err2 += d*d;
+        ref2 += double(expected.mem[i])*expected.mem[i];
+    }
+    return {maxAbs, sqrt(err2/ref2)};
+}
+
+bool checkExact(const KernelTable& k, const QuantizedMatrix<uint8_t>& a, const QuantizedMatrix<int8_t>& w)
+{
+    // a row count that is not a multiple of the 4-row blocking
+    const int n = 7;
+    Matrix<int32_t> acc(n, M);
+    k.matmulU8S8(a.values.mem, w.values.mem, acc.mem, n, K, M);
+    for(int i = 0; i < n; ++i)
+        for(int j = 0; j < M; ++j)
+        {
+            int32_t s = 0;
+            for(int p = 0; p < K; ++p) s += int32_t(a.values(i, p))*int32_t(w.values(j, p));
+            if(acc(i, j) != s) return false;
+        }
+    return true;
+}
+
+int
+main(int argc, char* argv[]) {
+    bench::Runner run(argc, argv);
+
+    mt19937 gen(11);
+    normal_distribution<float> normal(0.f, 1.f);
+    uniform_real_distribution<float> relu(0.f, 4.f);
+    Matrix<float> x(N, K), w(K, M);         // float layout: y = x * w
+    for(auto& v : x) v = relu(gen);
+    for(int j = 0; j < M; ++j)
+    {
+        const float magnitude = pow(100.f, float(j)/M)/100.f;   // 0.01 .. 1 across the outputs
+        for(int p = 0; p < K; ++p) w.unchecked(p, j) = magnitude*normal(gen);
+    }
+    const Matrix<float> wt = transpose(w);  // quantized layout: one row per output
+
+    Matrix<float> expected;
+    multiply(x, w, expected);
+
+    const auto xq = quantize<uint8_t>(x, Granularity::PerTensor);
+    const auto wTensor = quantize<int8_t>(wt, Granularity::PerTensor);
+    const auto wRow = quantize<int8_t>(wt, Granularity::PerRow);
+
+    Matrix<float> got;
+    multiply(xq, wTensor, got);
+    const Error perTensor = compare(got, expected);
+    multiply(xq, wRow, got);
+    const Error perRow = compare(got, expected);
+    printf("accuracy vs float: per-tensor weights  max abs %.4f  relative rms %.3f%%\n", perTensor.maxAbs,
+           100*perTensor.relRms);
+    printf("                   per-row weights     max abs %.4f  relative rms %.3f%%\n", perRow.maxAbs, 100*perRow.relRms);
+
+    // requantized output: the float result within one output step plus the input rounding
+    {
+        float lo, hi;
+        minMax(expected, lo, hi);
+        const QuantParams outParams{(hi - lo)/255, static_cast<int32_t>(lround(-lo/((hi - lo)/255)))};
+        QuantizedMatrix<uint8_t> yq;
+        multiply(xq, wRow, outParams, yq);
+        Matrix<float> y;
+        dequantize(yq, y);
+        const Error requantized = compare(y, expected);
+        printf("                   requantized to u8   max abs %.4f  relative rms %.3f%%\n", requantized.maxAbs,
+               100*requantized.relRms);
+        if(requantized.maxAbs > perRow.maxAbs + outParams.scale)
+        {
+            fprintf(stderr, "requantized output is off by more than one step\n");
+            return 1;
+        }
+    }
+    if(perRow.relRms > 0.02)
+    {
+        fprintf(stderr, "quantized product is too far from the float one\n");
+        return 1;
+    }
+    printf("weight footprint: float %zu bytes, int8 per-row %zu bytes\n", w.numElements()*sizeof(float), wRow.bytes());
+
+    Matrix<float> c(N, M);
+    Matrix<int32_t> acc(N, M);
+    const uint64_t macs = uint64_t(N)*K*M;
+    for(cpu::Isa isa : cpu::allIsas)
+    {
+        if(isa > cpu::detectIsa()) break;
+        const KernelTable& k = kernelsFor(isa);
+        if(!checkExact(k, xq, wRow))
+        {
+            fprintf(stderr, "matmulU8S8 (%s) differs from the scalar loop\n", cpu::isaName(isa));
+            return 1;
+        }
+        const string tag = string(" ") + cpu::isaName(isa);
+        for(auto r : {run("matmul/float 64x1024x1024" + tag, [&] {
+                          k.matmul(x.mem, w.mem, c.mem, N, K, M);
+                          bench::doNotOptimize(c.mem);
+                      }, macs),
+                      run("matmul/u8s8 64x1024x1024" + tag, [&] {
+                          k.matmulU8S8(xq.values.mem, wRow.values.mem, acc.mem, N, K, M);
+                          bench::doNotOptimize(acc.mem);
+                      }, macs)})
+            if(r) printf("    %.1f multiply-adds/ns\n", r->itemsPerOp/r->median);
+    }
+    return run.finish();
+}
@@ -0,0 +1,105 @@
+// One writer, N readers on a shared 720p Image:
+//
+//   FramePublisher   lock-free snapshots (04.10/SharedFrame.h)
+//   mutex            readers and the writer take one std::mutex around the frame
+//   shared_ptr       writer builds a new frame and std::atomic_store's a shared_ptr
+//                    (libstdc++ guards these with a small pool of spin locks)
+//
+// The writer fills every frame with a single value, so a reader can detect a
+// torn frame by comparing a few pixels. Reports reads/s, writes/s and tears.
+//
+//   bench_snapshot_contention [seconds per run, default 1]
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "SharedFrame.h"
+
+using namespace std;
+
+const int ROWS = 720, COLS = 1280;
+
+// reads a handful of spread-out pixels; a consistent frame has them all equal
+bool consistent(const Image& img)
+{
+    const uint8_t v = img(0, 0).r;
+    return img(ROWS/2, COLS/2).r == v && img(ROWS - 1, COLS - 1).r == v && img(ROWS/3, 7).g == v;
+}
+
+void fill(Image& img, uint8_t v)
+{
+    for(auto& px : img) px = Color(v);
+}
+
+struct Counts { atomic<long> reads{0}, writes{0}, tears{0}; };
+
+template<typename READ, typename WRITE>
+void contend(const char* name, int nReaders, double seconds, READ&& read, WRITE&& write)
+{
+    Counts counts;
+    atomic<bool> stop{false};
+    vector<thread> readers;
+    for(int r = 0; r < nReaders; ++r)
+        readers.emplace_back([&] {
+            long n = 0, torn = 0;
+            while(!stop.load(memory_order_relaxed))
+            {
+                torn += !read();
+                ++n;
+            }
+            counts.reads += n;
+            counts.tears += torn;
+        });
+    thread writer([&] {
+        long n = 0;
+        while(!stop.load(memory_order_relaxed)) write(uint8_t(++n));
+        counts.writes = n;
+    });
+
+    this_thread::sleep_for(chrono::duration<double>(seconds));
+    stop = true;
+    writer.join();
+    for(auto& t : readers) t.join();
+
+    cout << name << " readers=" << nReaders << ": " << counts.reads/seconds << " reads/s, "
+         << counts.writes/seconds << " writes/s, " << counts.tears << " torn" << endl;
+}
+
+int
+main(int argc, char* argv[]) {
+    double seconds = argc > 1 ? atof(argv[1]) : 1.0;
+    cout << "hardware threads: " << thread::hardware_concurrency() << endl;
+
+    for(int nReaders : {1, 2, 4, 8})
+    {
+        {
+            FramePublisher<Image> live(ROWS, COLS);
+            contend("FramePublisher", nReaders, seconds,
+                [&] { auto snap = live.snapshot(); return consistent(*snap); },
+                [&](uint8_t v) { live.update([&](Image& next) { fill(next, v); }); });
+        }
+        {
+            mutex lock;
+            Image frame(ROWS, COLS);
+            contend("mutex         ", nReaders, seconds,
+                [&] { lock_guard<mutex> guard(lock); return consistent(frame); },
+                [&](uint8_t v) { lock_guard<mutex> guard(lock); fill(frame, v); });
+        }
+        {
+            auto frame = make_shared<const Image>(ROWS, COLS);
+            contend("shared_ptr    ", nReaders, seconds,
+                [&] { auto snap = atomic_load(&frame); return consistent(*snap); },
+                [&](uint8_t v) {
+                    auto next = make_shared<Image>(ROWS, COLS);
+                    fill(*next, v);
+                    atomic_store(&frame, shared_ptr<const Image>(std::move(next)));
+                });
+        }
+    }
+    return 0;
+}
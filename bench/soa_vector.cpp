@@ -0,0 +1,111 @@
+// SoaVector (04.10/SoaVector.h) against std::vector of the same aggregate,
+// for passes that read or write only some of the members:
+//
+//   soa/*     Vec3d: sum of x; Particle (8 members): x += vx*dt
+//   proxy/*   the same pass element by element through proxies (inlines to the column loop)
+//
+// The aggregates are the lessons' (02.20 Coordinate, 03.13 Vec2d/Vec3d) plus
+// a wider Particle, where touching 2 of 8 members shows the gap best.
+
+#include <cstdio>
+#include <vector>
+
+#include "Bench.h"
+#include "SoaVector.h"
+
+using namespace std;
+
+struct Coordinate { int x = 0; int y = 0; };    // 02.20, default member initializers
+struct Vec2d { int x, y; };                     // 03.13
+struct Vec3d { float x, y, z; };
+struct Particle { float x, y, z, vx, vy, vz, mass; int id; };
+
+static_assert(SoaVector<Coordinate>::numFields == 2, "Coordinate has two members");
+static_assert(SoaVector<Vec3d>::numFields == 3, "Vec3d has three members");
+static_assert(SoaVector<Particle>::numFields == 8, "Particle has eight members");
+static_assert(is_same<SoaVector<Particle>::Field<7>, int>::value, "member types are kept");
+
+bool checkProxies()
+{
+    SoaVector<Coordinate> coords;
+    coords.push_back({1, 2});
+    coords.push_back(Coordinate{});
+    coords[1] = Coordinate{3, 4};
+    coords[0].get<1>() += 10;
+    auto [x, y] = coords[1];
+    x = 30;                                     // references into the columns
+    Coordinate c0 = coords[0], c1 = coords[1];
+
+    SoaVector<Vec2d> vecs(3);
+    int n = 0;
+    for(auto v : vecs) v = Vec2d{n, -n}, ++n;
+    const SoaVector<Vec2d>& cvecs = vecs;
+    Vec2d last = cvecs[2];
+
+    return c0.x == 1 && c0.y == 12 && c1.x == 30 && c1.y == 4 && y == 4 && last.x == 2 && last.y == -2
+        && coords.column<0>().size() == 2;
+}
+
+int
+main(int argc, char* argv[]) {
+    if(!checkProxies())
+    {
+        fprintf(stderr, "SoaVector proxy check failed\n");
+        return 1;
+    }
+    bench::Runner run(argc, argv);
+    const size_t N = 1 << 20;
+    const float dt = 0.01f;
+
+    vector<Vec3d> aosPoints(N);
+    SoaVector<Vec3d> soaPoints;
+    soaPoints.reserve(N);
+    for(size_t i = 0; i < N; ++i)
+    {
+        aosPoints[i] = Vec3d{float(i % 100), 1, 2};
+        soaPoints.push_back(aosPoints[i]);
+    }
+    run("soa/Vec3d sum x, std::vector", [&] {
+        float s = 0;
+        for(const Vec3d& p : aosPoints) s += p.x;
+        bench::doNotOptimize(s);
+    }, N);
+    run("soa/Vec3d sum x, SoaVector column", [&] {
+        float s = 0;
+        for(float x : soaPoints.column<0>()) s += x;
+        bench::doNotOptimize(s);
+    }, N);
+
+    vector<Particle> aos(N);
+    SoaVector<Particle> soa(N);
+    for(size_t i = 0; i < N; ++i)
+    {
+        aos[i] = Particle{0, 0, 0, float(i % 7), 1, 1, 1, int(i)};
+        soa[i] = aos[i];
+    }
+    for(size_t i = 0; i < N; ++i)
+    {
+        Particle p = soa[i];
+        if(p.vx != aos[i].vx || p.id != aos[i].id)
+        {
+            fprintf(stderr, "SoaVector element %zu differs\n", i);
+            return 1;
+        }
+    }
+    run("soa/Particle x += vx*dt, std::vector", [&] {
+        for(Particle& p : aos) p.x += p.vx*dt;
+        bench::clobberMemory();
+    }, N);
+    run("soa/Particle x += vx*dt, SoaVector columns", [&] {
+        Span<float> x = soa.column<0>();
+        Span<const float> vx = static_cast<const SoaVector<Particle>&>(soa).column<3>();
+        for(size_t i = 0; i < x.size(); ++i) x[i] += vx[i]*dt;
+        bench::clobberMemory();
+    }, N);
+    run("proxy/Particle x += vx*dt, SoaVector proxies", [&] {
+        for(auto p : soa) p.get<0>() += p.get<3>()*dt;
+        bench::clobberMemory();
+    }, N);
+
+    return run.finish();
+}
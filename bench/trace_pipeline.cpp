@@ -0,0 +1,99 @@
+// A small multi-stage Image pipeline built with MATRIX_TRACE=1, to look at
+// the spans it records and at what a span costs.
+//
+// Writes trace_pipeline.json (or the path given with --trace=); open it in
+// https://ui.perfetto.dev. One thread loads frames, two threads convert them
+// to gray and blur them, so every stage shows up on its own track.
+
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Bench.h"
+#include "ImageIO.h"
+#include "Kernels.h"
+
+using namespace std;
+
+int
+main(int argc, char* argv[]) {
+    string tracePath = "trace_pipeline.json";
+    vector<char*> benchArgs{argv[0]};
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strncmp(argv[i], "--trace=", 8) == 0) tracePath = argv[i] + 8;
+        else benchArgs.push_back(argv[i]);
+    }
+    bench::Runner run(static_cast<int>(benchArgs.size()), benchArgs.data());
+
+    // overhead of the instrumentation itself
+    run("trace/empty span", [] { TRACE_SPAN("empty"); });
+    run("trace/timestamp", [] { bench::doNotOptimize(trace::now()); });
+    trace::clear();
+
+    const int FRAMES = 16, ROWS = 720, COLS = 1280;
+    {
+        Image frame(ROWS, COLS);
+        for(auto& px : frame) px = Color(uint8_t(&px - frame.begin()), 0x40, 0x80);
+        writePNM("trace_pipeline_frame.ppm", frame);
+    }
+
+    mutex lock;
+    condition_variable ready;
+    queue<Image> frames;
+    bool done = false;
+
+    thread loader([&] {
+        for(int i = 0; i < FRAMES; ++i)
+        {
+            Image img = readPPM("trace_pipeline_frame.ppm");
+            lock_guard<mutex> guard(lock);
+            frames.push(std::move(img));
+            ready.notify_one();
+        }
+        lock_guard<mutex> guard(lock);
+        done = true;
+        ready.notify_all();
+    });
+
+    auto worker = [&] {
+        Matrix<uint8_t> gray;
+        Matrix<float> grayF, blurred, kernel(3, 3);
+        for(auto& w : kernel) w = 1.f/9;
+        Image img;
+        for(;;)
+        {
+            {
+                unique_lock<mutex> guard(lock);
+                ready.wait(guard, [&] { return done || !frames.empty(); });
+                if(frames.empty()) return;
+                img = std::move(frames.front());
+                frames.pop();
+            }
+            toGray(img, gray);
+            reshape(grayF, gray.nRows, gray.nCols);
+            {
+                TRACE_SPAN("gray to float");
+                transform(gray.begin(), gray.end(), grayF.begin(), [](uint8_t v) { return float(v); });
+            }
+            convolve(grayF, kernel, blurred);
+            float lo, hi;
+            minMax(blurred, lo, hi);
+            bench::doNotOptimize(hi - lo);
+        }
+    };
+    thread w1(worker), w2(worker);
+    loader.join();
+    w1.join();
+    w2.join();
+
+    if(trace::writeChromeTrace(tracePath))
+        cout << "wrote " << tracePath << endl;
+    else
+        cout << "could not write " << tracePath << endl;
+    return run.finish();
+}
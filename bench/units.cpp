@@ -0,0 +1,89 @@
+// Is units::Quantity (04.10/Units.h) really free? The same Euler step
+// (v += a*dt, x += v*dt) over 4096 bodies, once on bare doubles and once on
+// Length/Velocity/Acceleration/Time:
+//
+//   units/raw double      double arrays
+//   units/quantity        Quantity arrays, same loop
+//
+// Both kernels are extern "C" and noinline so the disassembly check can
+// find them: `cmake --build build --target check_units_disassembly` diffs
+// their instructions (bench/CompareDisassembly.cmake) and fails if the
+// Quantity version compiles to anything different.
+//
+// The static_asserts below are the compile-time half: conversions of
+// literals are constants the compiler already knows.
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "Bench.h"
+#include "Units.h"
+
+using namespace std;
+using namespace units;
+using namespace units::literals;
+
+static_assert((1.0_km).value() == 1000.0, "km literal is not folded");
+static_assert((3_min).value() == 180.0, "min literal is not folded");
+static_assert((36.0_kmh).value() == 10.0, "km/h literal is not folded");
+static_assert(std::is_same<decltype(9.81_ms2*2.0_s), Velocity>::value, "a*t must be a velocity");
+static_assert(std::is_same<decltype(1.0_kg*9.81_ms2*1.0_m), Energy>::value, "m*a*d must be an energy");
+static_assert((1.0_km/1.0_m) == 1000.0, "a ratio of lengths is a plain number");
+
+extern "C" __attribute__((noinline))
+void units_step_raw(double* __restrict x, double* __restrict v, const double* __restrict a, size_t n, double dt)
+{
+    for(size_t i = 0; i < n; ++i)
+    {
+        v[i] += a[i]*dt;
+        x[i] += v[i]*dt;
+    }
+}
+
+extern "C" __attribute__((noinline))
+void units_step_quantity(Length* __restrict x, Velocity* __restrict v, const Acceleration* __restrict a, size_t n, Time dt)
+{
+    for(size_t i = 0; i < n; ++i)
+    {
+        v[i] += a[i]*dt;
+        x[i] += v[i]*dt;
+    }
+}
+
+int
+main(int argc, char* argv[]) {
+    bench::Runner run(argc, argv);
+    const size_t N = 4096;
+
+    vector<double> x(N), v(N), a(N);
+    vector<Length> xq(N);
+    vector<Velocity> vq(N);
+    vector<Acceleration> aq(N);
+    for(size_t i = 0; i < N; ++i)
+    {
+        a[i] = 9.81*std::sin(double(i));
+        aq[i] = Acceleration(a[i]);
+    }
+
+    // same arithmetic in the same order, so the results must match bit for bit
+    units_step_raw(x.data(), v.data(), a.data(), N, 0.01);
+    units_step_quantity(xq.data(), vq.data(), aq.data(), N, 10.0_ms);
+    for(size_t i = 0; i < N; ++i)
+        if(x[i] != xq[i].value() || v[i] != vq[i].value())
+        {
+            std::cerr << "quantity result differs at " << i << std::endl;
+            return 1;
+        }
+
+    run("units/raw double", [&] {
+        units_step_raw(x.data(), v.data(), a.data(), N, 0.01);
+        bench::clobberMemory();
+    }, N);
+    run("units/quantity", [&] {
+        units_step_quantity(xq.data(), vq.data(), aq.data(), N, 10.0_ms);
+        bench::clobberMemory();
+    }, N);
+
+    return run.finish();
+}
@@ -0,0 +1,189 @@
+// The color-space conversions of Kernels.h, every ISA variant this CPU runs,
+// against a double-precision reference: exhaustively where it is cheap (all
+// 2^24 RGB or HSV triples). The error bounds documented in Kernels.h, at
+// most 1 everywhere, come from here.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+#include "Kernels.h"
+
+using namespace std;
+
+namespace reference
+{
+    int round8(double x) { return static_cast<int>(std::floor(std::min(std::max(x, 0.0), 255.0) + 0.5)); }
+
+    double luma(double r, double g, double b) { return 0.299*r + 0.587*g + 0.114*b; }
+    double cb(double r, double g, double b) { return -0.168736*r - 0.331264*g + 0.5*b + 128; }
+    double cr(double r, double g, double b) { return 0.5*r - 0.418688*g - 0.081312*b + 128; }
+
+    // hue in 1/256 turns, saturation and value 0..255, unrounded
+    void hsv(int r, int g, int b, double& h, double& s, double& v)
+    {
+        const int mx = max(r, max(g, b)), mn = min(r, min(g, b));
+        const double d = mx - mn;
+        v = mx;
+        s = mx ? 255.0*d/mx : 0.0;
+        if(d == 0) { h = 0; return; }
+        double sixths = mx == r ? (g - b)/d : mx == g ? 2 + (b - r)/d : 4 + (r - g)/d;
+        h = std::fmod(sixths*256/6 + 256, 256);
+    }
+
+    void rgb(int h, int s, int v, double& r, double& g, double& b)
+    {
+        const double hh = h*6/256.0, ss = s/255.0;
+        const int sector = static_cast<int>(hh);
+        const double f = hh - sector;
+        const double p = v*(1 - ss), q = v*(1 - ss*f), t = v*(1 - ss*(1 - f));
+        switch(sector)
+        {
+            case 0: r = v; g = t; b = p; break;
+            case 1: r = q; g = v; b = p; break;
+            case 2: r = p; g = v; b = t; break;
+            case 3: r = p; g = q; b = v; break;
+            case 4: r = t; g = p; b = v; break;
+            default: r = v; g = p; b = q; break;
+        }
+    }
+
+    // per pixel in float, U and V from the mean of each 2x2 block
+    void toYuv420(const Image& img, Yuv420& yuv)
+    {
+        for(int i = 0; i < img.nRows; ++i)
+            for(int j = 0; j < img.nCols; ++j)
+            {
+                const Color c = img.unchecked(i, j);
+                yuv.y.unchecked(i, j) = static_cast<uint8_t>(reference::round8(reference::luma(c.r, c.g, c.b)));
+            }
+        for(int i = 0; i < yuv.u.nRows; ++i)
+            for(int j = 0; j < yuv.u.nCols; ++j)
+            {
+                float r = 0, g = 0, b = 0;
+                for(int k = 0; k < 4; ++k)
+                {
+                    const Color c = img.unchecked(min(2*i + k/2, img.nRows - 1), min(2*j + k%2, img.nCols - 1));
+                    r += c.r/4.f, g += c.g/4.f, b += c.b/4.f;
+                }
+                yuv.u.unchecked(i, j) = static_cast<uint8_t>(reference::round8(reference::cb(r, g, b)));
+                yuv.v.unchecked(i, j) = static_cast<uint8_t>(reference::round8(reference::cr(r, g, b)));
+            }
+    }
+}
+
+// every RGB triple once, as a 4096 x 4096 Image
+Image allColors()
+{
+    Image img(4096, 4096);
+    for(size_t i = 0; i < img.numElements(); ++i)
+        img.mem[i] = Color(uint8_t(i >> 16), uint8_t(i >> 8), uint8_t(i));
+    return img;
+}
+
+int hueError(int a, double b)
+{
+    double d = std::fabs(a - b);
+    return static_cast<int>(std::ceil(std::min(d, 256 - d) - 1e-9));
+}
+
+bool checkAccuracy(const KernelTable& k, const Image& colors)
+{
+    int errY = 0, errUV = 0, errRgb = 0, errH = 0, errSV = 0, errHsvRgb = 0;
+
+    // Y over every color; U and V per 2x2 block of random pixels
+    Yuv420 yuv;
+    reshape(yuv.y, colors.nRows, colors.nCols);
+    reshape(yuv.u, colors.nRows/2, colors.nCols/2);
+    reshape(yuv.v, colors.nRows/2, colors.nCols/2);
+    k.rgbToYuv420(colors.mem, colors.nRows, colors.nCols, yuv.y.mem, yuv.u.mem, yuv.v.mem);
+    for(size_t i = 0; i < colors.numElements(); ++i)
+    {
+        const Color c = colors.mem[i];
+        errY = max(errY, abs(yuv.y.mem[i] - reference::round8(reference::luma(c.r, c.g, c.b))));
+    }
+    {
+        mt19937 gen(5);
+        Image img(512, 513);        // odd width: the last chroma column repeats its pixel
+        for(auto& px : img) px = Color(gen() & 0xff, gen() & 0xff, gen() & 0xff);
+        Yuv420 small;
+        reshape(small.y, img.nRows, img.nCols);
+        reshape(small.u, (img.nRows + 1)/2, (img.nCols + 1)/2);
+        reshape(small.v, (img.nRows + 1)/2, (img.nCols + 1)/2);
+        k.rgbToYuv420(img.mem, img.nRows, img.nCols, small.y.mem, small.u.mem, small.v.mem);
+        Yuv420 expected = small;
+        reference::toYuv420(img, expected);
+        for(size_t i = 0; i < small.u.numElements(); ++i)
+            errUV = max(errUV, max(abs(small.u.mem[i] - expected.u.mem[i]), abs(small.v.mem[i] - expected.v.mem[i])));
+    }
+
+    // YUV -> RGB: every Y, chroma on a grid, only where the exact result is in gamut
+    {
+        const int STEP = 3, N = 256/STEP + 1, cols = 2*N*N;
+        Matrix<uint8_t> y(2, cols), u(1, N*N), v(1, N*N);
+        Image out(2, cols);
+        for(int a = 0; a < N; ++a)
+            for(int b = 0; b < N; ++b)
+            {
+                u.mem[a*N + b] = static_cast<uint8_t>(min(a*STEP, 255));
+                v.mem[a*N + b] = static_cast<uint8_t>(min(b*STEP, 255));
+            }
+        for(int l = 0; l < 256; ++l)
+        {
+            for(auto& px : y) px = static_cast<uint8_t>(l);
+            k.yuv420ToRgb(y.mem, u.mem, v.mem, 2, cols, out.mem);
+            for(int j = 0; j < cols; ++j)
+            {
+                const double du = u.mem[j/2] - 128.0, dv = v.mem[j/2] - 128.0;
+                const double r = l + 1.402*dv, g = l - 0.344136*du - 0.714136*dv, b = l + 1.772*du;
+                if(r < 0 || r > 255 || g < 0 || g > 255 || b < 0 || b > 255) continue;
+                const Color c = out.mem[j];
+                errRgb = max({errRgb, abs(c.r - reference::round8(r)), abs(c.g - reference::round8(g)),
+                              abs(c.b - reference::round8(b))});
+            }
+        }
+    }
+
+    // RGB -> HSV over every color
+    Matrix<Hsv> hsv(colors.nRows, colors.nCols);
+    k.rgbToHsv(colors.mem, hsv.mem, colors.numElements());
+    for(size_t i = 0; i < colors.numElements(); ++i)
+    {
+        double h, s, v;
+        reference::hsv(colors.mem[i].r, colors.mem[i].g, colors.mem[i].b, h, s, v);
+        if(s > 0) errH = max(errH, hueError(hsv.mem[i].h, h));
+        errSV = max({errSV, abs(hsv.mem[i].s - reference::round8(s)), abs(hsv.mem[i].v - reference::round8(v))});
+    }
+
+    // HSV -> RGB over every triple
+    for(size_t i = 0; i < hsv.numElements(); ++i)
+        hsv.mem[i] = Hsv(uint8_t(i >> 16), uint8_t(i >> 8), uint8_t(i));
+    Image rgb(colors.nRows, colors.nCols);
+    k.hsvToRgb(hsv.mem, rgb.mem, hsv.numElements());
+    for(size_t i = 0; i < hsv.numElements(); ++i)
+    {
+        double r, g, b;
+        reference::rgb(hsv.mem[i].h, hsv.mem[i].s, hsv.mem[i].v, r, g, b);
+        errHsvRgb = max({errHsvRgb, abs(rgb.mem[i].r - reference::round8(r)), abs(rgb.mem[i].g - reference::round8(g)),
+                         abs(rgb.mem[i].b - reference::round8(b))});
+    }
+
+    printf("%-9s max error: Y %d, UV %d, YUV->RGB %d, H %d, SV %d, HSV->RGB %d\n", cpu::isaName(k.isa),
+           errY, errUV, errRgb, errH, errSV, errHsvRgb);
+    return errY <= 1 && errUV <= 1 && errRgb <= 1 && errH <= 1 && errSV <= 1 && errHsvRgb <= 1;
+}
+
+int
+main() {
+    const Image colors = allColors();
+    bool ok = true;
+    for(cpu::Isa isa : cpu::allIsas)
+        if(isa <= cpu::detectIsa()) ok = checkAccuracy(kernelsFor(isa), colors) && ok;
+    if(!ok)
+    {
+        printf("FAILED: a conversion exceeds its documented error bound\n");
+        return 1;
+    }
+    return 0;
+}
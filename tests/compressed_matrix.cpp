@@ -0,0 +1,103 @@
+// CompressedMatrix has to give back exactly what went in, through
+// decompress(), row() and decodeTile(), for every block mode: constant rows,
+// runs, and packed deltas, including packed rows with flat stretches (a
+// group of deltas 0 bits wide).
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "CompressedMatrix.h"
+
+using namespace std;
+
+void check(bool ok, const string& what)
+{
+    if(ok) return;
+    cout << "FAILED: " << what << endl;
+    exit(1);
+}
+
+template<typename T>
+void checkRoundTrip(const Matrix<T>& original, int tileSize, const string& what)
+{
+    CompressedMatrix<T> packed(original, tileSize);
+    const string name = what + " (tile " + to_string(tileSize) + ")";
+    Matrix<T> back = packed.decompress();
+    check(equal(back.begin(), back.end(), original.begin()), name + " decompress");
+    for(int i = 0; i < original.nRows; ++i)
+    {
+        Span<const T> r = packed.row(i);
+        check(equal(r.begin(), r.end(), original.row(i).begin()), name + " row " + to_string(i));
+    }
+    const int t = packed.tileDim();
+    vector<T> tile(static_cast<size_t>(t)*t);
+    for(int tr = 0; tr < packed.numTileRows(); ++tr)
+        for(int tc = 0; tc < packed.numTileCols(); ++tc)
+        {
+            packed.decodeTile(tr, tc, tile.data(), t);
+            const int rows = min(t, original.nRows - tr*t), cols = min(t, original.nCols - tc*t);
+            for(int r = 0; r < rows; ++r)
+                for(int c = 0; c < cols; ++c)
+                    check(tile[r*t + c] == original(tr*t + r, tc*t + c), name + " decodeTile");
+        }
+}
+
+template<typename T>
+void checkAllTileSizes(const Matrix<T>& original, const string& what)
+{
+    for(int tileSize : {1, 16, 64, 256}) checkRoundTrip(original, tileSize, what);
+}
+
+int
+main() {
+    mt19937 gen(9);
+
+    // noise around a level with flat stretches of 17 to 40 pixels: packed rows whose flat
+    // groups have width 0
+    Matrix<uint16_t> flatRuns(64, 300);
+    for(int i = 0; i < flatRuns.nRows; ++i)
+        for(int j = 0; j < flatRuns.nCols;)
+        {
+            const int len = 17 + gen() % 24;
+            const uint16_t level = static_cast<uint16_t>(1000 + gen() % 50);
+            for(int k = 0; k < len && j < flatRuns.nCols; ++k, ++j) flatRuns.unchecked(i, j) = level;
+            for(int k = 0; k < 5 && j < flatRuns.nCols; ++k, ++j)
+                flatRuns.unchecked(i, j) = static_cast<uint16_t>(level + gen() % 3);
+        }
+    checkAllTileSizes(flatRuns, "flat runs");
+    Matrix<uint8_t> flatRuns8(flatRuns.nRows, flatRuns.nCols);
+    for(size_t i = 0; i < flatRuns.numElements(); ++i) flatRuns8.mem[i] = static_cast<uint8_t>(flatRuns.mem[i]);
+    checkAllTileSizes(flatRuns8, "flat runs, 8 bit");
+
+    // a mask: long runs of a few labels
+    Matrix<uint8_t> mask(100, 130);
+    for(int i = 0; i < mask.nRows; ++i)
+        for(int j = 0; j < mask.nCols; ++j) mask.unchecked(i, j) = static_cast<uint8_t>((i/20 + j/33) % 3*120);
+    checkAllTileSizes(mask, "mask");
+
+    // sizes that leave partial tiles, tiny and constant matrices, worst-case noise
+    Matrix<uint16_t> odd(67, 131), flat(5, 3), one(1, 1), noisy(100, 100);
+    for(auto& v : odd) v = static_cast<uint16_t>(gen() % 7 == 0 ? gen() : 1000 + gen() % 3);
+    for(auto& v : flat) v = 42;
+    one.mem[0] = 65535;
+    for(auto& v : noisy) v = static_cast<uint16_t>(gen());
+    checkAllTileSizes(odd, "odd sizes");
+    checkAllTileSizes(flat, "constant");
+    checkAllTileSizes(one, "1x1");
+    checkAllTileSizes(noisy, "white noise");
+    check(CompressedMatrix<uint16_t>(noisy, 256).ratio() > 0.9, "white noise costs at most a few bytes per row");
+
+    for(int tileSize : {0, -1, 257})
+    {
+        bool threw = false;
+        try { CompressedMatrix<uint16_t> bad(noisy, tileSize); }
+        catch(const invalid_argument&) { threw = true; }
+        check(threw, "tile size " + to_string(tileSize) + " is rejected");
+    }
+
+    cout << "CompressedMatrix round-trips" << endl;
+    return 0;
+}
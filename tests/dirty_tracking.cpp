@@ -0,0 +1,104 @@
+// TrackedMatrix and its incremental consumers: after every round of edits
+// (single pixels, rectangles hanging over the edge, nothing at all), with
+// several tile sizes and filter radii up to beyond a tile, the incremental
+// results are bit for bit boxFilter() and plain full-image loops.
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+
+#include "TrackedMatrix.h"
+
+using namespace std;
+
+template<typename T>
+Matrix<T> referenceDownsample(const Matrix<T>& src, int factor)
+{
+    Matrix<T> out(src.nRows/factor, src.nCols/factor);
+    for(int i = 0; i < out.nRows; ++i)
+        for(int j = 0; j < out.nCols; ++j)
+        {
+            typename SatTraits<T>::Sum s = 0;
+            for(int y = 0; y < factor; ++y)
+                for(int x = 0; x < factor; ++x) s = s + src.unchecked(i*factor + y, j*factor + x);
+            out.unchecked(i, j) = tracked_detail::meanPixel(s, 1.0/(factor*factor));
+        }
+    return out;
+}
+
+template<typename T>
+bool sameMatrix(const Matrix<T>& a, const Matrix<T>& b)
+{
+    return a.nRows == b.nRows && a.nCols == b.nCols && memcmp(a.mem, b.mem, a.numElements()*sizeof(T)) == 0;
+}
+
+template<typename T>
+bool statsMatch(const IncrementalStats<T>& stats, const Matrix<T>& src)
+{
+    const int C = tracked_detail::channels<T>();
+    for(int k = 0; k < C; ++k)
+    {
+        double s = 0, lo = INFINITY, hi = -INFINITY;
+        for(const T& v : src)
+        {
+            const double x = tracked_detail::channel(v, k);
+            s += x;
+            lo = min(lo, x);
+            hi = max(hi, x);
+        }
+        // integer pixels, so the sums are exact in any order
+        if(stats.sum(k) != s || stats.min(k) != lo || stats.max(k) != hi) return false;
+    }
+    return true;
+}
+
+template<typename T>
+bool allMatch(const TrackedMatrix<T>& img, const IncrementalBoxFilter<T>& blur, int radius,
+              const IncrementalDownsample<T>& down, int factor, const IncrementalStats<T>& stats)
+{
+    Matrix<T> full;
+    boxFilter(img.matrix(), radius, full);
+    return sameMatrix(blur.output(), full) && sameMatrix(down.output(), referenceDownsample(img.matrix(), factor)) &&
+           statsMatch(stats, img.matrix());
+}
+
+template<typename T, typename RANDOM_PIXEL>
+bool checkSmall(RANDOM_PIXEL randomPixel)
+{
+    mt19937 gen(11);
+    for(int tileSize : {8, 16, 64})
+        for(int radius : {0, 1, 5, 20})
+        {
+            Matrix<T> start(50, 77);
+            for(auto& px : start) px = randomPixel(gen);
+            TrackedMatrix<T> img(start, tileSize);
+            IncrementalBoxFilter<T> blur(img, radius);
+            IncrementalDownsample<T> down(img, 3);
+            IncrementalStats<T> stats(img);
+            for(int round = 0; round < 30; ++round)
+            {
+                blur.update();
+                down.update();
+                stats.update();
+                if(!allMatch(img, blur, radius, down, 3, stats)) return false;
+                // a few pixels, a rectangle that may hang over the edge, sometimes nothing
+                for(int k = 0; k < round % 4; ++k) img.set(gen() % img.nRows, gen() % img.nCols, randomPixel(gen));
+                if(round % 3 == 0) img.fill(int(gen() % 60) - 5, int(gen() % 90) - 5, gen() % 12, gen() % 12, randomPixel(gen));
+            }
+        }
+    return true;
+}
+
+int
+main() {
+    auto randomGray = [](mt19937& g) { return static_cast<uint8_t>(g()); };
+    auto randomColor = [](mt19937& g) { return Color(g() & 0xff, g() & 0xff, g() & 0xff); };
+    if(!checkSmall<uint8_t>(randomGray) || !checkSmall<Color>(randomColor))
+    {
+        cout << "FAILED: incremental results differ from full recomputation" << endl;
+        return 1;
+    }
+    cout << "incremental results match full recomputation" << endl;
+    return 0;
+}
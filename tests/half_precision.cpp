@@ -0,0 +1,150 @@
+// The float16/bfloat16 conversions of Kernels.h, every ISA variant this CPU
+// runs: exhaustively over all 65536 float16 patterns, and on random floats,
+// values around the float16 subnormal and overflow thresholds, exact ties
+// and the specials against a reference rounding. Then the Half.h front ends
+// (sum, minMax, transformInFloat) against plain loops.
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "Kernels.h"
+
+using namespace std;
+
+bool sameFloat(float a, float b)
+{
+    // NaN payloads may differ (F16C quiets signalling ones), NaN-ness may not
+    return isnan(a) ? isnan(b) : half_detail::bitsOf(a) == half_detail::bitsOf(b);
+}
+
+// the nearest bfloat16 to x, ties to even, worked out in double
+uint16_t referenceBfloat(float x)
+{
+    const uint32_t bits = half_detail::bitsOf(x);
+    if(isnan(x)) return static_cast<uint16_t>((bits >> 16) | 0x40);
+    if(isinf(x)) return static_cast<uint16_t>(bits >> 16);
+    const uint16_t down = static_cast<uint16_t>(bits >> 16), up = static_cast<uint16_t>(down + 1);
+    const double dDown = fabs(double(x) - half_detail::bfloatBitsToFloat(down));
+    // rounding up from the largest finite value gives infinity, but the tie point is still 2^128
+    const double upValue = (up & 0x7fff) == 0x7f80 ? copysign(ldexp(1.0, 128), x) : half_detail::bfloatBitsToFloat(up);
+    const double dUp = fabs(double(x) - upValue);
+    if(dDown != dUp) return dDown < dUp ? down : up;
+    return down & 1 ? up : down;
+}
+
+bool checkConversions(const KernelTable& k, const vector<float>& samples)
+{
+    vector<float16> halves(65536);
+    for(uint32_t i = 0; i < 65536; ++i) halves[i] = float16::fromBits(static_cast<uint16_t>(i));
+    vector<float> floats(65536);
+    k.halfToFloat(halves.data(), floats.data(), halves.size());
+    for(uint32_t i = 0; i < 65536; ++i)
+    {
+        if(!sameFloat(floats[i], half_detail::halfBitsToFloat(static_cast<uint16_t>(i)))) return false;
+#if defined(__FLT16_MAX__)
+        _Float16 ref;
+        memcpy(&ref, &halves[i], 2);
+        if(!sameFloat(floats[i], float(ref))) return false;
+#endif
+    }
+    // every float16 survives the round trip
+    vector<float16> back(65536);
+    k.floatToHalf(floats.data(), back.data(), floats.size());
+    for(uint32_t i = 0; i < 65536; ++i)
+        if(!isnan(floats[i]) && back[i].bits != i) return false;
+
+    vector<float16> h(samples.size());
+    vector<bfloat16> b(samples.size());
+    k.floatToHalf(samples.data(), h.data(), samples.size());
+    k.floatToBfloat(samples.data(), b.data(), samples.size());
+    for(size_t i = 0; i < samples.size(); ++i)
+    {
+#if defined(__FLT16_MAX__)
+        const _Float16 ref = static_cast<_Float16>(samples[i]);
+        uint16_t refBits;
+        memcpy(&refBits, &ref, 2);
+        if(isnan(samples[i]) ? !isnan(float(h[i])) : h[i].bits != refBits) return false;
+#else
+        if(isnan(samples[i]) && !isnan(float(h[i]))) return false;
+#endif
+        // NaN payloads: F16C keeps the top mantissa bits, the software path a canonical quiet NaN
+        if(isnan(samples[i]) ? !isnan(float(float16(samples[i]))) : h[i].bits != float16(samples[i]).bits) return false;
+        if(b[i].bits != referenceBfloat(samples[i])) return false;
+    }
+    vector<float> wide(samples.size());
+    k.bfloatToFloat(b.data(), wide.data(), b.size());
+    for(size_t i = 0; i < b.size(); ++i)
+        if(!sameFloat(wide[i], float(b[i]))) return false;
+    return true;
+}
+
+int
+main() {
+    // ordinary values, values around the float16 subnormal and overflow
+    // thresholds, exact ties, and the specials
+    mt19937 gen(5);
+    vector<float> samples;
+    for(int i = 0; i < 200000; ++i) samples.push_back(half_detail::floatOf(gen()));
+    uniform_real_distribution<float> unit(-1.f, 1.f);
+    for(float scale : {1e-8f, 6e-5f, 1.f, 1000.f, 65504.f, 70000.f})
+        for(int i = 0; i < 20000; ++i) samples.push_back(scale*unit(gen));
+    for(uint32_t h = 0; h < 0x7c00; h += 7)
+    {
+        // halfway between two float16 values, and either side of it
+        const uint32_t mid = half_detail::bitsOf(half_detail::halfBitsToFloat(static_cast<uint16_t>(h))) + (1u << 12);
+        for(uint32_t m : {mid - 1, mid, mid + 1}) samples.push_back(half_detail::floatOf(m));
+    }
+    for(float v : {0.f, -0.f, INFINITY, -INFINITY, NAN, 65504.f, 65520.f, 65519.99f, 5.96e-8f, 2.98e-8f, 2.99e-8f})
+        samples.push_back(v);
+
+    for(cpu::Isa isa : cpu::allIsas)
+    {
+        if(isa > cpu::detectIsa()) break;
+        if(!checkConversions(kernelsFor(isa), samples))
+        {
+            printf("FAILED: 16 bit float conversions (%s) are wrong\n", cpu::isaName(isa));
+            return 1;
+        }
+    }
+
+    // the front ends against plain loops over the same values
+    Matrix<float> f(300, 257);
+    normal_distribution<float> normal(0.f, 100.f);
+    for(auto& v : f) v = normal(gen);
+    Matrix<float16> h;
+    Matrix<bfloat16> b;
+    convert(f, h);
+    convert(f, b);
+    {
+        double sumH = 0;
+        float loH = INFINITY, hiH = -INFINITY;
+        for(size_t i = 0; i < f.numElements(); ++i)
+        {
+            sumH += h.mem[i];
+            loH = min(loH, float(h.mem[i]));
+            hiH = max(hiH, float(h.mem[i]));
+        }
+        float lo, hi;
+        minMax(h, lo, hi);
+        const double s = sum(h);
+        bool ok = lo == loH && hi == hiH && fabs(s - sumH) <= 1e-4*fabs(sumH) + 1;
+
+        Matrix<float16> y;
+        transformInFloat(h, y, [](float x) { return 0.5f*x + 1; });
+        Matrix<bfloat16> z;
+        transformInFloat(h, b, z, [](float x, float w) { return x - w; });
+        for(size_t i = 0; i < f.numElements(); ++i)
+            ok = ok && y.mem[i].bits == float16(0.5f*h.mem[i] + 1).bits &&
+                 z.mem[i].bits == bfloat16(float(h.mem[i]) - float(b.mem[i])).bits;
+        if(!ok)
+        {
+            printf("FAILED: sum/minMax/transformInFloat on float16 disagree with plain loops\n");
+            return 1;
+        }
+    }
+    printf("float16 and bfloat16 conversions round correctly\n");
+    return 0;
+}
@@ -0,0 +1,132 @@
+// PGM/PPM files written by ImageIO.h read back the same, whole and a strip
+// at a time; 16 bit samples are big-endian in the file and the caller's
+// strip is left alone; bad files and short writes are reported.
+
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+#include "ImageIO.h"
+
+using namespace std;
+
+void check(bool ok, const string& what)
+{
+    if(ok) return;
+    cout << "FAILED: " << what << endl;
+    exit(1);
+}
+
+template<typename FUNC>
+bool throws(FUNC&& func)
+{
+    try { func(); }
+    catch(const exception&) { return true; }
+    return false;
+}
+
+template<typename T>
+bool same(const Matrix<T>& a, const Matrix<T>& b)
+{
+    return a.nRows == b.nRows && a.nCols == b.nCols &&
+           equal(a.begin(), a.end(), b.begin(), [](const T& x, const T& y) { return memcmp(&x, &y, sizeof(T)) == 0; });
+}
+
+string readFile(const string& path)
+{
+    ifstream in(path, ios::binary);
+    return string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+// through writePNM/readPNM, and through strips of 7 rows (the last one partial) both ways
+template<typename T>
+void checkRoundTrip(const Matrix<T>& src, const string& path, const string& what)
+{
+    writePNM(path, src);
+    check(same(readPNM<T>(path), src), what + " whole image");
+
+    Matrix<T> strip(7, src.nCols);
+    {
+        PnmWriter<T> out(path, src.nCols, src.nRows);
+        for(int row = 0; row < src.nRows; row += strip.nRows)
+        {
+            const int n = min(strip.nRows, src.nRows - row);
+            copy(src.mem + static_cast<size_t>(row)*src.nCols, src.mem + static_cast<size_t>(row + n)*src.nCols, strip.mem);
+            const Matrix<T> before = strip;
+            out.writeRows(strip, n);
+            check(same(strip, before), what + " writeRows leaves the strip alone");
+        }
+        check(out.rowsLeft() == 0, what + " rowsLeft");
+        out.close();
+    }
+    PnmReader<T> in(path);
+    check(in.width() == src.nCols && in.height() == src.nRows, what + " header");
+    int row = 0;
+    while(int n = in.readRows(strip))
+    {
+        for(int i = 0; i < n; ++i)
+            for(int j = 0; j < src.nCols; ++j)
+                check(memcmp(&strip(i, j), &src(row + i, j), sizeof(T)) == 0, what + " strips");
+        row += n;
+    }
+    check(row == src.nRows && in.rowsLeft() == 0, what + " every row read");
+}
+
+int
+main() {
+    const string path = (filesystem::temp_directory_path() / "test_image_io.pnm").string();
+
+    Image img(37, 23);
+    for(size_t i = 0; i < img.numElements(); ++i) img.mem[i] = Color(uint8_t(i), uint8_t(i*7), uint8_t(i >> 3));
+    Matrix<uint8_t> gray(37, 23);
+    for(size_t i = 0; i < gray.numElements(); ++i) gray.mem[i] = uint8_t(i*13);
+    Matrix<uint16_t> depth(37, 23);
+    for(size_t i = 0; i < depth.numElements(); ++i) depth.mem[i] = uint16_t(0x1234 + i*257);
+
+    checkRoundTrip(img, path, "PPM");
+    checkRoundTrip(gray, path, "PGM 8 bit");
+    checkRoundTrip(depth, path, "PGM 16 bit");
+
+    // 16 bit samples are big-endian in the file, after the header
+    writePNM(path, depth);
+    const string file = readFile(path);
+    const size_t raster = file.size() - depth.numElements()*2;
+    check(file.compare(0, raster, "P5\n23 37\n65535\n") == 0, "16 bit header");
+    check(uint8_t(file[raster]) == 0x12 && uint8_t(file[raster + 1]) == 0x34, "16 bit samples are big-endian");
+
+    // comments and odd whitespace in the header
+    {
+        ofstream out(path, ios::binary);
+        out << "P5 # a comment\n2\t# another\r\n 2\n255\n";
+        out.write("\x01\x02\x03\x04", 4);
+    }
+    Matrix<uint8_t> tiny = readPNM<uint8_t>(path);
+    check(tiny.nRows == 2 && tiny.nCols == 2 && tiny(1, 0) == 3, "header comments");
+
+    // wrong kind of file, a 16 bit reader on an 8 bit file, a raster cut short
+    check(throws([&] { readPPM(path); }), "a PGM is not a PPM");
+    check(throws([&] { readPNM<uint16_t>(path); }), "maxval 255 is not 16 bit");
+    writePNM(path, gray);
+    filesystem::resize_file(path, filesystem::file_size(path) - 10);
+    check(throws([&] { readPNM<uint8_t>(path); }), "short raster");
+    check(throws([&] { readPNM<uint8_t>(path + ".missing"); }), "missing file");
+
+    // too many rows, and closing with rows missing
+    {
+        PnmWriter<uint8_t> out(path, gray.nCols, gray.nRows);
+        Matrix<uint8_t> strip(gray.nRows + 1, gray.nCols);
+        check(throws([&] { out.writeRows(strip); }), "more rows than the image");
+        out.writeRows(strip, 3);
+        check(throws([&] { out.close(); }), "close with rows missing");
+        out.close();
+    }
+
+    filesystem::remove(path);
+    cout << "PNM files round-trip" << endl;
+    return 0;
+}
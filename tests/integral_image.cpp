@@ -0,0 +1,104 @@
+// The summed-area table filters (IntegralImage.h) have to match rescanning
+// every window, at the borders too, with one thread and with several.
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "IntegralImage.h"
+
+using namespace std;
+
+void check(bool ok, const string& what)
+{
+    if(ok) return;
+    cout << "FAILED: " << what << endl;
+    exit(1);
+}
+
+void naiveBox(const Matrix<uint8_t>& src, int radius, Matrix<uint8_t>& dst)
+{
+    dst.init(src.nRows, src.nCols);
+    for(int i = 0; i < src.nRows; ++i)
+        for(int j = 0; j < src.nCols; ++j)
+        {
+            const int r0 = max(i - radius, 0), r1 = min(i + radius + 1, src.nRows);
+            const int c0 = max(j - radius, 0), c1 = min(j + radius + 1, src.nCols);
+            uint32_t s = 0;
+            for(int r = r0; r < r1; ++r)
+                for(int c = c0; c < c1; ++c) s += src.unchecked(r, c);
+            const uint32_t count = (r1 - r0)*(c1 - c0);
+            dst.unchecked(i, j) = static_cast<uint8_t>((s + count/2)/count);
+        }
+}
+
+int
+main() {
+    const int ROWS = 61, COLS = 97;
+    Matrix<uint8_t> gray(ROWS, COLS), red(ROWS, COLS);
+    Image img(ROWS, COLS);
+    for(int i = 0; i < ROWS; ++i)
+        for(int j = 0; j < COLS; ++j)
+        {
+            gray.unchecked(i, j) = static_cast<uint8_t>((i*7) ^ (j*13));
+            img.unchecked(i, j) = Color(uint8_t(i + j), uint8_t(i*3), uint8_t(j*5));
+            red.unchecked(i, j) = img.unchecked(i, j).r;
+        }
+
+    // sums over arbitrary rectangles, clipped at the borders
+    SummedAreaTable<uint32_t> sat(gray);
+    check(sat.nRows() == ROWS && sat.nCols() == COLS, "table size");
+    for(int r0 : {-5, 0, 17})
+        for(int c0 : {-3, 0, 40})
+            for(int size : {1, 9, 200})
+            {
+                uint32_t s = 0;
+                for(int r = max(r0, 0); r < min(r0 + size, ROWS); ++r)
+                    for(int c = max(c0, 0); c < min(c0 + size, COLS); ++c) s += gray.unchecked(r, c);
+                check(sat.sumClipped(r0, c0, r0 + size, c0 + size) == s, "sumClipped");
+            }
+
+    for(int nThreads : {1, 4})
+        for(int radius : {0, 1, 3, 40})
+        {
+            const string what = " r=" + to_string(radius) + ", " + to_string(nThreads) + " threads";
+            Matrix<uint8_t> expected, got;
+            naiveBox(gray, radius, expected);
+            boxFilter(gray, radius, got, nThreads);
+            check(equal(got.begin(), got.end(), expected.begin()), "boxFilter" + what);
+
+            // every channel of an Image filters like a gray image holding it
+            Image blurred;
+            boxFilter(img, radius, blurred, nThreads);
+            naiveBox(red, radius, expected);
+            for(size_t i = 0; i < red.numElements(); ++i)
+                check(blurred.mem[i].r == expected.mem[i], "boxFilter Image" + what);
+
+            Matrix<float> mean, var;
+            meanVariance(gray, radius, mean, var, nThreads);
+            for(int i : {0, ROWS/2, ROWS - 1})
+                for(int j : {0, COLS/3, COLS - 1})
+                {
+                    double s = 0, s2 = 0, n = 0;
+                    for(int r = max(i - radius, 0); r < min(i + radius + 1, ROWS); ++r)
+                        for(int c = max(j - radius, 0); c < min(j + radius + 1, COLS); ++c, ++n)
+                        {
+                            s += gray.unchecked(r, c);
+                            s2 += double(gray.unchecked(r, c))*gray.unchecked(r, c);
+                        }
+                    const double mu = s/n, v = s2/n - mu*mu;
+                    check(fabs(mean(i, j) - mu) < 1e-3 && fabs(var(i, j) - v) < 1e-3*max(v, 1.0), "meanVariance" + what);
+                }
+        }
+
+    // the variance of a constant region is exactly 0, the mean exactly the constant
+    Matrix<uint8_t> flat(64, 64);
+    for(auto& v : flat) v = 77;
+    Matrix<float> mean, var;
+    meanVariance(flat, 5, mean, var);
+    check(mean(10, 10) == 77.f && var(10, 10) == 0.f, "meanVariance of a constant");
+
+    cout << "summed-area table filters match the naive ones" << endl;
+    return 0;
+}
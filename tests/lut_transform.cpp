@@ -0,0 +1,115 @@
+// Lut.h: the constexpr tables match the same curves evaluated with <cmath>
+// at run time, every ISA's lookup kernels match a plain loop on random data
+// with lengths that leave tails, and the applyLut front ends do the same.
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Lut.h"
+
+using namespace std;
+
+// the predefined tables really are compile-time constants
+static_assert(luts::gamma22[0] == 0 && luts::gamma22[255] == 255 && luts::gamma22[128] == 186, "gamma22");
+static_assert(luts::srgbEncode[1] == 13 && luts::srgbDecode[255] == 255, "sRGB");
+static_assert(luts::srgbEncode16<>[65535] == 65535 && luts::srgbToLinear16[0] == 0, "16 bit sRGB");
+
+double runtimeSrgbEncode(double x) { return x <= 0.0031308 ? 12.92*x : 1.055*pow(x, 1/2.4) - 0.055; }
+double runtimeSrgbDecode(double x) { return x <= 0.04045 ? x/12.92 : pow((x + 0.055)/1.055, 2.4); }
+double runtimeSCurve(double x)
+{
+    const double s = 6, lo = 1/(1 + exp(s/2)), hi = 1/(1 + exp(-s/2));
+    return (1/(1 + exp(-s*(x - 0.5))) - lo)/(hi - lo);
+}
+
+// The constexpr series are within a few ulp of <cmath>, which can still tip
+// an entry sitting right on a rounding boundary: allow 1 off, nothing more.
+template<typename Out, size_t N, typename CURVE>
+bool matchesRuntime(const Lut<Out, N>& lut, CURVE curve)
+{
+    for(size_t i = 0; i < N; ++i)
+    {
+        const double y = min(max(curve(double(i)/(N - 1)), 0.0), 1.0)*numeric_limits<Out>::max();
+        if(fabs(double(lut[i]) - floor(y + 0.5)) > 1) return false;
+    }
+    return true;
+}
+
+bool checkTables()
+{
+    return matchesRuntime(luts::gamma22, [](double x) { return pow(x, 1/2.2); }) &&
+           matchesRuntime(luts::degamma22, [](double x) { return pow(x, 2.2); }) &&
+           matchesRuntime(luts::srgbEncode, runtimeSrgbEncode) && matchesRuntime(luts::srgbDecode, runtimeSrgbDecode) &&
+           matchesRuntime(luts::sCurve, runtimeSCurve) &&
+           matchesRuntime(luts::reinhard, [](double x) { return x*4/(1 + x*4)*5/4; }) &&
+           matchesRuntime(luts::srgbToLinear16, runtimeSrgbDecode) && matchesRuntime(luts::srgbEncode16<>, runtimeSrgbEncode);
+}
+
+bool checkKernels(const KernelTable& k, mt19937& gen)
+{
+    for(size_t n : {0, 1, 15, 16, 33, 63, 64, 65, 200, 1027})
+    {
+        vector<uint8_t> src8(n), dst8(n);
+        vector<uint16_t> src16(n), dst16(n);
+        for(size_t i = 0; i < n; ++i)
+        {
+            src8[i] = uint8_t(gen());
+            // both ends of the 16 bit table get hit, the last entry has its own path
+            src16[i] = i % 7 == 0 ? 65535 : i % 11 == 0 ? 0 : uint16_t(gen());
+        }
+        k.lookup8(src8.data(), dst8.data(), n, luts::sCurve.data());
+        k.lookup16(src16.data(), dst16.data(), n, luts::srgbEncode16<>.data());
+        for(size_t i = 0; i < n; ++i)
+            if(dst8[i] != luts::sCurve[src8[i]] || dst16[i] != luts::srgbEncode16<>[src16[i]]) return false;
+        // in place
+        k.lookup8(src8.data(), src8.data(), n, luts::sCurve.data());
+        if(src8 != dst8) return false;
+    }
+    return true;
+}
+
+int
+main() {
+    mt19937 gen(50);
+    if(!checkTables())
+    {
+        printf("FAILED: constexpr tables differ from the curves evaluated at run time\n");
+        return 1;
+    }
+    for(cpu::Isa isa : cpu::allIsas)
+    {
+        if(isa > cpu::detectIsa()) break;
+        if(!checkKernels(kernelsFor(isa), gen))
+        {
+            printf("FAILED: table lookups (%s) differ from a plain loop\n", cpu::isaName(isa));
+            return 1;
+        }
+    }
+
+    Image img(300, 257), out;
+    for(auto& px : img) px = Color(uint8_t(gen()), uint8_t(gen()), uint8_t(gen()));
+    applyLut(img, out, luts::gamma22);
+    for(size_t i = 0; i < img.numElements(); ++i)
+        if(out.mem[i].r != luts::gamma22[img.mem[i].r] || out.mem[i].g != luts::gamma22[img.mem[i].g] ||
+           out.mem[i].b != luts::gamma22[img.mem[i].b])
+        {
+            printf("FAILED: applyLut(Image) is wrong\n");
+            return 1;
+        }
+
+    // the generic front end, 8 bit sRGB in, 16 bit linear out
+    Matrix<uint8_t> gray(300, 257);
+    for(auto& v : gray) v = uint8_t(gen());
+    Matrix<uint16_t> linear;
+    applyLut(gray, linear, luts::srgbToLinear16);
+    for(size_t i = 0; i < gray.numElements(); ++i)
+        if(linear.mem[i] != luts::srgbToLinear16[gray.mem[i]])
+        {
+            printf("FAILED: applyLut(Matrix<uint8_t>, Matrix<uint16_t>) is wrong\n");
+            return 1;
+        }
+    printf("lookup tables and kernels agree\n");
+    return 0;
+}
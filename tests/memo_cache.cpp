@@ -0,0 +1,131 @@
+// contentHash/hashBytes (Kernels.h) and MemoCache: the hash is the same on
+// every ISA and changes with single-bit flips, swapped stripes and the
+// shape; near-identical buffers do not collide; the cache computes each
+// key once, evicts least recently used results to its budget and keeps
+// handed-out results alive.
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "MemoCache.h"
+
+using namespace std;
+
+void check(bool ok, const string& what)
+{
+    if(ok) return;
+    cout << "FAILED: " << what << endl;
+    exit(1);
+}
+
+void checkHash()
+{
+    mt19937 gen(3);
+    vector<uint8_t> buf(5000);
+    for(auto& b : buf) b = static_cast<uint8_t>(gen());
+
+    // the same on every ISA, for every length around the stripe and block sizes
+    for(size_t n = 0; n <= buf.size(); n += n < 2100 ? 1 : 97)
+    {
+        const uint64_t h = kernelsFor(cpu::Isa::Baseline).hashBytes(buf.data(), n, 7);
+        for(cpu::Isa isa : cpu::allIsas)
+            check(isa > cpu::detectIsa() || kernelsFor(isa).hashBytes(buf.data(), n, 7) == h,
+                  string("hashBytes on ") + cpu::isaName(isa) + " matches baseline");
+    }
+
+    // every single-bit flip of a 4 KB buffer gives a new hash
+    unordered_set<uint64_t> seen;
+    const KernelTable& k = kernels();
+    seen.insert(k.hashBytes(buf.data(), 4096, 0));
+    for(size_t bit = 0; bit < 4096*8; ++bit)
+    {
+        buf[bit/8] ^= uint8_t(1 << bit%8);
+        check(seen.insert(k.hashBytes(buf.data(), 4096, 0)).second, "single-bit flips");
+        buf[bit/8] ^= uint8_t(1 << bit%8);
+    }
+
+    // two 64 byte stripes swapped, inside a block and across blocks
+    const uint64_t before = k.hashBytes(buf.data(), 4096, 0);
+    for(size_t other : {64, 960, 1024, 3008})
+    {
+        vector<uint8_t> swapped = buf;
+        swap_ranges(swapped.begin(), swapped.begin() + 64, swapped.begin() + other);
+        check(k.hashBytes(swapped.data(), 4096, 0) != before, "swapped stripes");
+    }
+
+    // the same bytes in another shape
+    Matrix<uint8_t> a(4, 8), b(8, 4);
+    check(contentHash(a) != contentHash(b), "the shape is hashed");
+
+    // a million 64 byte buffers differing in one counter
+    seen.clear();
+    vector<uint64_t> words(8, 0x0123456789abcdefull);
+    for(uint64_t i = 0; i < 1000000; ++i)
+    {
+        words[i % 8] = i;
+        check(seen.insert(k.hashBytes(reinterpret_cast<const uint8_t*>(words.data()), 64, 0)).second,
+              "near-identical buffers");
+    }
+}
+
+void checkCache()
+{
+    using Bytes = vector<uint8_t>;
+    const size_t entryBytes = memoBytes(Bytes(1000));
+    MemoCache cache(3*entryBytes);
+    int computed = 0;
+    auto make = [&](uint8_t fill) { return [&computed, fill] { ++computed; return Bytes(1000, fill); }; };
+    auto key = [](int i) { return MemoKey{uint64_t(i), "fill", hashParams(i)}; };
+
+    auto first = cache.get<Bytes>(key(1), make(1));
+    check(cache.get<Bytes>(key(1), make(99)) == first && computed == 1, "a hit returns the cached result");
+    cache.get<Bytes>(key(2), make(2));
+    cache.get<Bytes>(key(3), make(3));
+    cache.find<Bytes>(key(1));                  // 2 is now the least recently used
+    cache.get<Bytes>(key(4), make(4));
+    MemoCache::Stats st = cache.stats();
+    check(st.entries == 3 && st.bytes == 3*entryBytes && st.evictions == 1, "evicted to the budget");
+    check(!cache.find<Bytes>(key(2)) && cache.find<Bytes>(key(1)) && cache.find<Bytes>(key(4)), "LRU order");
+    check(st.hits == 2 && st.misses == 4, "hits and misses");
+
+    // a result handed out stays valid after it is evicted
+    cache.setBudget(0);
+    check(cache.stats().entries == 0 && first->size() == 1000 && (*first)[999] == 1, "evicted results stay alive");
+    cache.setBudget(3*entryBytes);
+    // a result bigger than the whole budget is returned but not kept
+    auto huge = cache.get<Bytes>(key(5), [] { return Bytes(10000, 5); });
+    check(huge->size() == 10000 && !cache.find<Bytes>(key(5)), "oversized results are not kept");
+
+    // the key is content, operation and parameters; a different result type under one key is an error
+    cache.get<Bytes>(key(6), make(6));
+    check(!cache.find<Bytes>(MemoKey{6, "other", hashParams(6)}) && !cache.find<Bytes>(MemoKey{6, "fill", hashParams(7)}),
+          "operation and parameters are part of the key");
+    bool threw = false;
+    try { cache.find<string>(key(6)); }
+    catch(const invalid_argument&) { threw = true; }
+    check(threw, "another result type under the same key throws");
+
+    check(hashParams(1, 2) != hashParams(2, 1) && hashParams(1, 2) == hashParams(1, 2), "hashParams");
+    // strings hash by their characters, however they are passed
+    const string mode = "reflect";
+    char copy[] = "reflect";
+    const char* literal = "reflect";
+    check(hashParams(literal) == hashParams(static_cast<const char*>(copy)) && hashParams(copy) == hashParams(mode) &&
+          hashParams(mode.c_str(), 3) == hashParams("reflect", 3), "equal strings at different addresses");
+    check(hashParams("reflect") != hashParams("replicate"), "different strings");
+    cache.clear();
+    check(cache.stats().entries == 0 && cache.stats().bytes == 0, "clear");
+}
+
+int
+main() {
+    checkHash();
+    checkCache();
+    cout << "content hash and MemoCache behave" << endl;
+    return 0;
+}
@@ -0,0 +1,122 @@
+// The Morton codec (every implementation this CPU runs) and the MortonMatrix
+// operations the Z-order code in bench/morton_layout.cpp is built from:
+// index(), stepping with addX/addY, tiles with and without an apron, and
+// the row-major conversions, on sizes that leave partial tiles.
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+#include "MortonMatrix.h"
+
+using namespace std;
+
+void check(bool ok, const string& what)
+{
+    if(ok) return;
+    cout << "FAILED: " << what << endl;
+    exit(1);
+}
+
+void checkCodec()
+{
+    constexpr int GL = 6;
+    mt19937 gen(1);
+    for(int k = 0; k < 100000; ++k)
+    {
+        const uint32_t col = gen() & 0xffff, row = gen() & 0xffff;
+        const uint32_t m = morton::encode(col, row);
+        uint32_t c, r;
+        morton::decode(m, c, r);
+        check(c == col && r == row && m == (morton::spread(col) | morton::spread(row) << 1), "encode/decode");
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        if(morton::hasBmi2())
+        {
+            morton::decodeBmi2(m, c, r);
+            check(morton::encodeBmi2(col, row) == m && c == col && r == row, "pdep/pext");
+        }
+#endif
+        // stepping inside a 64x64 tile, wrapping at its edges, keeps the tile bits
+        const int dx = int(gen() % 7) - 3, dy = int(gen() % 7) - 3;
+        const size_t tileBits = size_t(gen() % 100) << 2*GL;
+        const uint32_t x = col & 63, y = row & 63;
+        const size_t stepped = morton::addY<GL>(morton::addX<GL>(tileBits | morton::encode(x, y), dx), dy);
+        check(stepped == (tileBits | morton::encode((x + dx) & 63, (y + dy) & 63)), "addX/addY");
+    }
+}
+
+template<typename T>
+bool same(const T& a, const T& b) { return memcmp(&a, &b, sizeof(T)) == 0; }
+
+// every operation on an nRows x nCols matrix, against the row-major original
+template<typename T, int LOG>
+void checkMatrix(const Matrix<T>& src, const string& what)
+{
+    using Z = MortonMatrix<T, LOG>;
+    constexpr int TILE = Z::TILE;
+    const Z z(src);
+    check(z.numTileRows() == (src.nRows + TILE - 1)/TILE && z.numTileCols() == (src.nCols + TILE - 1)/TILE,
+          what + " tile counts");
+    check(z.storedElements() == size_t(z.numTileRows())*z.numTileCols()*Z::TILE_ELEMS, what + " padding");
+
+    Matrix<T> back = z.toRowMajor();
+    check(equal(back.begin(), back.end(), src.begin(), same<T>), what + " round trip");
+    for(int i = 0; i < src.nRows; ++i)
+        for(int j = 0; j < src.nCols; ++j)
+        {
+            const size_t tile = size_t(i/TILE)*z.numTileCols() + j/TILE;
+            check(z.index(i, j) == (tile*Z::TILE_ELEMS | morton::encode(j % TILE, i % TILE)), what + " index");
+            check(same(z(i, j), src.unchecked(i, j)), what + " operator()");
+        }
+
+    // tiles with a 1 element apron replicate the edge; written back, they change nothing
+    const int side = TILE + 2;
+    vector<T> apron(size_t(side)*side), inner(Z::TILE_ELEMS);
+    Z copy(src.nRows, src.nCols);
+    for(int tr = 0; tr < z.numTileRows(); ++tr)
+        for(int tc = 0; tc < z.numTileCols(); ++tc)
+        {
+            z.readTile(tr, tc, 1, apron.data());
+            for(int y = 0; y < side; ++y)
+                for(int x = 0; x < side; ++x)
+                {
+                    const int i = clamp(tr*TILE - 1 + y, 0, src.nRows - 1), j = clamp(tc*TILE - 1 + x, 0, src.nCols - 1);
+                    check(same(apron[y*side + x], src.unchecked(i, j)), what + " readTile");
+                }
+            z.readTile(tr, tc, 0, inner.data());
+            copy.writeTile(tr, tc, inner.data());
+        }
+    back = copy.toRowMajor();
+    check(equal(back.begin(), back.end(), src.begin(), same<T>), what + " writeTile");
+
+    bool threw = false;
+    try { const_cast<Z&>(z).at(src.nRows, 0); }
+    catch(const out_of_range&) { threw = true; }
+    check(threw, what + " at() out of range");
+}
+
+int
+main() {
+    checkCodec();
+
+    mt19937 gen(3);
+    Matrix<uint8_t> gray(200, 131);
+    for(auto& v : gray) v = uint8_t(gen());
+    Image img(100, 77);
+    for(size_t i = 0; i < img.numElements(); ++i) img.mem[i] = Color(uint8_t(i), uint8_t(i >> 8), 7);
+    Matrix<uint16_t> big(600, 530);
+    for(auto& v : big) v = uint16_t(gen());
+
+    checkMatrix<uint8_t, morton::defaultLogTile<uint8_t>()>(gray, "gray");
+    checkMatrix<uint8_t, 2>(gray, "gray, 4x4 tiles");
+    checkMatrix<Color, morton::defaultLogTile<Color>()>(img, "Image");
+    // tiles too big for the spread table: morton::encode
+    checkMatrix<uint16_t, 9>(big, "512x512 tiles");
+
+    cout << "Morton codec and MortonMatrix agree with row-major" << endl;
+    return 0;
+}
@@ -0,0 +1,82 @@
+// Standard algorithms on Matrix data through begin()/end(), rows() and
+// column() have to agree with plain loops. With TBB they run under
+// std::execution::par, without it under std::execution::seq.
+
+#include <algorithm>
+#include <cstdlib>
+#include <execution>
+#include <iostream>
+#include <iterator>
+#include <numeric>
+#include <random>
+#include <type_traits>
+
+#include "Matrix.h"
+
+using namespace std;
+
+#if MATRIX_HAVE_PARALLEL_STL
+const auto& policy = execution::par;
+const char* policyName = "par";
+#else
+const auto& policy = execution::seq;
+const char* policyName = "seq";
+#endif
+
+// columns are random access; rows hand out Spans by value, so they are input iterators only
+static_assert(is_same<iterator_traits<ColumnIterator<float>>::iterator_category, random_access_iterator_tag>::value, "column");
+static_assert(is_same<iterator_traits<RowIterator<float>>::iterator_category, input_iterator_tag>::value, "row");
+
+void check(bool ok, const char* what)
+{
+    if(ok) return;
+    cout << "FAILED: " << what << endl;
+    exit(1);
+}
+
+void fillRandom(Matrix<float>& mat, unsigned seed)
+{
+    mt19937 gen(seed);
+    uniform_real_distribution<float> dist(-1.f, 1.f);
+    for(auto& v : mat) v = dist(gen);
+}
+
+int
+main() {
+    Matrix<float> src(300, 257), dst(300, 257);
+    fillRandom(src, 1);
+
+    transform(policy, src.begin(), src.end(), dst.begin(), [](float v) { return 2*v + 1; });
+    for(int i = 0; i < src.nRows; ++i)
+        for(int j = 0; j < src.nCols; ++j)
+            check(dst(i, j) == 2*src(i, j) + 1, "transform");
+
+    // integers so that reassociation in the parallel reduce cannot change the answer
+    Matrix<int64_t> ints(300, 257);
+    iota(ints.begin(), ints.end(), int64_t(0));
+    auto n = static_cast<int64_t>(ints.numElements());
+    check(reduce(policy, ints.begin(), ints.end(), int64_t(0)) == n*(n - 1)/2, "reduce");
+
+    // row-wise (sequential, rows are input iterators) and column-wise reductions through the adaptors
+    auto rowSums = Matrix<int64_t>(1, ints.nRows);
+    transform(ints.rows().begin(), ints.rows().end(), rowSums.begin(),
+              [](Span<int64_t> row) { return reduce(policy, row.begin(), row.end(), int64_t(0)); });
+    for(int i = 0; i < ints.nRows; ++i)
+        check(rowSums(0, i) == accumulate(ints.row(i).begin(), ints.row(i).end(), int64_t(0)), "row reduce");
+    auto col = ints.column(7);
+    check(reduce(policy, col.begin(), col.end(), int64_t(0)) == 7*300 + 257*(299*300/2), "column reduce");
+
+    sort(policy, src.begin(), src.end());
+    check(is_sorted(src.begin(), src.end()), "sort");
+    // sorting one column in place through the strided iterator
+    fillRandom(dst, 2);
+    Matrix<float> before = dst;
+    sort(policy, dst.column(3).begin(), dst.column(3).end());
+    check(is_sorted(dst.column(3).begin(), dst.column(3).end()), "column sort");
+    for(int i = 0; i < dst.nRows; ++i)
+        for(int j = 0; j < dst.nCols; ++j)
+            check(j == 3 || dst(i, j) == before(i, j), "column sort left the other columns alone");
+
+    cout << "transform / reduce / sort (" << policyName << ") agree with the sequential results" << endl;
+    return 0;
+}
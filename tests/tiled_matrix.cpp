@@ -0,0 +1,107 @@
+// TiledMatrix has to keep every element through eviction, write-back and
+// reopening the file, and stay usable after a tile read or write fails.
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "TiledMatrix.h"
+
+using namespace std;
+
+void check(bool ok, const string& what)
+{
+    if(ok) return;
+    cout << "FAILED: " << what << endl;
+    exit(1);
+}
+
+template<typename FUNC>
+bool throws(FUNC&& func)
+{
+    try { func(); }
+    catch(const exception&) { return true; }
+    return false;
+}
+
+float value(int i, int j) { return i*1000.f + j; }
+
+int
+main() {
+    const string path = (filesystem::temp_directory_path() / "test_tiled_matrix.bin").string();
+    const int ROWS = 300, COLS = 500, TILE = 64;
+    const size_t budget = 4*size_t(TILE)*TILE*sizeof(float);    // 4 of the 40 tiles
+
+    {
+        TiledMatrix<float> m(path, ROWS, COLS, TILE, budget);
+        // the bottom rows are never written, they stay zero
+        for(int i = 0; i < ROWS - 50; ++i)
+            for(int j = 0; j < COLS; ++j) m(i, j) = value(i, j);
+        check(m.residentTiles() == 4 && m.evictions() > 0 && m.writeBacks() > 0, "tiles are evicted and written back");
+        // column by column: a miss on nearly every access
+        for(int j = 0; j < COLS; ++j)
+            for(int i = 0; i < ROWS; ++i) check(m.get(i, j) == (i < ROWS - 50 ? value(i, j) : 0.f), "get after eviction");
+        size_t visited = 0;
+        m.visitTilesReadOnly([&](const TiledMatrix<float>::Tile& t) {
+            for(int r = 0; r < t.rows; ++r)
+                for(int c = 0; c < t.cols; ++c)
+                {
+                    const int i = t.row0 + r, j = t.col0 + c;
+                    check(t(r, c) == (i < ROWS - 50 ? value(i, j) : 0.f), "visitTilesReadOnly");
+                    ++visited;
+                }
+        });
+        check(visited == size_t(ROWS)*COLS, "every element visited once");
+        m.close();
+        m.close();
+    }
+
+    {
+        TiledMatrix<float> m(path, ROWS, COLS, TILE, budget, TiledMatrix<float>::Mode::Open);
+        for(int i = 0; i < ROWS; ++i)
+            for(int j = 0; j < COLS; ++j) check(m.get(i, j) == (i < ROWS - 50 ? value(i, j) : 0.f), "reopened");
+        m.visitTiles([](const TiledMatrix<float>::Tile& t) { t(0, 0) = -1; });
+    }
+    {
+        TiledMatrix<float> m(path, ROWS, COLS, TILE, budget, TiledMatrix<float>::Mode::Open);
+        check(m.get(0, 0) == -1 && m.get(TILE, TILE) == -1 && m.get(1, 1) == value(1, 1), "visitTiles writes back");
+    }
+    {
+        TiledMatrix<float> m(path, ROWS, COLS, TILE, budget);
+        check(m.get(0, 0) == 0, "Mode::Create starts from zero");
+    }
+
+    // a tile read that fails leaves nothing behind: the same tile fails again, the others still work
+    {
+        {
+            TiledMatrix<float> m(path, ROWS, COLS, TILE, budget);
+            m(0, 0) = 1;
+            m(ROWS - 1, COLS - 1) = 2;
+        }
+        TiledMatrix<float> m(path, ROWS, COLS, TILE, budget, TiledMatrix<float>::Mode::Open);
+        filesystem::resize_file(path, 2*size_t(TILE)*TILE*sizeof(float));
+        check(throws([&] { m.get(ROWS - 1, COLS - 1); }), "reading a tile cut off the file throws");
+        check(throws([&] { m.get(ROWS - 1, COLS - 1); }), "and throws again");
+        check(m.get(0, 0) == 1, "other tiles are still read");
+    }
+
+    // a write-back that fails keeps the tile resident and dirty
+    if(filesystem::exists("/dev/full"))
+    {
+        TiledMatrix<float> m("/dev/full", ROWS, COLS, TILE, size_t(TILE)*TILE*sizeof(float), TiledMatrix<float>::Mode::Open);
+        m(0, 0) = 5;
+        check(throws([&] { m(0, TILE) = 6; }), "evicting to a full disk throws");
+        check(m.residentTiles() == 1 && m.get(0, 0) == 5, "the dirty tile is still there");
+        check(throws([&] { m.close(); }), "close reports the lost write-back");
+    }
+
+    check(throws([&] { TiledMatrix<float> m(path, ROWS, COLS, 0); }), "tile size 0");
+    check(throws([&] { TiledMatrix<float> m(path, -1, COLS, TILE); }), "negative rows");
+
+    filesystem::remove(path);
+    cout << "TiledMatrix keeps its tiles" << endl;
+    return 0;
+}